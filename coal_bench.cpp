@@ -0,0 +1,404 @@
+// coal_bench: the renderer of HelloWorld running a fixed list of headless cases,
+// so numbers are comparable between commits and machines.
+//
+//   coal_bench --software --out results.json
+//   coal_bench --software --compare baseline.json --threshold 10
+//   coal_bench --results results.json --compare baseline.json
+//
+// Each case creates its own device with validation off and no pipeline cache, so
+// startup phases are always cold. Exits with 0 when nothing regressed by more than
+// --threshold percent against the baseline, 1 when something did and 2 on errors.
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "renderer.h"
+
+struct BenchCase {
+    const char* name;
+    uint32_t width;
+    uint32_t height;
+    uint32_t grid;
+    QualityTier quality;
+    bool compute;
+    uint32_t lighting_scale; // split passes with this shadow/AO scale, 0 for the single scene pass
+    bool checkerboard;       // split passes only
+};
+
+// Sized to finish in minutes on lavapipe; renaming or resizing a case breaks its history
+const BenchCase BENCH_CASES[] = {
+    { "quad_540p_low", 960, 540, 0, QUALITY_LOW, false, 0, false },
+    { "quad_720p_high", 1280, 720, 0, QUALITY_HIGH, false, 0, false },
+    { "compute_720p_high", 1280, 720, 0, QUALITY_HIGH, true, 0, false },
+    { "compute_grid8_720p_high", 1280, 720, 8, QUALITY_HIGH, true, 0, false },
+    { "compute_grid16_1080p_ultra", 1920, 1080, 16, QUALITY_ULTRA, true, 0, false },
+    { "split_half_720p_high", 1280, 720, 0, QUALITY_HIGH, true, 2, false },
+    { "split_quarter_grid8_720p_high", 1280, 720, 8, QUALITY_HIGH, true, 4, false },
+    { "checker_half_720p_high", 1280, 720, 0, QUALITY_HIGH, true, 2, true },
+};
+
+// Split pass scopes reported on their own for the split cases
+const GpuScope BENCH_SPLIT_SCOPES[] = { GPU_SCOPE_GBUFFER, GPU_SCOPE_LIGHTING, GPU_SCOPE_COMPOSITE,
+    GPU_SCOPE_RECONSTRUCT };
+const uint32_t BENCH_SPLIT_SCOPE_COUNT = sizeof(BENCH_SPLIT_SCOPES) / sizeof(BENCH_SPLIT_SCOPES[0]);
+
+struct BenchOptions {
+    uint32_t warmup_frames = 10;
+    uint32_t measured_frames = 60;
+    std::string filter;             // only cases whose name contains this
+    bool software = false;          // see Options::software
+    std::string out_path = "coal_bench.json";
+    std::string results_path;       // compare these results instead of running
+    std::string baseline_path;      // compare mode
+    double threshold_percent = 10.0;
+};
+
+// One case's numbers; metrics are flat "name": value pairs in the JSON, all
+// milliseconds except fps.
+struct BenchResult {
+    std::string name;
+    std::vector<std::pair<std::string, double>> metrics;
+
+    double metric(const std::string& key) const {
+        for (const auto& entry : metrics) {
+            if (entry.first == key) return entry.second;
+        }
+        return -1.0;
+    }
+};
+
+struct BenchReport {
+    std::string device;
+    std::vector<BenchResult> results;
+};
+
+// Metrics checked in compare mode. Means and p95s are written too but are too
+// noisy on shared CI machines to gate on.
+const char* const BENCH_GATED_METRICS[] = {
+    "frame_ms_median",
+    "cpu_ms_median",
+    "gpu_ms_median",
+    "startup_pipelines_ms",
+};
+
+double bench_percentile(std::vector<double> samples, double fraction) {
+    if (samples.empty()) return 0.0;
+    std::sort(samples.begin(), samples.end());
+    size_t rank = static_cast<size_t>(std::ceil(fraction * samples.size()));
+    return samples[std::min(std::max(rank, (size_t)1), samples.size()) - 1];
+}
+
+double bench_mean(const std::vector<double>& samples) {
+    if (samples.empty()) return 0.0;
+    double sum = 0.0;
+    for (double sample : samples) sum += sample;
+    return sum / samples.size();
+}
+
+void add_bench_stats(BenchResult& result, const std::string& prefix, const std::vector<double>& samples) {
+    result.metrics.push_back({ prefix + "_mean", bench_mean(samples) });
+    result.metrics.push_back({ prefix + "_median", bench_percentile(samples, 0.5) });
+    result.metrics.push_back({ prefix + "_p95", bench_percentile(samples, 0.95) });
+    result.metrics.push_back({ prefix + "_min", bench_percentile(samples, 0.0) });
+}
+
+int run_bench_case(const BenchCase& bench_case, const BenchOptions& bench_options, BenchReport& report) {
+    Options options;
+    options.headless = true;
+    options.width = bench_case.width;
+    options.height = bench_case.height;
+    options.grid = bench_case.grid;
+    options.quality = bench_case.quality;
+    options.compute = bench_case.compute;
+    options.split_passes = bench_case.lighting_scale > 0;
+    options.lighting_scale = bench_case.lighting_scale;
+    options.checkerboard = bench_case.checkerboard;
+    options.pipeline_cache.clear();
+    options.validation = false;
+    options.software = bench_options.software;
+
+    Init init;
+    RenderData data;
+    StartupTimes startup;
+    auto device_start = std::chrono::steady_clock::now();
+    if (0 != device_initialization(init, options)) return -1;
+    std::chrono::duration<double, std::milli> device_ms = std::chrono::steady_clock::now() - device_start;
+    startup.device_ms = device_ms.count();
+    if (0 != create_renderer(init, data, options, startup)) return -1;
+    report.device = init.device.physical_device.properties.deviceName;
+
+    // the first frame pays for lazy driver work (shader JIT on software drivers)
+    auto first_start = std::chrono::steady_clock::now();
+    if (0 != draw_frame_headless(init, data)) return -1;
+    init.disp.deviceWaitIdle();
+    std::chrono::duration<double, std::milli> first_frame_ms = std::chrono::steady_clock::now() - first_start;
+    for (uint32_t frame = 1; frame < bench_options.warmup_frames; frame++) {
+        if (0 != draw_frame_headless(init, data)) return -1;
+    }
+    init.disp.deviceWaitIdle();
+
+    // frame_ms is the wall time between frames, throttled by the GPU once the
+    // frames in flight are used up; cpu_ms and gpu_ms come from the profiler
+    uint64_t first_measured = data.frame_number + 1;
+    std::vector<double> frame_samples, cpu_samples, gpu_samples;
+    std::vector<double> split_samples[BENCH_SPLIT_SCOPE_COUNT];
+    uint64_t profiled_frame = data.profiler.frame;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < bench_options.measured_frames; frame++) {
+        auto frame_start = std::chrono::steady_clock::now();
+        if (0 != draw_frame_headless(init, data)) return -1;
+        std::chrono::duration<double, std::milli> frame_ms = std::chrono::steady_clock::now() - frame_start;
+        frame_samples.push_back(frame_ms.count());
+        if (data.profiler.frame != profiled_frame && data.profiler.frame >= first_measured) {
+            cpu_samples.push_back(data.profiler.cpu_total_ms);
+            if (data.profiler.gpu_timestamps) gpu_samples.push_back(data.profiler.gpu_total_ms);
+            for (uint32_t i = 0; data.split_passes && i < BENCH_SPLIT_SCOPE_COUNT; i++) {
+                if (data.profiler.gpu_timestamps) split_samples[i].push_back(data.profiler.gpu_ms[BENCH_SPLIT_SCOPES[i]]);
+            }
+        }
+        profiled_frame = data.profiler.frame;
+    }
+    init.disp.deviceWaitIdle();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    BenchResult result;
+    result.name = bench_case.name;
+    result.metrics.push_back({ "startup_device_ms", startup.device_ms });
+    result.metrics.push_back({ "startup_resources_ms", startup.resources_ms });
+    result.metrics.push_back({ "startup_pipelines_ms", startup.pipelines_ms });
+    result.metrics.push_back({ "first_frame_ms", first_frame_ms.count() });
+    result.metrics.push_back({ "fps", seconds > 0.0 ? bench_options.measured_frames / seconds : 0.0 });
+    add_bench_stats(result, "frame_ms", frame_samples);
+    add_bench_stats(result, "cpu_ms", cpu_samples);
+    if (!gpu_samples.empty()) add_bench_stats(result, "gpu_ms", gpu_samples);
+    for (uint32_t i = 0; i < BENCH_SPLIT_SCOPE_COUNT; i++) {
+        // reconstruct only runs with the checkerboard
+        if (split_samples[i].empty() || (BENCH_SPLIT_SCOPES[i] == GPU_SCOPE_RECONSTRUCT && !data.checkerboard)) continue;
+        add_bench_stats(result, std::string("gpu_") + GPU_SCOPE_NAMES[BENCH_SPLIT_SCOPES[i]] + "_ms", split_samples[i]);
+    }
+
+    std::cout << bench_case.name << ": frame " << result.metric("frame_ms_median") << " ms, cpu "
+              << result.metric("cpu_ms_median") << " ms, gpu ";
+    if (gpu_samples.empty()) {
+        std::cout << "n/a";
+    } else {
+        std::cout << result.metric("gpu_ms_median") << " ms";
+    }
+    std::cout << " (medians), startup " << startup.device_ms + startup.resources_ms + startup.pipelines_ms
+              << " ms\n";
+    report.results.push_back(std::move(result));
+
+    cleanup(init, data);
+    return 0;
+}
+
+std::string bench_json_escape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        if (static_cast<unsigned char>(c) >= 0x20) escaped += c;
+    }
+    return escaped;
+}
+
+int write_bench_json(const std::string& path, const BenchReport& report, const BenchOptions& options) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cout << "failed to open " << path << "\n";
+        return -1;
+    }
+    file << std::setprecision(6);
+    file << "{\n";
+    file << "  \"device\": \"" << bench_json_escape(report.device) << "\",\n";
+    file << "  \"warmup_frames\": " << options.warmup_frames << ",\n";
+    file << "  \"measured_frames\": " << options.measured_frames << ",\n";
+    file << "  \"cases\": [\n";
+    for (size_t i = 0; i < report.results.size(); i++) {
+        const BenchResult& result = report.results[i];
+        file << "    {\n      \"name\": \"" << bench_json_escape(result.name) << "\"";
+        for (const auto& entry : result.metrics) {
+            file << ",\n      \"" << entry.first << "\": " << entry.second;
+        }
+        file << "\n    }" << (i + 1 < report.results.size() ? "," : "") << "\n";
+    }
+    file << "  ]\n}\n";
+    return 0;
+}
+
+// Reads back what write_bench_json produces (or hand edits of it): the device
+// string and every case object's name and numeric fields.
+int read_bench_json(const std::string& path, BenchReport& report) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cout << "failed to open " << path << "\n";
+        return -1;
+    }
+    std::stringstream stream;
+    stream << file.rdbuf();
+    std::string text = stream.str();
+
+    size_t pos = 0;
+    auto skip_space = [&]() {
+        while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) pos++;
+    };
+    auto read_string = [&](std::string& out) {
+        out.clear();
+        if (pos >= text.size() || text[pos] != '"') return false;
+        for (pos++; pos < text.size() && text[pos] != '"'; pos++) {
+            if (text[pos] == '\\' && pos + 1 < text.size()) pos++;
+            out += text[pos];
+        }
+        pos++;
+        return true;
+    };
+
+    BenchResult* current = nullptr;
+    int depth = 0;
+    std::string key, value;
+    while (pos < text.size()) {
+        skip_space();
+        if (pos >= text.size()) break;
+        char c = text[pos];
+        if (c == '{') {
+            depth++;
+            pos++;
+            // objects inside "cases" are one result each
+            if (depth == 2) {
+                report.results.emplace_back();
+                current = &report.results.back();
+            }
+        } else if (c == '}') {
+            if (depth == 2) current = nullptr;
+            depth--;
+            pos++;
+        } else if (c == '"') {
+            read_string(key);
+            skip_space();
+            if (pos >= text.size() || text[pos] != ':') continue;
+            pos++;
+            skip_space();
+            if (pos < text.size() && text[pos] == '"') {
+                read_string(value);
+                if (key == "device" && depth == 1) report.device = value;
+                if (key == "name" && current) current->name = value;
+            } else if (pos < text.size() && text[pos] != '[' && text[pos] != '{') {
+                const char* begin = text.c_str() + pos;
+                char* end = nullptr;
+                double number = std::strtod(begin, &end);
+                if (end == begin) {
+                    pos++;
+                    continue;
+                }
+                pos += end - begin;
+                if (current) current->metrics.push_back({ key, number });
+            }
+        } else {
+            pos++;
+        }
+    }
+    if (depth != 0) {
+        std::cout << path << " is not valid bench JSON\n";
+        return -1;
+    }
+    return 0;
+}
+
+// 0 when no gated metric of a case present in both reports grew by more than the
+// threshold, 1 otherwise
+int compare_bench_reports(const BenchReport& baseline, const BenchReport& current, double threshold_percent) {
+    if (baseline.device != current.device) {
+        std::cout << "warning: baseline ran on \"" << baseline.device << "\", these results on \"" << current.device
+                  << "\"\n";
+    }
+    int regressions = 0;
+    for (const BenchResult& result : current.results) {
+        const BenchResult* base = nullptr;
+        for (const BenchResult& candidate : baseline.results) {
+            if (candidate.name == result.name) base = &candidate;
+        }
+        if (!base) {
+            std::cout << result.name << ": not in the baseline\n";
+            continue;
+        }
+        for (const char* metric : BENCH_GATED_METRICS) {
+            double before = base->metric(metric);
+            double after = result.metric(metric);
+            if (before <= 0.0 || after < 0.0) continue;
+            double change = 100.0 * (after - before) / before;
+            bool regressed = change > threshold_percent;
+            if (regressed) regressions++;
+            std::cout << (regressed ? "REGRESSION " : "           ") << result.name << " " << metric << ": "
+                      << before << " -> " << after << " ms (" << (change >= 0.0 ? "+" : "") << change << "%)\n";
+        }
+    }
+    std::cout << regressions << " regression(s) beyond " << threshold_percent << "%\n";
+    return regressions > 0 ? 1 : 0;
+}
+
+int parse_bench_options(int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--warmup" && has_value) {
+            if (0 != parse_option_value(arg, argv[++i], options.warmup_frames)) return -1;
+        } else if (arg == "--frames" && has_value) {
+            if (0 != parse_option_value(arg, argv[++i], options.measured_frames)) return -1;
+        } else if (arg == "--case" && has_value) {
+            options.filter = argv[++i];
+        } else if (arg == "--software") {
+            options.software = true;
+        } else if (arg == "--out" && has_value) {
+            options.out_path = argv[++i];
+        } else if (arg == "--results" && has_value) {
+            options.results_path = argv[++i];
+        } else if (arg == "--compare" && has_value) {
+            options.baseline_path = argv[++i];
+        } else if (arg == "--threshold" && has_value) {
+            if (0 != parse_option_value(arg, argv[++i], options.threshold_percent)) return -1;
+        } else {
+            std::cout << "unknown argument " << arg << "\n";
+            return -1;
+        }
+    }
+    options.warmup_frames = std::max(options.warmup_frames, 1u);
+    options.measured_frames = std::max(options.measured_frames, 1u);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (0 != parse_bench_options(argc, argv, options)) return 2;
+
+    BenchReport report;
+    if (!options.results_path.empty()) {
+        if (0 != read_bench_json(options.results_path, report)) return 2;
+    } else {
+        for (const BenchCase& bench_case : BENCH_CASES) {
+            if (std::string(bench_case.name).find(options.filter) == std::string::npos) continue;
+            if (0 != run_bench_case(bench_case, options, report)) {
+                std::cout << bench_case.name << " failed\n";
+                return 2;
+            }
+        }
+        if (report.results.empty()) {
+            std::cout << "no case matches \"" << options.filter << "\"\n";
+            return 2;
+        }
+        std::cout << "ran on " << report.device << "\n";
+        if (0 != write_bench_json(options.out_path, report, options)) return 2;
+    }
+
+    if (options.baseline_path.empty()) return 0;
+    BenchReport baseline;
+    if (0 != read_bench_json(options.baseline_path, baseline)) return 2;
+    return compare_bench_reports(baseline, report, options.threshold_percent);
+}
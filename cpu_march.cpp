@@ -0,0 +1,81 @@
+// Scalar build of the CPU marcher kernels and the run-time choice between it and
+// the AVX2 build in cpu_march_avx2.cpp.
+
+#include "cpu_march.h"
+
+#include <cstring>
+#include <math.h>
+
+#if COAL_CPU_AVX2 && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace cpu_scalar {
+
+// Scalar lanes with the AVX2 interface; compilers still vectorize some loops.
+struct F8 { float v[8]; };
+struct M8 { bool v[8]; };
+
+#define COAL_F8_BINARY(name, expr) \
+    inline F8 name(F8 a, F8 b) { F8 r; for (int i = 0; i < 8; i++) r.v[i] = (expr); return r; }
+#define COAL_M8_COMPARE(name, expr) \
+    inline M8 name(F8 a, F8 b) { M8 r; for (int i = 0; i < 8; i++) r.v[i] = (expr); return r; }
+
+inline F8 f8(float x) { F8 r; for (int i = 0; i < 8; i++) r.v[i] = x; return r; }
+inline F8 f8_load(const float* p) { F8 r; memcpy(r.v, p, sizeof(r.v)); return r; }
+inline void f8_store(float* p, F8 a) { memcpy(p, a.v, sizeof(a.v)); }
+COAL_F8_BINARY(operator+, a.v[i] + b.v[i])
+COAL_F8_BINARY(operator-, a.v[i] - b.v[i])
+COAL_F8_BINARY(operator*, a.v[i] * b.v[i])
+COAL_F8_BINARY(operator/, a.v[i] / b.v[i])
+// minps/maxps semantics: the second operand when either is NaN or both are equal
+COAL_F8_BINARY(f8_min, a.v[i] < b.v[i] ? a.v[i] : b.v[i])
+COAL_F8_BINARY(f8_max, a.v[i] > b.v[i] ? a.v[i] : b.v[i])
+inline F8 f8_abs(F8 a) { F8 r; for (int i = 0; i < 8; i++) r.v[i] = fabsf(a.v[i]); return r; }
+inline F8 f8_sqrt(F8 a) { F8 r; for (int i = 0; i < 8; i++) r.v[i] = sqrtf(a.v[i]); return r; }
+COAL_M8_COMPARE(operator<, a.v[i] < b.v[i])
+COAL_M8_COMPARE(operator>, a.v[i] > b.v[i])
+inline M8 operator&(M8 a, M8 b) { M8 r; for (int i = 0; i < 8; i++) r.v[i] = a.v[i] && b.v[i]; return r; }
+inline M8 operator|(M8 a, M8 b) { M8 r; for (int i = 0; i < 8; i++) r.v[i] = a.v[i] || b.v[i]; return r; }
+inline M8 m8_and_not(M8 a, M8 b) { M8 r; for (int i = 0; i < 8; i++) r.v[i] = a.v[i] && !b.v[i]; return r; }
+inline M8 m8_true() { M8 r; for (int i = 0; i < 8; i++) r.v[i] = true; return r; }
+inline bool m8_any(M8 m) { for (int i = 0; i < 8; i++) if (m.v[i]) return true; return false; }
+inline F8 f8_select(M8 m, F8 a, F8 b) { F8 r; for (int i = 0; i < 8; i++) r.v[i] = m.v[i] ? a.v[i] : b.v[i]; return r; }
+
+#undef COAL_F8_BINARY
+#undef COAL_M8_COMPARE
+
+#include "cpu_march_kernels.h"
+
+} // namespace cpu_scalar
+
+const CpuMarcher CPU_MARCHER_SCALAR = { "scalar", cpu_scalar::cpu_shade_packet, cpu_scalar::cpu_scene_distance,
+    cpu_scalar::cpu_primitives_distance };
+
+#if COAL_CPU_AVX2
+// AVX2 needs both the instruction set and the OS saving the YMM registers.
+static bool cpu_supports_avx2() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+const CpuMarcher& cpu_marcher() {
+#if COAL_CPU_AVX2
+    static const bool avx2 = cpu_supports_avx2();
+    if (avx2) return CPU_MARCHER_AVX2;
+#endif
+    return CPU_MARCHER_SCALAR;
+}
@@ -0,0 +1,79 @@
+// CPU ray marcher shared by the --cpu reference renderer and the brick map baker
+// in renderer.cpp. The kernels (cpu_march_kernels.h) are compiled with scalar
+// lanes in cpu_march.cpp and, when COAL_CPU_AVX2 is set, a second time with 8-wide
+// AVX2 packets in cpu_march_avx2.cpp, the only translation unit built for AVX2.
+// cpu_marcher() picks the variant at run time, so binaries still run on CPUs
+// without AVX2.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifndef COAL_CPU_AVX2
+#define COAL_CPU_AVX2 0
+#endif
+
+// Specialization constants 10..14 in shaders/scene.glsl
+struct QualitySpecialization {
+    int32_t max_steps;
+    float max_dist;
+    float epsilon;
+    int32_t shadow_steps;
+    int32_t ao_samples; // multiple of 4 (AO_TEMPORAL_SAMPLES)
+};
+
+// Keep in sync with the PRIM_* constants in shaders/scene.glsl
+enum SdfPrimitiveType : uint32_t {
+    SDF_PLANE = 0,
+    SDF_BOX = 1,
+    SDF_SPHERE = 2,
+};
+
+// std430 layout of Primitive in shaders/scene.glsl
+struct SdfPrimitive {
+    float position_type[4]; // xyz: center, w: SdfPrimitiveType
+    float params[4];        // box: half extents, sphere: x = radius, plane: xyz = normal, w = offset
+    float material[4];      // rgb: albedo, w: 1 for a checkerboard pattern
+};
+
+// std430 layout of Light in shaders/scene.glsl; lights[0] casts the shadows
+struct SceneLight {
+    float position[4]; // xyz: position, w: intensity
+    float color[4];    // rgb
+};
+
+struct Camera {
+    float position[3];
+    float target[3];
+};
+
+// Scene and quality tier the CPU marcher evaluates, mirroring the GPU specialization.
+struct CpuScene {
+    std::vector<SdfPrimitive> primitives;
+    QualitySpecialization quality;
+    std::vector<SceneLight> lights; // only needed for shading
+};
+
+// One instruction set's build of the kernels.
+struct CpuMarcher {
+    const char* name;
+    // Shades up to eight horizontally adjacent pixels starting at (x, y) into a
+    // width x height B8G8R8A8 image, the headless output format.
+    void (*shade_packet)(const CpuScene& scene, const Camera& camera, uint32_t width, uint32_t height, uint32_t x,
+        uint32_t y, uint8_t* pixels);
+    // sceneSDF at eight points
+    void (*scene_distance)(const CpuScene& scene, const float x[8], const float y[8], const float z[8], float d[8]);
+    // Distance to the closest of `count` primitives, at most max_dist, along a row
+    // of eight points that share y and z
+    void (*primitives_distance)(const SdfPrimitive* const* primitives, size_t count, float max_dist,
+        const float x[8], float y, float z, float d[8]);
+};
+
+extern const CpuMarcher CPU_MARCHER_SCALAR;
+#if COAL_CPU_AVX2
+extern const CpuMarcher CPU_MARCHER_AVX2;
+#endif
+
+// The AVX2 kernels when they were built and the CPU supports them, else the scalar ones.
+const CpuMarcher& cpu_marcher();
@@ -0,0 +1,45 @@
+// AVX2 build of the CPU marcher kernels. The only translation unit compiled for
+// AVX2 (see CMakeLists.txt); cpu_marcher() only hands it out on CPUs that have it.
+
+#include "cpu_march.h"
+
+#include <math.h>
+
+#include <immintrin.h>
+
+#if !defined(__AVX2__)
+#error "cpu_march_avx2.cpp has to be compiled with AVX2 enabled"
+#endif
+
+namespace cpu_avx2 {
+
+// Eight float lanes and a lane mask in AVX registers.
+struct F8 { __m256 v; };
+struct M8 { __m256 v; };
+
+inline F8 f8(float x) { return { _mm256_set1_ps(x) }; }
+inline F8 f8_load(const float* p) { return { _mm256_loadu_ps(p) }; }
+inline void f8_store(float* p, F8 a) { _mm256_storeu_ps(p, a.v); }
+inline F8 operator+(F8 a, F8 b) { return { _mm256_add_ps(a.v, b.v) }; }
+inline F8 operator-(F8 a, F8 b) { return { _mm256_sub_ps(a.v, b.v) }; }
+inline F8 operator*(F8 a, F8 b) { return { _mm256_mul_ps(a.v, b.v) }; }
+inline F8 operator/(F8 a, F8 b) { return { _mm256_div_ps(a.v, b.v) }; }
+inline F8 f8_min(F8 a, F8 b) { return { _mm256_min_ps(a.v, b.v) }; }
+inline F8 f8_max(F8 a, F8 b) { return { _mm256_max_ps(a.v, b.v) }; }
+inline F8 f8_abs(F8 a) { return { _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v) }; }
+inline F8 f8_sqrt(F8 a) { return { _mm256_sqrt_ps(a.v) }; }
+inline M8 operator<(F8 a, F8 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+inline M8 operator>(F8 a, F8 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+inline M8 operator&(M8 a, M8 b) { return { _mm256_and_ps(a.v, b.v) }; }
+inline M8 operator|(M8 a, M8 b) { return { _mm256_or_ps(a.v, b.v) }; }
+inline M8 m8_and_not(M8 a, M8 b) { return { _mm256_andnot_ps(b.v, a.v) }; }
+inline M8 m8_true() { return { _mm256_castsi256_ps(_mm256_set1_epi32(-1)) }; }
+inline bool m8_any(M8 m) { return _mm256_movemask_ps(m.v) != 0; }
+inline F8 f8_select(M8 m, F8 a, F8 b) { return { _mm256_blendv_ps(b.v, a.v, m.v) }; }
+
+#include "cpu_march_kernels.h"
+
+} // namespace cpu_avx2
+
+const CpuMarcher CPU_MARCHER_AVX2 = { "avx2", cpu_avx2::cpu_shade_packet, cpu_avx2::cpu_scene_distance,
+    cpu_avx2::cpu_primitives_distance };
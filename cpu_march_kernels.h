@@ -0,0 +1,213 @@
+// Kernels of the CPU ray marcher: the non-temporal path of shaders/scene.glsl
+// (sceneSDF, rayMarch, estimateNormal, softShadow, ambientOcclusion and
+// checkerboard) evaluated on 8-wide ray packets. Included inside a namespace by
+// cpu_march.cpp and cpu_march_avx2.cpp once they have defined F8, M8 and the lane
+// operations, so the same code is compiled once per instruction set. Scalar float
+// math goes through the C library and namespace-local helpers rather than inline
+// std:: templates: an AVX2-encoded copy of an inline function shared with other
+// translation units could be the one the linker keeps.
+
+inline F8 f8_clamp(F8 x, float lo, float hi) { return f8_min(f8_max(x, f8(lo)), f8(hi)); }
+
+struct V8 {
+    F8 x, y, z;
+};
+
+inline V8 operator+(const V8& a, const V8& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+inline V8 operator-(const V8& a, const V8& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+inline V8 operator*(const V8& a, F8 s) { return { a.x * s, a.y * s, a.z * s }; }
+inline V8 v8(float x, float y, float z) { return { f8(x), f8(y), f8(z) }; }
+inline F8 v8_dot(const V8& a, const V8& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline F8 v8_length(const V8& a) { return f8_sqrt(v8_dot(a, a)); }
+inline V8 v8_normalize(const V8& a) {
+    F8 inv = f8(1.0f) / v8_length(a);
+    return a * inv;
+}
+
+F8 cpu_sd_primitive(const SdfPrimitive& prim, const V8& p) {
+    uint32_t type = static_cast<uint32_t>(prim.position_type[3]);
+    if (type == SDF_PLANE) {
+        return v8_dot(p, v8(prim.params[0], prim.params[1], prim.params[2])) - f8(prim.params[3]);
+    }
+    V8 q = p - v8(prim.position_type[0], prim.position_type[1], prim.position_type[2]);
+    if (type == SDF_BOX) {
+        V8 d = { f8_abs(q.x) - f8(prim.params[0]), f8_abs(q.y) - f8(prim.params[1]), f8_abs(q.z) - f8(prim.params[2]) };
+        V8 outside = { f8_max(d.x, f8(0.0f)), f8_max(d.y, f8(0.0f)), f8_max(d.z, f8(0.0f)) };
+        return f8_min(f8_max(d.x, f8_max(d.y, d.z)), f8(0.0f)) + v8_length(outside);
+    }
+    return v8_length(q) - f8(prim.params[0]);
+}
+
+// Without tile lists sceneSDF and sceneSDFAll are the same function.
+F8 cpu_scene_sdf(const CpuScene& scene, const V8& p) {
+    F8 d = f8(scene.quality.max_dist);
+    for (const SdfPrimitive& prim : scene.primitives) {
+        d = f8_min(d, cpu_sd_primitive(prim, p));
+    }
+    return d;
+}
+
+// sceneClosest: index of the closest primitive per lane, for materials.
+F8 cpu_scene_closest(const CpuScene& scene, const V8& p) {
+    F8 best = f8(scene.quality.max_dist);
+    F8 closest = f8(0.0f);
+    for (uint32_t i = 0; i < scene.primitives.size(); i++) {
+        F8 d = cpu_sd_primitive(scene.primitives[i], p);
+        M8 closer = d < best;
+        best = f8_select(closer, d, best);
+        closest = f8_select(closer, f8(static_cast<float>(i)), closest);
+    }
+    return closest;
+}
+
+F8 cpu_ray_march(const CpuScene& scene, const V8& ro, const V8& rd) {
+    F8 depth = f8(0.0f);
+    M8 active = m8_true();
+    for (int i = 0; i < scene.quality.max_steps && m8_any(active); i++) {
+        F8 dist = cpu_scene_sdf(scene, ro + rd * depth);
+        depth = f8_select(active, depth + dist, depth);
+        active = m8_and_not(active, (dist < f8(scene.quality.epsilon)) | (depth > f8(scene.quality.max_dist)));
+    }
+    return depth;
+}
+
+V8 cpu_estimate_normal(const CpuScene& scene, const V8& p) {
+    F8 e = f8(scene.quality.epsilon);
+    V8 n = {
+        cpu_scene_sdf(scene, { p.x + e, p.y, p.z }) - cpu_scene_sdf(scene, { p.x - e, p.y, p.z }),
+        cpu_scene_sdf(scene, { p.x, p.y + e, p.z }) - cpu_scene_sdf(scene, { p.x, p.y - e, p.z }),
+        cpu_scene_sdf(scene, { p.x, p.y, p.z + e }) - cpu_scene_sdf(scene, { p.x, p.y, p.z - e }),
+    };
+    return v8_normalize(n);
+}
+
+F8 cpu_soft_shadow(const CpuScene& scene, const V8& ro, const V8& rd, float mint, float maxt, float k) {
+    F8 res = f8(1.0f);
+    F8 t = f8(mint);
+    M8 active = m8_true();
+    for (int i = 0; i < scene.quality.shadow_steps && m8_any(active); i++) {
+        F8 h = cpu_scene_sdf(scene, ro + rd * t);
+        M8 blocked = active & (h < f8(0.001f));
+        res = f8_select(blocked, f8(0.0f), res);
+        active = m8_and_not(active, blocked);
+        res = f8_select(active, f8_min(res, f8(k) * h / t), res);
+        t = f8_select(active, t + f8_clamp(h, 0.01f, 0.2f), t);
+        active = m8_and_not(active, t > f8(maxt));
+    }
+    return res;
+}
+
+F8 cpu_ambient_occlusion(const CpuScene& scene, const V8& p, const V8& n) {
+    // AO_MAX_DISTANCE in scene.glsl
+    const float max_distance = 0.5f;
+    int samples = scene.quality.ao_samples;
+    F8 ao = f8(0.0f);
+    for (int i = 1; i <= samples; i++) {
+        float t = static_cast<float>(i) / static_cast<float>(samples) * max_distance;
+        F8 d = cpu_scene_sdf(scene, p + n * f8(t));
+        F8 x = f8_clamp(f8(t) - d, 0.0f, 1.0f);
+        ao = ao + x * x * (f8(3.0f) - f8(2.0f) * x); // smoothstep(0, 1, t - d)
+    }
+    ao = ao * f8(1.0f / static_cast<float>(samples));
+    return f8_clamp(f8(1.0f) - ao, 0.0f, 1.0f);
+}
+
+float cpu_checkerboard(float x, float z) {
+    float q = floorf(x) + floorf(z);
+    return q - 2.0f * floorf(q / 2.0f); // GLSL mod(q, 2.0)
+}
+
+uint8_t cpu_unorm8(float value) {
+    float clamped = value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f;
+    return static_cast<uint8_t>(clamped * 255.0f + 0.5f);
+}
+
+void cpu_shade_packet(const CpuScene& scene, const Camera& camera, uint32_t width, uint32_t height, uint32_t x,
+    uint32_t y, uint8_t* pixels) {
+    // cameraBasis and cameraRay, per lane
+    float forward[3] = { camera.target[0] - camera.position[0], camera.target[1] - camera.position[1],
+        camera.target[2] - camera.position[2] };
+    float length = sqrtf(forward[0] * forward[0] + forward[1] * forward[1] + forward[2] * forward[2]);
+    for (float& c : forward) c /= length;
+    float right[3] = { -forward[2], 0.0f, forward[0] }; // cross(forward, (0, 1, 0))
+    length = sqrtf(right[0] * right[0] + right[2] * right[2]);
+    right[0] /= length;
+    right[2] /= length;
+    float up[3] = { right[1] * forward[2] - right[2] * forward[1], right[2] * forward[0] - right[0] * forward[2],
+        right[0] * forward[1] - right[1] * forward[0] };
+    float scale = tanf(60.0f * 3.14159265f / 180.0f * 0.5f); // FOV_DEGREES
+    float aspect = static_cast<float>(width) / static_cast<float>(height);
+
+    float rd_lanes[3][8];
+    for (uint32_t lane = 0; lane < 8; lane++) {
+        uint32_t px = x + lane < width ? x + lane : width - 1;
+        float u = (static_cast<float>(px) + 0.5f) / static_cast<float>(width) * 2.0f - 1.0f;
+        float v = (1.0f - (static_cast<float>(y) + 0.5f) / static_cast<float>(height)) * 2.0f - 1.0f;
+        u *= aspect;
+        float dir[3];
+        for (int c = 0; c < 3; c++) dir[c] = forward[c] + (u * scale) * right[c] + (v * scale) * up[c];
+        float inv = 1.0f / sqrtf(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+        for (int c = 0; c < 3; c++) rd_lanes[c][lane] = dir[c] * inv;
+    }
+    V8 ro = v8(camera.position[0], camera.position[1], camera.position[2]);
+    V8 rd = { f8_load(rd_lanes[0]), f8_load(rd_lanes[1]), f8_load(rd_lanes[2]) };
+
+    F8 d = cpu_ray_march(scene, ro, rd);
+    V8 p = ro + rd * d;
+    V8 normal = cpu_estimate_normal(scene, p);
+    const SceneLight& key = scene.lights[0];
+    V8 light_dir = v8_normalize(v8(key.position[0], key.position[1], key.position[2]) - p);
+    F8 diff = f8_max(v8_dot(normal, light_dir), f8(0.0f)) * f8(key.position[3]);
+    F8 shadow = cpu_soft_shadow(scene, p + normal * f8(scene.quality.epsilon * 2.0f), light_dir, 0.01f, 4.0f, 32.0f);
+    F8 ao = cpu_ambient_occlusion(scene, p, normal);
+    F8 closest = cpu_scene_closest(scene, p);
+    // the other lights are unshadowed
+    F8 fill[3] = { f8(0.0f), f8(0.0f), f8(0.0f) };
+    for (size_t i = 1; i < scene.lights.size(); i++) {
+        const SceneLight& light = scene.lights[i];
+        V8 to_light = v8_normalize(v8(light.position[0], light.position[1], light.position[2]) - p);
+        F8 lit = f8_max(v8_dot(normal, to_light), f8(0.0f)) * f8(light.position[3]);
+        for (int c = 0; c < 3; c++) fill[c] = fill[c] + lit * f8(light.color[c]);
+    }
+
+    float lanes[11][8];
+    f8_store(lanes[0], d);
+    f8_store(lanes[1], p.x);
+    f8_store(lanes[2], p.y);
+    f8_store(lanes[3], p.z);
+    f8_store(lanes[4], diff);
+    f8_store(lanes[5], shadow);
+    f8_store(lanes[6], ao);
+    f8_store(lanes[7], closest);
+    for (int c = 0; c < 3; c++) f8_store(lanes[8 + c], fill[c]);
+    for (uint32_t lane = 0; lane < 8 && x + lane < width; lane++) {
+        float color[3] = { 0.7f, 0.8f, 0.9f }; // background
+        if (lanes[0][lane] < scene.quality.max_dist) {
+            float point[3] = { lanes[1][lane], lanes[2][lane], lanes[3][lane] };
+            const float* material = scene.primitives[static_cast<uint32_t>(lanes[7][lane])].material;
+            float checker = material[3] > 0.5f ? cpu_checkerboard(point[0], point[2]) : 1.0f;
+            for (int c = 0; c < 3; c++) {
+                float albedo = material[c] * checker;
+                float lit = lanes[4][lane] * key.color[c] * lanes[5][lane] + lanes[8 + c][lane];
+                color[c] = albedo * lit * lanes[6][lane] + 0.1f * albedo * lanes[6][lane];
+            }
+        }
+        uint8_t* out = pixels + ((size_t)y * width + x + lane) * 4;
+        out[0] = cpu_unorm8(color[2]);
+        out[1] = cpu_unorm8(color[1]);
+        out[2] = cpu_unorm8(color[0]);
+        out[3] = 255;
+    }
+}
+
+void cpu_scene_distance(const CpuScene& scene, const float x[8], const float y[8], const float z[8], float d[8]) {
+    f8_store(d, cpu_scene_sdf(scene, { f8_load(x), f8_load(y), f8_load(z) }));
+}
+
+void cpu_primitives_distance(const SdfPrimitive* const* primitives, size_t count, float max_dist, const float x[8],
+    float y, float z, float d[8]) {
+    V8 p = { f8_load(x), f8(y), f8(z) };
+    F8 distance = f8(max_dist);
+    for (size_t i = 0; i < count; i++) distance = f8_min(distance, cpu_sd_primitive(*primitives[i], p));
+    f8_store(d, distance);
+}
@@ -0,0 +1,114 @@
+// Checks that the AVX2 kernels of the CPU reference marcher produce exactly the
+// bytes of the scalar ones, so the reference stays bit-comparable on every host.
+// Exits with 0 when they match, 1 when they differ and 77 (skipped) when the
+// AVX2 kernels were not built or the CPU lacks AVX2.
+
+#include "cpu_march.h"
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+SdfPrimitive make_primitive(SdfPrimitiveType type, float x, float y, float z, float p0, float p1, float p2,
+    float r, float g, float b, float checker) {
+    SdfPrimitive prim = {};
+    prim.position_type[0] = x;
+    prim.position_type[1] = y;
+    prim.position_type[2] = z;
+    prim.position_type[3] = static_cast<float>(type);
+    prim.params[0] = p0;
+    prim.params[1] = p1;
+    prim.params[2] = p2;
+    prim.material[0] = r;
+    prim.material[1] = g;
+    prim.material[2] = b;
+    prim.material[3] = checker;
+    return prim;
+}
+
+// Floor, boxes and spheres close enough together for shadows and AO to overlap.
+CpuScene make_scene() {
+    CpuScene scene;
+    scene.quality = { 100, 100.0f, 0.001f, 16, 16 };
+    scene.primitives.push_back(make_primitive(SDF_PLANE, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.8f, 0.8f, 0.8f, 1.0f));
+    scene.primitives.push_back(make_primitive(SDF_BOX, -1.2f, 0.5f, 0.0f, 0.5f, 0.5f, 0.5f, 0.9f, 0.3f, 0.2f, 0.0f));
+    scene.primitives.push_back(make_primitive(SDF_SPHERE, 0.6f, 0.7f, 0.3f, 0.7f, 0.0f, 0.0f, 0.2f, 0.5f, 0.9f, 0.0f));
+    for (int i = 0; i < 6; i++) {
+        float x = -2.5f + static_cast<float>(i);
+        scene.primitives.push_back(
+            make_primitive(SDF_SPHERE, x, 0.25f, 1.6f, 0.25f, 0.0f, 0.0f, 0.3f + 0.1f * i, 0.8f, 0.4f, 0.0f));
+    }
+    scene.lights.push_back({ { 3.0f, 5.0f, 2.0f, 1.0f }, { 1.0f, 0.95f, 0.9f, 0.0f } });
+    scene.lights.push_back({ { -4.0f, 3.0f, -1.0f, 0.4f }, { 0.4f, 0.5f, 1.0f, 0.0f } });
+    return scene;
+}
+
+// Odd sizes leave a partial packet at the end of every row.
+std::vector<uint8_t> shade_frame(const CpuMarcher& marcher, const CpuScene& scene, const Camera& camera,
+    uint32_t width, uint32_t height) {
+    std::vector<uint8_t> pixels((size_t)width * height * 4);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x += 8) marcher.shade_packet(scene, camera, width, height, x, y, pixels.data());
+    }
+    return pixels;
+}
+
+int main() {
+#if COAL_CPU_AVX2
+    if (&cpu_marcher() != &CPU_MARCHER_AVX2) {
+        std::cout << "skipped: the CPU lacks AVX2\n";
+        return 77;
+    }
+    CpuScene scene = make_scene();
+    const Camera cameras[2] = {
+        { { 0.0f, 1.5f, -4.0f }, { 0.0f, 0.5f, 0.0f } },
+        { { 3.5f, 0.4f, 2.5f }, { -0.5f, 0.6f, 0.0f } },
+    };
+    const uint32_t width = 203;
+    const uint32_t height = 97;
+    int failures = 0;
+    for (const Camera& camera : cameras) {
+        std::vector<uint8_t> scalar = shade_frame(CPU_MARCHER_SCALAR, scene, camera, width, height);
+        std::vector<uint8_t> avx2 = shade_frame(CPU_MARCHER_AVX2, scene, camera, width, height);
+        size_t differing = 0;
+        for (size_t i = 0; i < scalar.size(); i++) {
+            if (scalar[i] != avx2[i]) differing++;
+        }
+        if (differing > 0) {
+            std::cout << differing << " of " << scalar.size() << " bytes differ between the scalar and AVX2 frames\n";
+            failures++;
+        }
+    }
+
+    // the brick baker's entry points, at points inside, on and outside the surfaces
+    float x[8], y[8], z[8];
+    for (int i = 0; i < 8; i++) {
+        x[i] = -3.0f + 0.8f * static_cast<float>(i);
+        y[i] = 0.1f * static_cast<float>(i);
+        z[i] = 0.25f * static_cast<float>(i) - 0.5f;
+    }
+    float scalar_d[8], avx2_d[8];
+    CPU_MARCHER_SCALAR.scene_distance(scene, x, y, z, scalar_d);
+    CPU_MARCHER_AVX2.scene_distance(scene, x, y, z, avx2_d);
+    if (0 != memcmp(scalar_d, avx2_d, sizeof(scalar_d))) {
+        std::cout << "scene distances differ between the scalar and AVX2 kernels\n";
+        failures++;
+    }
+    std::vector<const SdfPrimitive*> primitives;
+    for (const SdfPrimitive& prim : scene.primitives) primitives.push_back(&prim);
+    CPU_MARCHER_SCALAR.primitives_distance(primitives.data(), primitives.size(), scene.quality.max_dist, x, 0.3f,
+        0.2f, scalar_d);
+    CPU_MARCHER_AVX2.primitives_distance(primitives.data(), primitives.size(), scene.quality.max_dist, x, 0.3f,
+        0.2f, avx2_d);
+    if (0 != memcmp(scalar_d, avx2_d, sizeof(scalar_d))) {
+        std::cout << "primitive distances differ between the scalar and AVX2 kernels\n";
+        failures++;
+    }
+    if (failures == 0) std::cout << "scalar and AVX2 kernels match\n";
+    return failures == 0 ? 0 : 1;
+#else
+    std::cout << "skipped: built without the AVX2 kernels\n";
+    return 77;
+#endif
+}
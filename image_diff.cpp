@@ -0,0 +1,180 @@
+// Compares two binary PPM frames, e.g. a GPU run against the CPU reference:
+//
+//   HelloWorld --headless --frames 1 --lighting-scale 1 --no-prepass --no-brick-map --output gpu.ppm
+//   HelloWorld --cpu --frames 1 --output cpu.ppm
+//   image_diff gpu.ppm cpu.ppm --tolerance 8 --max-bad 0.5 --heatmap diff.ppm
+//
+// Exits with 0 when at most --max-bad percent of the pixels differ by more than
+// --tolerance in any channel, 1 when more do, and 2 on bad input.
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct Image {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> rgb;
+};
+
+// Header tokens, skipping whitespace and # comments.
+bool read_token(std::istream& in, std::string& token) {
+    token.clear();
+    char c;
+    while (in.get(c)) {
+        if (c == '#') {
+            std::string comment;
+            std::getline(in, comment);
+        } else if (!std::isspace(static_cast<unsigned char>(c))) {
+            token += c;
+            break;
+        }
+    }
+    while (in.get(c) && !std::isspace(static_cast<unsigned char>(c))) token += c;
+    return !token.empty();
+}
+
+// A positive decimal size, capped so that width * height * 3 cannot overflow.
+int parse_dimension(const std::string& token, uint32_t& value) {
+    const char* begin = token.c_str();
+    char* end = nullptr;
+    unsigned long parsed = std::strtoul(begin, &end, 10);
+    if (end == begin || *end != '\0' || !std::isdigit(static_cast<unsigned char>(token[0])) || parsed == 0 ||
+        parsed > 65535) {
+        return -1;
+    }
+    value = static_cast<uint32_t>(parsed);
+    return 0;
+}
+
+// --tolerance: a channel difference from 0 to 255.
+int parse_tolerance(const char* text, int& value) {
+    char* end = nullptr;
+    long parsed = std::strtol(text, &end, 10);
+    if (end == text || *end != '\0' || parsed < 0 || parsed > 255) return -1;
+    value = static_cast<int>(parsed);
+    return 0;
+}
+
+// --max-bad: a percentage from 0 to 100.
+int parse_percent(const char* text, double& value) {
+    char* end = nullptr;
+    double parsed = std::strtod(text, &end);
+    if (end == text || *end != '\0' || !(parsed >= 0.0 && parsed <= 100.0)) return -1;
+    value = parsed;
+    return 0;
+}
+
+int read_ppm(const std::string& path, Image& image) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "failed to open " << path << "\n";
+        return -1;
+    }
+    std::string magic, width, height, max_value;
+    if (!read_token(file, magic) || magic != "P6" || !read_token(file, width) || !read_token(file, height) ||
+        !read_token(file, max_value) || max_value != "255") {
+        std::cout << path << " is not an 8-bit binary PPM\n";
+        return -1;
+    }
+    if (0 != parse_dimension(width, image.width) || 0 != parse_dimension(height, image.height)) {
+        std::cout << path << " has a bad size " << width << "x" << height << "\n";
+        return -1;
+    }
+    image.rgb.resize((size_t)image.width * image.height * 3);
+    file.read(reinterpret_cast<char*>(image.rgb.data()), static_cast<std::streamsize>(image.rgb.size()));
+    if (!file) {
+        std::cout << path << " is truncated\n";
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> paths;
+    int tolerance = 8;
+    double max_bad_percent = 0.5;
+    std::string heatmap_path;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--tolerance" && has_value) {
+            if (0 != parse_tolerance(argv[++i], tolerance)) {
+                std::cout << "bad --tolerance " << argv[i] << ", expected 0 to 255\n";
+                return 2;
+            }
+        } else if (arg == "--max-bad" && has_value) {
+            if (0 != parse_percent(argv[++i], max_bad_percent)) {
+                std::cout << "bad --max-bad " << argv[i] << ", expected 0 to 100\n";
+                return 2;
+            }
+        } else if (arg == "--heatmap" && has_value) {
+            heatmap_path = argv[++i];
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    if (paths.size() != 2) {
+        std::cout << "usage: image_diff a.ppm b.ppm [--tolerance N] [--max-bad PERCENT] [--heatmap out.ppm]\n";
+        return 2;
+    }
+
+    Image a, b;
+    if (0 != read_ppm(paths[0], a) || 0 != read_ppm(paths[1], b)) return 2;
+    if (a.width != b.width || a.height != b.height) {
+        std::cout << "size mismatch: " << a.width << "x" << a.height << " vs " << b.width << "x" << b.height << "\n";
+        return 2;
+    }
+
+    size_t pixels = (size_t)a.width * a.height;
+    size_t bad = 0;
+    int max_error = 0;
+    double squared_error = 0.0;
+    std::vector<uint8_t> heatmap(pixels * 3);
+    for (size_t i = 0; i < pixels; i++) {
+        int error = 0;
+        for (int c = 0; c < 3; c++) {
+            int d = std::abs(int(a.rgb[i * 3 + c]) - int(b.rgb[i * 3 + c]));
+            error = std::max(error, d);
+            squared_error += double(d) * d;
+        }
+        max_error = std::max(max_error, error);
+        if (error > tolerance) bad++;
+        // black where equal, green within tolerance, red beyond
+        uint8_t level = static_cast<uint8_t>(std::min(255, 64 + error * 8));
+        heatmap[i * 3 + 0] = error > tolerance ? level : 0;
+        heatmap[i * 3 + 1] = error > 0 && error <= tolerance ? level : 0;
+        heatmap[i * 3 + 2] = 0;
+    }
+
+    double mse = squared_error / double(pixels * 3);
+    double bad_percent = 100.0 * double(bad) / double(pixels);
+    std::cout << "max channel error " << max_error << ", ";
+    if (mse > 0.0) {
+        std::cout << "PSNR " << 10.0 * std::log10(255.0 * 255.0 / mse) << " dB, ";
+    } else {
+        std::cout << "identical, ";
+    }
+    std::cout << bad << " pixels (" << bad_percent << "%) beyond tolerance " << tolerance << "\n";
+
+    if (!heatmap_path.empty()) {
+        std::ofstream file(heatmap_path, std::ios::binary);
+        if (!file.is_open()) {
+            std::cout << "failed to open " << heatmap_path << " for writing\n";
+            return 2;
+        }
+        file << "P6\n" << a.width << " " << a.height << "\n255\n";
+        file.write(reinterpret_cast<const char*>(heatmap.data()), static_cast<std::streamsize>(heatmap.size()));
+        if (!file) {
+            std::cout << "failed to write " << heatmap_path << "\n";
+            return 2;
+        }
+    }
+    return bad_percent <= max_bad_percent ? 0 : 1;
+}
@@ -0,0 +1,724 @@
+// Render graph: declaration, compilation and recording (see render_graph.h).
+#include "render_graph.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+VkImageMemoryBarrier image_barrier(VkImage image, VkImageLayout old_layout, VkImageLayout new_layout,
+    VkAccessFlags src_access, VkAccessFlags dst_access) {
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
+    barrier.oldLayout = old_layout;
+    barrier.newLayout = new_layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.layerCount = 1;
+    return barrier;
+}
+
+const VkAccessFlags RG_WRITE_ACCESS = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+RgAccess rg_access(RgUsage usage) {
+    const VkAccessFlags shader_read_write = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    switch (usage) {
+        case RG_COMPUTE_READ:
+            return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, true, false };
+        case RG_COMPUTE_READ_WRITE:
+            return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, shader_read_write, VK_IMAGE_LAYOUT_GENERAL, true, true };
+        case RG_FRAGMENT_READ:
+            return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, true, false };
+        case RG_FRAGMENT_READ_WRITE:
+            return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, shader_read_write, VK_IMAGE_LAYOUT_GENERAL, true, true };
+        case RG_COLOR_ATTACHMENT:
+            // only read with LOAD_OP_LOAD, see rg_use_access
+            return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, false, true };
+        case RG_TRANSFER_SRC:
+            return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, true, false };
+        case RG_TRANSFER_DST:
+            return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, false, true };
+        case RG_PRESENT:
+            return { VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, true, false };
+        case RG_HOST_READ:
+        default:
+            return { VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, true, false };
+    }
+}
+
+void rg_begin(RenderGraph& graph) {
+    graph.resources.clear();
+    graph.passes.clear();
+    graph.final_barriers = RgBarriers{};
+    graph.present = RG_NONE;
+}
+
+// Imports without an initial state are persistent: they continue from the state
+// the previous frame left them in.
+RgHandle rg_import_image(RenderGraph& graph, const char* name, VkImage image, VkImageView view, VkFormat format,
+    VkExtent2D extent, const RgState* initial) {
+    RgResource resource = {};
+    resource.name = name;
+    resource.image = image;
+    resource.view = view;
+    resource.format = format;
+    resource.extent = extent;
+    resource.persistent = initial == nullptr;
+    if (initial != nullptr) {
+        resource.state = *initial;
+    } else {
+        auto found = graph.external_states.find(rg_key(image));
+        if (found != graph.external_states.end()) resource.state = found->second;
+    }
+    graph.resources.push_back(resource);
+    return static_cast<RgHandle>(graph.resources.size() - 1);
+}
+
+RgHandle rg_import_buffer(RenderGraph& graph, const char* name, VkBuffer buffer, const RgState* initial) {
+    RgResource resource = {};
+    resource.name = name;
+    resource.buffer = buffer;
+    resource.persistent = initial == nullptr;
+    if (initial != nullptr) {
+        resource.state = *initial;
+    } else {
+        auto found = graph.external_states.find(rg_key(buffer));
+        if (found != graph.external_states.end()) resource.state = found->second;
+    }
+    graph.resources.push_back(resource);
+    return static_cast<RgHandle>(graph.resources.size() - 1);
+}
+
+// Drops the carried state of a persistent import that is about to be destroyed.
+void rg_forget(RenderGraph& graph, uint64_t key) {
+    graph.external_states.erase(key);
+}
+
+RgHandle rg_use_transient(RenderGraph& graph, uint32_t transient) {
+    const RgTransient& declared = graph.transients[transient];
+    RgResource resource = {};
+    resource.name = declared.name;
+    resource.image = declared.image;
+    resource.view = declared.view;
+    resource.format = declared.format;
+    resource.extent = declared.extent;
+    resource.transient = transient;
+    graph.resources.push_back(resource);
+    return static_cast<RgHandle>(graph.resources.size() - 1);
+}
+
+// The contents are used after the frame (by the next frame), so passes writing the
+// resource are never culled.
+void rg_retain(RenderGraph& graph, RgHandle resource) {
+    graph.resources[resource].retained = true;
+}
+
+// Retains the resource and leaves it in `usage` at the end of the frame.
+void rg_set_final(RenderGraph& graph, RgHandle resource, RgUsage usage) {
+    graph.resources[resource].retained = true;
+    graph.resources[resource].has_final = true;
+    graph.resources[resource].final_usage = usage;
+    if (usage == RG_PRESENT) graph.present = resource;
+}
+
+uint32_t rg_add_pass(RenderGraph& graph, const char* name, uint32_t scope, std::function<void(VkCommandBuffer)> record) {
+    RgPass pass;
+    pass.name = name;
+    pass.scope = scope;
+    pass.record = std::move(record);
+    graph.passes.push_back(std::move(pass));
+    return static_cast<uint32_t>(graph.passes.size() - 1);
+}
+
+void rg_use(RenderGraph& graph, uint32_t pass, RgHandle resource, RgUsage usage) {
+    graph.passes[pass].uses.push_back({ resource, usage });
+}
+
+// Makes `pass` a raster pass: the graph begins a render pass on `resource` around
+// the record callback, with viewport and scissor set to render_area.
+void rg_color_attachment(RenderGraph& graph, uint32_t pass, RgHandle resource, VkAttachmentLoadOp load_op,
+    VkExtent2D render_area) {
+    graph.passes[pass].color = resource;
+    graph.passes[pass].load_op = load_op;
+    graph.passes[pass].render_area = render_area;
+    rg_use(graph, pass, resource, RG_COLOR_ATTACHMENT);
+}
+
+static RgAccess rg_use_access(const RgPass& pass, const RgUse& use) {
+    RgAccess access = rg_access(use.usage);
+    if (use.usage == RG_COLOR_ATTACHMENT) access.reads = pass.load_op == VK_ATTACHMENT_LOAD_OP_LOAD;
+    return access;
+}
+
+// Adds whatever `access` needs on top of the resource's current state to
+// `barriers` and advances the state.
+static void rg_sync(RgResource& resource, const RgAccess& access, RgBarriers& barriers) {
+    RgState& state = resource.state;
+    bool image = resource.image != VK_NULL_HANDLE;
+    bool transition = image && state.layout != access.layout;
+
+    VkPipelineStageFlags src_stages = state.write_stages;
+    bool needed;
+    if (access.writes || transition) {
+        // write-after-read only needs the readers to finish
+        src_stages |= state.read_stages;
+        needed = transition || src_stages != 0;
+    } else {
+        // read-after-read is free once the last write is visible to these stages
+        needed = state.write_stages != 0 &&
+            ((access.stages & ~state.visible_stages) != 0 || (access.access & ~state.visible_access) != 0);
+    }
+
+    if (needed) {
+        barriers.src_stages |= src_stages != 0 ? src_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        barriers.dst_stages |= access.stages;
+        if (image) {
+            barriers.images.push_back(image_barrier(resource.image, state.layout, access.layout,
+                state.write_access, access.access));
+        } else {
+            VkBufferMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcAccessMask = state.write_access;
+            barrier.dstAccessMask = access.access;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.buffer = resource.buffer;
+            barrier.size = VK_WHOLE_SIZE;
+            barriers.buffers.push_back(barrier);
+        }
+    }
+
+    if (access.writes) {
+        state.write_stages = access.stages;
+        state.write_access = access.access & RG_WRITE_ACCESS;
+        state.read_stages = 0;
+        state.visible_stages = 0;
+        state.visible_access = 0;
+    } else if (transition) {
+        // the transition is a write in these stages; later readers chain after it
+        state.write_stages = access.stages;
+        state.write_access = 0;
+        state.read_stages = 0;
+        state.visible_stages = access.stages;
+        state.visible_access = access.access;
+    } else {
+        state.read_stages |= access.stages;
+        if (needed) {
+            state.visible_stages |= access.stages;
+            state.visible_access |= access.access;
+        }
+    }
+    if (image) state.layout = access.layout;
+}
+
+// The resource was last accessed on the other queue, whose batch `release_batch`
+// the caller waits for in `access.stages`. When the queue families differ and
+// the contents are kept, ownership moves with a release barrier at the end of
+// that batch and a matching acquire in `barriers`, both doing any layout change.
+// The semaphore covers everything else; barriers on this queue only have to
+// start from the stages it blocks.
+static void rg_transfer(RenderGraph& graph, RgResource& resource, const RgAccess& access, uint32_t release_batch,
+    RgQueue queue, RgBarriers& barriers) {
+    RgState& state = resource.state;
+    bool image = resource.image != VK_NULL_HANDLE;
+    uint32_t src_family = graph.queue_families[state.queue];
+    uint32_t dst_family = graph.queue_families[queue];
+    bool transferred = src_family != dst_family && (!image || state.layout != VK_IMAGE_LAYOUT_UNDEFINED);
+    if (transferred) {
+        RgBarriers& release = graph.batches[release_batch].release;
+        VkPipelineStageFlags src_stages = state.write_stages | state.read_stages;
+        release.src_stages |= src_stages != 0 ? src_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        release.dst_stages |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+        barriers.src_stages |= access.stages;
+        barriers.dst_stages |= access.stages;
+        if (image) {
+            VkImageMemoryBarrier barrier = image_barrier(resource.image, state.layout, access.layout,
+                state.write_access, 0);
+            barrier.srcQueueFamilyIndex = src_family;
+            barrier.dstQueueFamilyIndex = dst_family;
+            release.images.push_back(barrier);
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = access.access;
+            barriers.images.push_back(barrier);
+            state.layout = access.layout;
+        } else {
+            VkBufferMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcAccessMask = state.write_access;
+            barrier.dstAccessMask = 0;
+            barrier.srcQueueFamilyIndex = src_family;
+            barrier.dstQueueFamilyIndex = dst_family;
+            barrier.buffer = resource.buffer;
+            barrier.size = VK_WHOLE_SIZE;
+            release.buffers.push_back(barrier);
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = access.access;
+            barriers.buffers.push_back(barrier);
+        }
+    }
+    // the acquire is the whole dependency; otherwise a discarding transition
+    // still has to come after the wait
+    state.write_stages = transferred ? 0 : access.stages;
+    state.write_access = 0;
+    state.read_stages = 0;
+    state.visible_stages = 0;
+    state.visible_access = 0;
+    state.queue = queue;
+}
+
+static bool rg_lifetimes_overlap(uint32_t first_a, uint32_t last_a, uint32_t first_b, uint32_t last_b) {
+    if (first_a == UINT32_MAX || first_b == UINT32_MAX) return false;
+    return first_a <= last_b && first_b <= last_a;
+}
+
+// Culls passes whose writes nobody reads, groups the rest into batches per queue
+// and computes the barriers before each pass and at the end of the frame. A plan
+// compile (before rg_realize) records transient lifetimes instead of touching
+// any state carried across frames, with every pass on the graphics queue.
+void rg_compile(RenderGraph& graph, bool plan) {
+    std::vector<bool> needed(graph.resources.size(), false);
+    for (size_t i = graph.passes.size(); i-- > 0;) {
+        RgPass& pass = graph.passes[i];
+        bool live = false;
+        for (const RgUse& use : pass.uses) {
+            const RgResource& resource = graph.resources[use.resource];
+            if (rg_use_access(pass, use).writes && (resource.retained || needed[use.resource])) live = true;
+        }
+        pass.culled = !live;
+        if (!live) continue;
+        // earlier writers only matter if this pass reads what they wrote
+        for (const RgUse& use : pass.uses) {
+            RgAccess access = rg_use_access(pass, use);
+            if (access.writes && !access.reads) needed[use.resource] = false;
+        }
+        for (const RgUse& use : pass.uses) {
+            if (rg_use_access(pass, use).reads) needed[use.resource] = true;
+        }
+    }
+
+    std::vector<uint32_t> first_pass(graph.transients.size(), UINT32_MAX);
+    std::vector<uint32_t> last_pass(graph.transients.size(), 0);
+    // batch of the last access in this frame; anything untouched so far is on the
+    // graphics queue, where batch 0 comes after every earlier frame
+    std::vector<uint32_t> last_batch(graph.resources.size(), 0);
+    std::vector<uint32_t> block_batch(graph.blocks.size(), 0);
+    bool async = graph.async && !plan;
+    bool present_seen = false;
+    graph.batches.assign(1, RgBatch{});
+    graph.present_batch = 0;
+    for (uint32_t i = 0; i < graph.passes.size(); i++) {
+        RgPass& pass = graph.passes[i];
+        pass.barriers = RgBarriers{};
+        if (pass.culled) continue;
+
+        RgQueue queue = async && pass.async ? RG_QUEUE_COMPUTE : RG_QUEUE_GRAPHICS;
+        uint32_t wait = UINT32_MAX;
+        VkPipelineStageFlags wait_stages = 0;
+        for (const RgUse& use : pass.uses) {
+            RgResource& resource = graph.resources[use.resource];
+            uint32_t transient = resource.transient;
+            uint32_t block = transient != UINT32_MAX ? graph.transients[transient].block : UINT32_MAX;
+            if (!resource.used && block != UINT32_MAX) {
+                // contents are discarded; only order after the memory's previous user
+                resource.state = graph.blocks[block].state;
+                resource.state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+                last_batch[use.resource] = block_batch[block];
+            }
+            resource.used = true;
+            if (resource.state.queue != queue) {
+                wait = wait == UINT32_MAX ? last_batch[use.resource] : std::max(wait, last_batch[use.resource]);
+                wait_stages |= rg_use_access(pass, use).stages;
+            }
+        }
+        if (queue == RG_QUEUE_COMPUTE && wait == UINT32_MAX) {
+            // batch 0 resets the frame's timestamp queries
+            wait = 0;
+            wait_stages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        }
+
+        // a new wait starts a new batch, so the passes before it don't wait too
+        RgBatch* batch = &graph.batches.back();
+        bool covered = wait == UINT32_MAX || (batch->wait != UINT32_MAX && batch->wait >= wait);
+        if (batch->queue != queue || (!covered && !batch->passes.empty())) {
+            graph.batches.push_back(RgBatch{});
+            batch = &graph.batches.back();
+            batch->queue = queue;
+        }
+        if (wait != UINT32_MAX) {
+            batch->wait = batch->wait == UINT32_MAX ? wait : std::max(batch->wait, wait);
+            batch->wait_stages |= wait_stages;
+        }
+        batch->passes.push_back(i);
+        uint32_t batch_index = static_cast<uint32_t>(graph.batches.size() - 1);
+
+        for (const RgUse& use : pass.uses) {
+            RgResource& resource = graph.resources[use.resource];
+            RgAccess access = rg_use_access(pass, use);
+            if (resource.state.queue != queue) {
+                rg_transfer(graph, resource, access, last_batch[use.resource], queue, pass.barriers);
+            }
+            rg_sync(resource, access, pass.barriers);
+            last_batch[use.resource] = batch_index;
+            if (use.resource == graph.present && !present_seen) {
+                graph.present_batch = batch_index;
+                present_seen = true;
+            }
+            uint32_t transient = resource.transient;
+            if (transient == UINT32_MAX) continue;
+            first_pass[transient] = std::min(first_pass[transient], i);
+            last_pass[transient] = std::max(last_pass[transient], i);
+            uint32_t block = graph.transients[transient].block;
+            if (!plan && block != UINT32_MAX) {
+                graph.blocks[block].state = resource.state;
+                block_batch[block] = batch_index;
+            }
+        }
+    }
+
+    // the last batch waits for the compute queue's last one, so the frame's
+    // timeline value covers both queues; whatever the compute queue still holds
+    // comes back to graphics for the next frame
+    uint32_t last_compute = UINT32_MAX;
+    for (uint32_t b = 0; b < graph.batches.size(); b++) {
+        if (graph.batches[b].queue == RG_QUEUE_COMPUTE) last_compute = b;
+    }
+    if (last_compute != UINT32_MAX) {
+        const RgBatch& tail = graph.batches.back();
+        if (tail.queue != RG_QUEUE_GRAPHICS || tail.wait != last_compute) {
+            graph.batches.push_back(RgBatch{});
+            graph.batches.back().wait = last_compute;
+        }
+        graph.batches.back().wait_stages |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    }
+    // later frames order after the returned resources through the last batch
+    RgAccess returned = { VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+        VK_IMAGE_LAYOUT_UNDEFINED, true, true };
+    auto return_state = [&](RgState& state) {
+        state.queue = RG_QUEUE_GRAPHICS;
+        state.write_stages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        state.write_access = VK_ACCESS_MEMORY_WRITE_BIT;
+    };
+
+    for (uint32_t r = 0; r < graph.resources.size(); r++) {
+        RgResource& resource = graph.resources[r];
+        if (resource.state.queue != RG_QUEUE_GRAPHICS) {
+            // transients are discarded by the next frame and need no ownership
+            if (resource.transient == UINT32_MAX) {
+                returned.layout = resource.state.layout;
+                rg_transfer(graph, resource, returned, last_batch[r], RG_QUEUE_GRAPHICS, graph.final_barriers);
+            }
+            return_state(resource.state);
+        }
+        if (resource.has_final) rg_sync(resource, rg_access(resource.final_usage), graph.final_barriers);
+        if (!plan && resource.persistent) {
+            graph.external_states[resource.image != VK_NULL_HANDLE ? rg_key(resource.image) : rg_key(resource.buffer)] =
+                resource.state;
+        }
+    }
+
+    for (RgMemoryBlock& block : graph.blocks) {
+        if (!plan && block.state.queue != RG_QUEUE_GRAPHICS) return_state(block.state);
+    }
+
+    if (plan) {
+        for (size_t t = 0; t < graph.transients.size(); t++) {
+            graph.transients[t].first_pass = first_pass[t];
+            graph.transients[t].last_pass = last_pass[t];
+        }
+        return;
+    }
+
+    // aliasing was planned from a frame declaring every optional pass, so block
+    // mates overlapping here is a graph bug that would corrupt them
+    for (const RgMemoryBlock& block : graph.blocks) {
+        for (size_t a = 0; a < block.transients.size(); a++) {
+            for (size_t b = a + 1; b < block.transients.size(); b++) {
+                uint32_t ta = block.transients[a], tb = block.transients[b];
+                if (rg_lifetimes_overlap(first_pass[ta], last_pass[ta], first_pass[tb], last_pass[tb])) {
+                    std::cout << "render graph: aliased transients " << graph.transients[ta].name << " and "
+                              << graph.transients[tb].name << " overlap\n";
+                    assert(!"aliased transients overlap");
+                    throw std::runtime_error("render graph aliasing does not cover this frame");
+                }
+            }
+        }
+    }
+}
+
+// Render passes are cached per attachment format and load op. Layouts are left to
+// the graph's barriers, so the attachment stays in COLOR_ATTACHMENT_OPTIMAL.
+VkRenderPass rg_render_pass(const vkb::DispatchTable& disp, RenderGraph& graph, VkFormat format, VkAttachmentLoadOp load_op) {
+    auto key = std::make_pair(format, load_op);
+    auto found = graph.render_passes.find(key);
+    if (found != graph.render_passes.end()) return found->second;
+
+    VkAttachmentDescription color_attachment = {};
+    color_attachment.format = format;
+    color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    color_attachment.loadOp = load_op;
+    color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    color_attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    color_attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference color_attachment_ref = {};
+    color_attachment_ref.attachment = 0;
+    color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &color_attachment_ref;
+
+    VkRenderPassCreateInfo render_pass_info = {};
+    render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    render_pass_info.attachmentCount = 1;
+    render_pass_info.pAttachments = &color_attachment;
+    render_pass_info.subpassCount = 1;
+    render_pass_info.pSubpasses = &subpass;
+
+    VkRenderPass render_pass = VK_NULL_HANDLE;
+    if (disp.createRenderPass(&render_pass_info, nullptr, &render_pass) != VK_SUCCESS) {
+        std::cout << "failed to create render pass\n";
+        return VK_NULL_HANDLE;
+    }
+    graph.render_passes[key] = render_pass;
+    return render_pass;
+}
+
+VkFramebuffer rg_framebuffer(const vkb::DispatchTable& disp, RenderGraph& graph, VkRenderPass render_pass, const RgResource& attachment) {
+    auto key = std::make_pair(render_pass, attachment.view);
+    auto found = graph.framebuffers.find(key);
+    if (found != graph.framebuffers.end()) return found->second;
+
+    VkFramebufferCreateInfo framebuffer_info = {};
+    framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebuffer_info.renderPass = render_pass;
+    framebuffer_info.attachmentCount = 1;
+    framebuffer_info.pAttachments = &attachment.view;
+    framebuffer_info.width = attachment.extent.width;
+    framebuffer_info.height = attachment.extent.height;
+    framebuffer_info.layers = 1;
+
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    if (disp.createFramebuffer(&framebuffer_info, nullptr, &framebuffer) != VK_SUCCESS) {
+        std::cout << "failed to create framebuffer for " << attachment.name << "\n";
+        return VK_NULL_HANDLE;
+    }
+    graph.framebuffers[key] = framebuffer;
+    return framebuffer;
+}
+
+// Framebuffers are created on first use; detach them before their views go away.
+RgRetired rg_detach_framebuffers(RenderGraph& graph) {
+    RgRetired retired;
+    for (auto& entry : graph.framebuffers) retired.framebuffers.push_back(entry.second);
+    graph.framebuffers.clear();
+    return retired;
+}
+
+void rg_barriers(const vkb::DispatchTable& disp, VkCommandBuffer cmd, const RgBarriers& barriers) {
+    if (barriers.images.empty() && barriers.buffers.empty()) return;
+    disp.cmdPipelineBarrier(cmd, barriers.src_stages, barriers.dst_stages, 0, 0, nullptr,
+        static_cast<uint32_t>(barriers.buffers.size()), barriers.buffers.data(),
+        static_cast<uint32_t>(barriers.images.size()), barriers.images.data());
+}
+
+// Records one pass after its barriers; raster passes inside their render pass.
+void rg_record_pass(const vkb::DispatchTable& disp, RenderGraph& graph, VkCommandBuffer cmd, const RgPass& pass) {
+    rg_barriers(disp, cmd, pass.barriers);
+
+    if (pass.color == RG_NONE) {
+        pass.record(cmd);
+    } else {
+        const RgResource& attachment = graph.resources[pass.color];
+        VkRenderPass render_pass = rg_render_pass(disp, graph, attachment.format, pass.load_op);
+        VkFramebuffer framebuffer =
+            render_pass != VK_NULL_HANDLE ? rg_framebuffer(disp, graph, render_pass, attachment) : VK_NULL_HANDLE;
+        if (framebuffer == VK_NULL_HANDLE) {
+            throw std::runtime_error("failed to begin render graph pass");
+        }
+
+        // cleared attachments start out transparent black
+        VkClearValue clear_value = {};
+        VkRenderPassBeginInfo render_pass_info = {};
+        render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        render_pass_info.renderPass = render_pass;
+        render_pass_info.framebuffer = framebuffer;
+        render_pass_info.renderArea.offset = { 0, 0 };
+        render_pass_info.renderArea.extent = pass.render_area;
+        if (pass.load_op == VK_ATTACHMENT_LOAD_OP_CLEAR) {
+            render_pass_info.clearValueCount = 1;
+            render_pass_info.pClearValues = &clear_value;
+        }
+
+        VkViewport viewport = {};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = (float)pass.render_area.width;
+        viewport.height = (float)pass.render_area.height;
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+
+        VkRect2D scissor = {};
+        scissor.offset = { 0, 0 };
+        scissor.extent = pass.render_area;
+
+        disp.cmdSetViewport(cmd, 0, 1, &viewport);
+        disp.cmdSetScissor(cmd, 0, 1, &scissor);
+
+        disp.cmdBeginRenderPass(cmd, &render_pass_info,
+            pass.secondary ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+        pass.record(cmd);
+        disp.cmdEndRenderPass(cmd);
+    }
+}
+
+uint32_t rg_add_transient(RenderGraph& graph, const char* name, VkExtent2D extent, VkFormat format,
+    VkImageUsageFlags usage) {
+    RgTransient transient = {};
+    transient.name = name;
+    transient.extent = extent;
+    transient.format = format;
+    transient.usage = usage;
+    graph.transients.push_back(transient);
+    return static_cast<uint32_t>(graph.transients.size() - 1);
+}
+
+// Detaches every transient, its memory and the framebuffers; they are declared
+// again after a resize.
+RgRetired rg_detach_transients(RenderGraph& graph) {
+    RgRetired retired = rg_detach_framebuffers(graph);
+    retired.transients = std::move(graph.transients);
+    retired.blocks = std::move(graph.blocks);
+    graph.transients.clear();
+    graph.blocks.clear();
+    graph.transient_bytes = 0;
+    graph.unaliased_bytes = 0;
+    return retired;
+}
+
+void rg_destroy_retired(const vkb::DispatchTable& disp, VmaAllocator allocator, RgRetired& retired) {
+    for (auto framebuffer : retired.framebuffers) disp.destroyFramebuffer(framebuffer, nullptr);
+    for (auto& transient : retired.transients) {
+        if (transient.view != VK_NULL_HANDLE) disp.destroyImageView(transient.view, nullptr);
+        if (transient.image != VK_NULL_HANDLE) disp.destroyImage(transient.image, nullptr);
+    }
+    for (auto& block : retired.blocks) {
+        if (block.allocation != VK_NULL_HANDLE) vmaFreeMemory(allocator, block.allocation);
+    }
+    retired = RgRetired{};
+}
+
+// Creates the declared transients and packs them into memory blocks, largest
+// first, sharing a block between images whose lifetimes from the last plan
+// compile do not overlap.
+int rg_realize(const vkb::DispatchTable& disp, VmaAllocator allocator, RenderGraph& graph) {
+    std::vector<VkMemoryRequirements> requirements(graph.transients.size());
+    std::vector<uint32_t> order;
+    for (uint32_t t = 0; t < graph.transients.size(); t++) {
+        RgTransient& transient = graph.transients[t];
+
+        VkImageCreateInfo image_info = {};
+        image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_info.imageType = VK_IMAGE_TYPE_2D;
+        image_info.format = transient.format;
+        image_info.extent = { transient.extent.width, transient.extent.height, 1 };
+        image_info.mipLevels = 1;
+        image_info.arrayLayers = 1;
+        image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_info.usage = transient.usage;
+        image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        if (disp.createImage(&image_info, nullptr, &transient.image) != VK_SUCCESS) {
+            std::cout << "failed to create transient image " << transient.name << "\n";
+            return -1;
+        }
+        disp.getImageMemoryRequirements(transient.image, &requirements[t]);
+        graph.unaliased_bytes += requirements[t].size;
+        order.push_back(t);
+    }
+    std::sort(order.begin(), order.end(),
+        [&](uint32_t a, uint32_t b) { return requirements[a].size > requirements[b].size; });
+
+    for (uint32_t t : order) {
+        RgTransient& transient = graph.transients[t];
+        const VkMemoryRequirements& needs = requirements[t];
+        // transients unused in the plan keep a block of their own
+        bool planned = transient.first_pass != UINT32_MAX;
+        for (uint32_t b = 0; planned && b < graph.blocks.size() && transient.block == UINT32_MAX; b++) {
+            RgMemoryBlock& block = graph.blocks[b];
+            if ((block.requirements.memoryTypeBits & needs.memoryTypeBits) == 0) continue;
+            bool overlaps = false;
+            for (uint32_t other : block.transients) {
+                const RgTransient& mate = graph.transients[other];
+                overlaps = overlaps || mate.first_pass == UINT32_MAX ||
+                    rg_lifetimes_overlap(transient.first_pass, transient.last_pass, mate.first_pass, mate.last_pass);
+            }
+            if (overlaps) continue;
+            block.requirements.size = std::max(block.requirements.size, needs.size);
+            block.requirements.alignment = std::max(block.requirements.alignment, needs.alignment);
+            block.requirements.memoryTypeBits &= needs.memoryTypeBits;
+            block.transients.push_back(t);
+            transient.block = b;
+        }
+        if (transient.block == UINT32_MAX) {
+            RgMemoryBlock block;
+            block.requirements = needs;
+            block.transients.push_back(t);
+            graph.blocks.push_back(block);
+            transient.block = static_cast<uint32_t>(graph.blocks.size() - 1);
+        }
+    }
+
+    for (auto& block : graph.blocks) {
+        VmaAllocationCreateInfo alloc_info = {};
+        alloc_info.preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        if (vmaAllocateMemory(allocator, &block.requirements, &alloc_info, &block.allocation, nullptr) != VK_SUCCESS) {
+            std::cout << "failed to allocate transient memory\n";
+            return -1;
+        }
+        graph.transient_bytes += block.requirements.size;
+
+        for (uint32_t t : block.transients) {
+            RgTransient& transient = graph.transients[t];
+            if (vmaBindImageMemory(allocator, block.allocation, transient.image) != VK_SUCCESS) {
+                std::cout << "failed to bind transient image " << transient.name << "\n";
+                return -1;
+            }
+
+            VkImageViewCreateInfo view_info = {};
+            view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            view_info.image = transient.image;
+            view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            view_info.format = transient.format;
+            view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            view_info.subresourceRange.levelCount = 1;
+            view_info.subresourceRange.layerCount = 1;
+
+            if (disp.createImageView(&view_info, nullptr, &transient.view) != VK_SUCCESS) {
+                std::cout << "failed to create image view\n";
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+void rg_destroy(const vkb::DispatchTable& disp, VmaAllocator allocator, RenderGraph& graph) {
+    RgRetired retired = rg_detach_transients(graph);
+    rg_destroy_retired(disp, allocator, retired);
+    for (auto& entry : graph.render_passes) disp.destroyRenderPass(entry.second, nullptr);
+    graph.render_passes.clear();
+}
@@ -0,0 +1,213 @@
+// Render graph used by renderer.cpp to order the frame's passes. Passes declare
+// the images and buffers they touch (rg_use, rg_color_attachment); rg_compile
+// derives the barriers, queue ownership transfers and the placement of aliased
+// transient images, and rg_record_pass records each pass after its barriers.
+// Submission, descriptor binding and profiler scopes stay with the renderer.
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include <VkBootstrap.h>
+
+#include "vk_mem_alloc.h"
+
+// How a pass touches a resource. Each usage maps to the stages, access and image
+// layout the render graph synchronizes against (see rg_access).
+enum RgUsage : uint32_t {
+    RG_COMPUTE_READ,
+    RG_COMPUTE_READ_WRITE,
+    RG_FRAGMENT_READ,
+    RG_FRAGMENT_READ_WRITE,
+    RG_COLOR_ATTACHMENT,
+    RG_TRANSFER_SRC,
+    RG_TRANSFER_DST,
+    RG_PRESENT,   // final usage only
+    RG_HOST_READ, // final usage only
+};
+
+// Queues a frame's passes are submitted to. Passes marked async go to the
+// compute queue when the device has a separate compute family and the frame
+// enables it; everything else, and everything on single-family devices, stays
+// on the graphics queue.
+enum RgQueue : uint32_t {
+    RG_QUEUE_GRAPHICS,
+    RG_QUEUE_COMPUTE,
+    RG_QUEUE_COUNT
+};
+
+struct RgAccess {
+    VkPipelineStageFlags stages;
+    VkAccessFlags access;
+    VkImageLayout layout;
+    bool reads;
+    bool writes;
+};
+
+// Synchronization state of a resource between two uses.
+struct RgState {
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkPipelineStageFlags write_stages = 0;   // last write or layout transition
+    VkAccessFlags write_access = 0;
+    VkPipelineStageFlags read_stages = 0;    // reads since then
+    VkPipelineStageFlags visible_stages = 0; // stages the last write was made visible to
+    VkAccessFlags visible_access = 0;
+    RgQueue queue = RG_QUEUE_GRAPHICS; // last accessed on, and owned by; back on graphics between frames
+};
+
+typedef uint32_t RgHandle; // index into RenderGraph::resources, valid for one frame
+const RgHandle RG_NONE = UINT32_MAX;
+
+struct RgResource {
+    const char* name;
+    VkImage image = VK_NULL_HANDLE; // either an image or a buffer
+    VkImageView view = VK_NULL_HANDLE;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkExtent2D extent = {};
+    uint32_t transient = UINT32_MAX; // index into RenderGraph::transients
+    bool persistent = false;         // state carried to the next frame through external_states
+    bool retained = false;           // contents outlive the frame, so its writers are never culled
+    bool has_final = false;
+    RgUsage final_usage = RG_PRESENT;
+    bool used = false;
+    RgState state;
+};
+
+struct RgUse {
+    RgHandle resource;
+    RgUsage usage;
+};
+
+struct RgBarriers {
+    VkPipelineStageFlags src_stages = 0;
+    VkPipelineStageFlags dst_stages = 0;
+    std::vector<VkImageMemoryBarrier> images;
+    std::vector<VkBufferMemoryBarrier> buffers;
+};
+
+struct RgPass {
+    const char* name;
+    uint32_t scope; // profiler scope recorded around the pass, GPU_SCOPE_COUNT when untimed
+    std::vector<RgUse> uses;
+    // raster passes render into a single color attachment begun by the graph
+    RgHandle color = RG_NONE;
+    VkAttachmentLoadOp load_op = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    VkExtent2D render_area = {};
+    bool secondary = false; // record only executes secondary command buffers inside the render pass
+    bool async = false;     // compute only, may run on the compute queue
+    std::function<void(VkCommandBuffer)> record;
+    bool culled = false;
+    RgBarriers barriers; // issued before the pass
+};
+
+// Consecutive passes submitted together to one queue. A batch waits for at most
+// one batch of the other queue, the latest one it depends on; the semaphore
+// between them orders the accesses and makes writes visible, so only layout and
+// ownership changes are left to barriers.
+struct RgBatch {
+    RgQueue queue = RG_QUEUE_GRAPHICS;
+    std::vector<uint32_t> passes;
+    uint32_t wait = UINT32_MAX; // batch of the other queue to wait for
+    VkPipelineStageFlags wait_stages = 0;
+    RgBarriers release; // ownership handed to the other queue, after the passes
+    VkCommandBuffer cmd = VK_NULL_HANDLE; // set by rg_execute
+    uint64_t signal_value = 0;            // of its queue's timeline, set at submission
+};
+
+// Image that only lives within a frame. Its memory belongs to a block shared
+// with every transient whose lifetime in the frame does not overlap its own.
+struct RgTransient {
+    const char* name;
+    VkExtent2D extent;
+    VkFormat format;
+    VkImageUsageFlags usage;
+    VkImage image = VK_NULL_HANDLE; // bound into the block's memory
+    VkImageView view = VK_NULL_HANDLE;
+    uint32_t block = UINT32_MAX;
+    uint32_t first_pass = UINT32_MAX; // lifetime in pass order, from the last compile
+    uint32_t last_pass = 0;
+};
+
+struct RgMemoryBlock {
+    VmaAllocation allocation = VK_NULL_HANDLE;
+    VkMemoryRequirements requirements = {};
+    std::vector<uint32_t> transients;
+    RgState state; // of the last transient that used the block, carried across frames
+};
+
+// Per-frame pass list: passes declare what they read and write, rg_compile culls
+// passes whose results are never used and works out every barrier and layout
+// transition, rg_execute records them in declaration order into one command
+// buffer per batch and submit_frame links the batches across queues.
+struct RenderGraph {
+    std::vector<RgResource> resources;
+    std::vector<RgPass> passes;
+    RgBarriers final_barriers;
+
+    // batch 0 is always on the graphics queue and the last batch too, waiting for
+    // everything the compute queue did in the frame
+    bool async = false; // set per frame: async passes go to the compute queue
+    uint32_t queue_families[RG_QUEUE_COUNT] = {};
+    std::vector<RgBatch> batches;
+    RgHandle present = RG_NONE; // the swapchain image, see rg_set_final
+    uint32_t present_batch = 0; // first batch touching it, which waits for the acquire
+
+    std::vector<RgTransient> transients;
+    std::vector<RgMemoryBlock> blocks;
+    VkDeviceSize transient_bytes = 0; // memory behind all transients
+    VkDeviceSize unaliased_bytes = 0; // what they would need without aliasing
+
+    std::map<uint64_t, RgState> external_states; // persistent imports by handle
+    std::map<std::pair<VkFormat, VkAttachmentLoadOp>, VkRenderPass> render_passes;
+    std::map<std::pair<VkRenderPass, VkImageView>, VkFramebuffer> framebuffers;
+};
+
+// Graph objects taken out of use, destroyed once the frames using them are done.
+struct RgRetired {
+    std::vector<RgTransient> transients;
+    std::vector<RgMemoryBlock> blocks;
+    std::vector<VkFramebuffer> framebuffers;
+};
+
+// Key of an imported resource in RenderGraph::external_states
+template <typename T> uint64_t rg_key(T handle) { return (uint64_t)handle; }
+
+VkImageMemoryBarrier image_barrier(VkImage image, VkImageLayout old_layout, VkImageLayout new_layout,
+    VkAccessFlags src_access, VkAccessFlags dst_access);
+RgAccess rg_access(RgUsage usage);
+
+// Declaring the frame
+void rg_begin(RenderGraph& graph);
+RgHandle rg_import_image(RenderGraph& graph, const char* name, VkImage image, VkImageView view, VkFormat format,
+    VkExtent2D extent, const RgState* initial);
+RgHandle rg_import_buffer(RenderGraph& graph, const char* name, VkBuffer buffer, const RgState* initial);
+void rg_forget(RenderGraph& graph, uint64_t key);
+RgHandle rg_use_transient(RenderGraph& graph, uint32_t transient);
+void rg_retain(RenderGraph& graph, RgHandle resource);
+void rg_set_final(RenderGraph& graph, RgHandle resource, RgUsage usage);
+uint32_t rg_add_pass(RenderGraph& graph, const char* name, uint32_t scope, std::function<void(VkCommandBuffer)> record);
+void rg_use(RenderGraph& graph, uint32_t pass, RgHandle resource, RgUsage usage);
+void rg_color_attachment(RenderGraph& graph, uint32_t pass, RgHandle resource, VkAttachmentLoadOp load_op,
+    VkExtent2D render_area);
+void rg_compile(RenderGraph& graph, bool plan);
+
+// Recording
+VkRenderPass rg_render_pass(const vkb::DispatchTable& disp, RenderGraph& graph, VkFormat format, VkAttachmentLoadOp load_op);
+VkFramebuffer rg_framebuffer(const vkb::DispatchTable& disp, RenderGraph& graph, VkRenderPass render_pass, const RgResource& attachment);
+RgRetired rg_detach_framebuffers(RenderGraph& graph);
+void rg_barriers(const vkb::DispatchTable& disp, VkCommandBuffer cmd, const RgBarriers& barriers);
+void rg_record_pass(const vkb::DispatchTable& disp, RenderGraph& graph, VkCommandBuffer cmd, const RgPass& pass);
+
+// Transient images and teardown
+uint32_t rg_add_transient(RenderGraph& graph, const char* name, VkExtent2D extent, VkFormat format,
+    VkImageUsageFlags usage);
+RgRetired rg_detach_transients(RenderGraph& graph);
+void rg_destroy_retired(const vkb::DispatchTable& disp, VmaAllocator allocator, RgRetired& retired);
+int rg_realize(const vkb::DispatchTable& disp, VmaAllocator allocator, RenderGraph& graph);
+void rg_destroy(const vkb::DispatchTable& disp, VmaAllocator allocator, RenderGraph& graph);
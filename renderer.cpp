@@ -0,0 +1,4667 @@
+// The renderer behind HelloWorld and coal_bench (see renderer.h): device and
+// swapchain setup, scene loading and baking, pipelines, the frame loop, the CPU
+// reference path and option parsing.
+#include "renderer.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <imgui.h>
+#include <imgui_impl_glfw.h>
+#include <imgui_impl_vulkan.h>
+
+// Set by CMake so hot reload can find the GLSL sources and the compiler
+#ifndef COAL_SHADER_SOURCE_DIR
+#define COAL_SHADER_SOURCE_DIR "shaders"
+#endif
+#ifndef COAL_GLSLC
+#define COAL_GLSLC "glslc"
+#endif
+
+void build_imgui_frame(const Init& init, RenderData& data);
+void begin_overlay_recording(RenderData& data);
+VkCommandBuffer finish_overlay_recording(RenderData& data);
+int apply_scene_edits(Init& init, RenderData& data);
+void gpu_scope_begin(Init& init, RenderData& data, VkCommandBuffer cmd, GpuScope scope);
+void gpu_scope_end(Init& init, RenderData& data, VkCommandBuffer cmd, GpuScope scope);
+
+void init_imgui(const Init& init, const RenderData& data) {
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGui::StyleColorsDark();
+    ImGui_ImplGlfw_InitForVulkan(init.window, true);
+    ImGui_ImplVulkan_InitInfo init_info = {};
+    init_info.Instance = init.instance.instance;
+    init_info.PhysicalDevice = init.device.physical_device;
+    init_info.Device = init.device.device;
+    init_info.QueueFamily = init.device.get_queue_index(vkb::QueueType::graphics).value();
+    init_info.Queue = init.device.get_queue(vkb::QueueType::graphics).value();
+    init_info.PipelineCache = init.pipeline_cache;
+    init_info.DescriptorPool = init.descriptor_pool;
+    init_info.Subpass = 0;
+    // the backend cycles its vertex/index buffers over ImageCount draws; with one
+    // per frame slot a buffer is only rewritten once wait_for_frame_slot has seen
+    // the frame that last read it complete, whatever frames_in_flight is
+    init_info.MinImageCount = 2;
+    init_info.ImageCount = MAX_FRAMES_IN_FLIGHT;
+    init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
+    init_info.Allocator = VK_NULL_HANDLE;
+    init_info.CheckVkResultFn = nullptr;
+    init_info.RenderPass = data.overlay_render_pass;
+    ImGui_ImplVulkan_Init(&init_info);
+    ImGui_ImplVulkan_CreateFontsTexture();
+
+}
+
+GLFWwindow* create_window_glfw(const char* window_name = "", bool resize = true) {
+    glfwInit();
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    if (!resize) glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+
+    return glfwCreateWindow(1280, 720, window_name, NULL, NULL);
+}
+
+void destroy_window_glfw(GLFWwindow* window) {
+    glfwDestroyWindow(window);
+    glfwTerminate();
+}
+
+VkSurfaceKHR create_surface_glfw(VkInstance instance, GLFWwindow* window, VkAllocationCallbacks* allocator = nullptr) {
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
+    VkResult err = glfwCreateWindowSurface(instance, window, allocator, &surface);
+    if (err) {
+        const char* error_msg;
+        int ret = glfwGetError(&error_msg);
+        if (ret != 0) {
+            std::cout << ret << " ";
+            if (error_msg != nullptr) std::cout << error_msg;
+            std::cout << "\n";
+        }
+        surface = VK_NULL_HANDLE;
+    }
+    return surface;
+}
+
+VmaAllocator create_vma_allocator(Init& init) {
+    VmaVulkanFunctions vulkan_functions = {};
+    vulkan_functions.vkGetInstanceProcAddr = init.inst_disp.fp_vkGetInstanceProcAddr;
+    vulkan_functions.vkGetDeviceProcAddr = init.device.fp_vkGetDeviceProcAddr;
+
+    VmaAllocatorCreateInfo allocator_create_info = {};
+    allocator_create_info.physicalDevice = init.device.physical_device;
+    allocator_create_info.device = init.device.device;
+    allocator_create_info.instance = init.instance.instance;
+    allocator_create_info.vulkanApiVersion = VK_API_VERSION_1_3;
+    allocator_create_info.pVulkanFunctions = &vulkan_functions;
+
+    VmaAllocator allocator;
+
+    if (vmaCreateAllocator(&allocator_create_info, &allocator) != VK_SUCCESS) {
+        std::cout << "failed to create VMA allocator\n";
+        throw std::runtime_error("failed to create VMA allocator");
+    }
+
+    return allocator;
+}
+
+int create_image(Init& init, VkExtent2D extent, VkFormat format, VkImageUsageFlags usage, AllocatedImage& image,
+    uint32_t layers = 1) {
+    VkImageCreateInfo image_info = {};
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.format = format;
+    image_info.extent = { extent.width, extent.height, 1 };
+    image_info.mipLevels = 1;
+    image_info.arrayLayers = layers;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.usage = usage;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    VmaAllocationCreateInfo alloc_info = {};
+    alloc_info.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+    if (vmaCreateImage(init.allocator, &image_info, &alloc_info, &image.image, &image.allocation, nullptr) != VK_SUCCESS) {
+        std::cout << "failed to create image\n";
+        return -1;
+    }
+
+    VkImageViewCreateInfo view_info = {};
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.image = image.image;
+    view_info.viewType = layers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = format;
+    view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    view_info.subresourceRange.levelCount = 1;
+    view_info.subresourceRange.layerCount = layers;
+
+    if (init.disp.createImageView(&view_info, nullptr, &image.view) != VK_SUCCESS) {
+        std::cout << "failed to create image view\n";
+        return -1;
+    }
+
+    image.extent = extent;
+    image.format = format;
+    image.layers = layers;
+    return 0;
+}
+
+int create_image_3d(Init& init, VkExtent3D extent, VkFormat format, VkImageUsageFlags usage, AllocatedImage& image) {
+    VkImageCreateInfo image_info = {};
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType = VK_IMAGE_TYPE_3D;
+    image_info.format = format;
+    image_info.extent = extent;
+    image_info.mipLevels = 1;
+    image_info.arrayLayers = 1;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.usage = usage;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    VmaAllocationCreateInfo alloc_info = {};
+    alloc_info.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+    if (vmaCreateImage(init.allocator, &image_info, &alloc_info, &image.image, &image.allocation, nullptr) != VK_SUCCESS) {
+        std::cout << "failed to create 3D image\n";
+        return -1;
+    }
+
+    VkImageViewCreateInfo view_info = {};
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.image = image.image;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_3D;
+    view_info.format = format;
+    view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    view_info.subresourceRange.levelCount = 1;
+    view_info.subresourceRange.layerCount = 1;
+
+    if (init.disp.createImageView(&view_info, nullptr, &image.view) != VK_SUCCESS) {
+        std::cout << "failed to create 3D image view\n";
+        return -1;
+    }
+
+    image.extent = { extent.width, extent.height };
+    image.depth = extent.depth;
+    image.format = format;
+    return 0;
+}
+
+void destroy_image(Init& init, AllocatedImage& image) {
+    if (image.view != VK_NULL_HANDLE) init.disp.destroyImageView(image.view, nullptr);
+    if (image.image != VK_NULL_HANDLE) vmaDestroyImage(init.allocator, image.image, image.allocation);
+    image = AllocatedImage{};
+}
+
+// host_access is 0 for device-only buffers, otherwise one of the VMA host access flags;
+// host visible buffers stay persistently mapped. Buffers given more than one queue
+// family are shared concurrently between them instead of changing owners.
+int create_buffer(Init& init, VkDeviceSize size, VkBufferUsageFlags usage, VmaAllocationCreateFlags host_access,
+    AllocatedBuffer& buffer, uint32_t family_count = 0, const uint32_t* families = nullptr) {
+    VkBufferCreateInfo buffer_info = {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = size;
+    buffer_info.usage = usage;
+    buffer_info.sharingMode = family_count > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    if (family_count > 1) {
+        buffer_info.queueFamilyIndexCount = family_count;
+        buffer_info.pQueueFamilyIndices = families;
+    }
+
+    VmaAllocationCreateInfo alloc_info = {};
+    alloc_info.usage = VMA_MEMORY_USAGE_AUTO;
+    alloc_info.flags = host_access;
+    if (host_access != 0) alloc_info.flags |= VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    VmaAllocationInfo allocation_info = {};
+    if (vmaCreateBuffer(init.allocator, &buffer_info, &alloc_info, &buffer.buffer, &buffer.allocation, &allocation_info) != VK_SUCCESS) {
+        std::cout << "failed to create buffer\n";
+        return -1;
+    }
+    buffer.mapped = allocation_info.pMappedData;
+    buffer.size = size;
+    return 0;
+}
+
+void destroy_buffer(Init& init, AllocatedBuffer& buffer) {
+    if (buffer.buffer != VK_NULL_HANDLE) vmaDestroyBuffer(init.allocator, buffer.buffer, buffer.allocation);
+    buffer = AllocatedBuffer{};
+}
+
+// Queues `destroy` behind every frame recorded so far.
+void defer_destroy(RenderData& data, std::function<void()> destroy) {
+    data.deferred_destroys.push_back({ data.frame_number, std::move(destroy) });
+}
+
+// Runs the deferred destructions whose frames have completed, or all of them once
+// the device is idle.
+void flush_deferred_destroys(RenderData& data, bool device_idle) {
+    auto& queue = data.deferred_destroys;
+    for (auto it = queue.begin(); it != queue.end();) {
+        if (device_idle || it->last_frame <= data.completed_frames) {
+            it->destroy();
+            it = queue.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+// Waits until the current slot's last frame has finished and no more than
+// frames_in_flight - 1 frames are still running, so the next one may be recorded.
+void wait_for_frame_slot(Init& init, RenderData& data) {
+    uint64_t wait_value = data.slot_frame_number[data.current_frame];
+    if (data.frame_number + 1 > data.frames_in_flight) {
+        wait_value = std::max(wait_value, data.frame_number + 1 - data.frames_in_flight);
+    }
+    if (wait_value <= data.completed_frames) return;
+
+    VkSemaphoreWaitInfo wait_info = {};
+    wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &data.frame_timeline;
+    wait_info.pValues = &wait_value;
+    init.disp.waitSemaphores(&wait_info, UINT64_MAX);
+}
+
+// The timeline counts finished frames, so its value is the newest completed one.
+void update_completed_frames(Init& init, RenderData& data) {
+    uint64_t value = 0;
+    if (init.disp.getSemaphoreCounterValue(data.frame_timeline, &value) == VK_SUCCESS) {
+        data.completed_frames = std::max(data.completed_frames, value);
+    }
+}
+
+// Space of every frame up to completed_frames can be written again.
+void staging_ring_reclaim(StagingRing& ring, uint64_t completed_frames) {
+    while (!ring.frames.empty() && ring.frames.front().first <= completed_frames) {
+        ring.tail = ring.frames.front().second;
+        ring.frames.pop_front();
+    }
+}
+
+// Contiguous space for size bytes, aligned to a power of two that divides the
+// ring size. False while frames in flight still hold too much of the ring;
+// callers try again next frame instead of waiting.
+bool staging_ring_alloc(StagingRing& ring, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) {
+    VkDeviceSize capacity = ring.buffer.size;
+    VkDeviceSize start = (ring.head + alignment - 1) / alignment * alignment;
+    // never straddle the end of the buffer
+    if (start % capacity + size > capacity) start += capacity - start % capacity;
+    if (size > capacity || start + size - ring.tail > capacity) return false;
+    ring.head = start + size;
+    offset = start % capacity;
+    return true;
+}
+
+// Everything allocated so far is read by `frame`.
+void staging_ring_submit(StagingRing& ring, uint64_t frame) {
+    if (ring.frames.empty() || ring.frames.back().second != ring.head) ring.frames.push_back({ frame, ring.head });
+}
+
+// Starts sub-allocating from the slice of a frame slot.
+void frame_uniforms_begin(FrameUniforms& uniforms, size_t slot) {
+    uniforms.slice_start = FRAME_UNIFORM_SLICE_SIZE * slot;
+    uniforms.head = 0;
+}
+
+// Copies size bytes into the current slice and returns the dynamic offset to bind them at.
+uint32_t frame_uniforms_push(Init& init, FrameUniforms& uniforms, const void* data, VkDeviceSize size) {
+    VkDeviceSize start = (uniforms.head + uniforms.alignment - 1) / uniforms.alignment * uniforms.alignment;
+    if (start + size > FRAME_UNIFORM_SLICE_SIZE) {
+        throw std::runtime_error("frame uniform slice exhausted");
+    }
+    VkDeviceSize offset = uniforms.slice_start + start;
+    memcpy(static_cast<char*>(uniforms.buffer.mapped) + offset, data, size);
+    vmaFlushAllocation(init.allocator, uniforms.buffer.allocation, offset, size);
+    uniforms.head = start + size;
+    return static_cast<uint32_t>(offset);
+}
+
+// Every light and primitive of the scene source has been copied to the device.
+bool scene_resident(const RenderData& data) {
+    return data.scene_stream.lights_resident && data.scene_stream.resident_primitives == data.scene_source.primitive_count;
+}
+
+void latency_worker(Init* init, RenderData* data) {
+    LatencyTracker& tracker = *data->latency;
+    while (true) {
+        LatencySample sample;
+        {
+            std::unique_lock<std::mutex> lock(tracker.mutex);
+            tracker.wake.wait(lock, [&]() { return tracker.stop || !tracker.pending.empty(); });
+            if (tracker.pending.empty()) return;
+            sample = tracker.pending.front();
+            tracker.pending.pop_front();
+            tracker.waiting_on = sample.swapchain;
+        }
+
+        // every submitted value is eventually signalled, so this can't hang
+        VkSemaphoreWaitInfo wait_info = {};
+        wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        wait_info.semaphoreCount = 1;
+        wait_info.pSemaphores = &data->frame_timeline;
+        wait_info.pValues = &sample.frame;
+        init->disp.waitSemaphores(&wait_info, UINT64_MAX);
+        auto gpu_done = std::chrono::steady_clock::now();
+
+        // the swapchain is externally synchronized with queuePresentKHR, so poll
+        // without a timeout under the same lock instead of blocking inside it
+        bool presented = false;
+        while (sample.swapchain != VK_NULL_HANDLE) {
+            VkResult result;
+            {
+                std::lock_guard<std::mutex> lock(tracker.present_mutex);
+                result = init->disp.waitForPresentKHR(sample.swapchain, sample.frame, 0);
+            }
+            if (result == VK_SUCCESS) {
+                presented = true;
+                break;
+            }
+            if (result != VK_TIMEOUT) break; // out of date or lost, the id will never arrive
+            {
+                std::lock_guard<std::mutex> lock(tracker.mutex);
+                if (tracker.stop || tracker.retiring == sample.swapchain) break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        auto present_done = std::chrono::steady_clock::now();
+
+        float ms[LATENCY_STAGE_COUNT] = {
+            std::chrono::duration<float, std::milli>(sample.submit - sample.input).count(),
+            std::chrono::duration<float, std::milli>(gpu_done - sample.input).count(),
+            std::chrono::duration<float, std::milli>(present_done - sample.input).count(),
+        };
+        {
+            std::lock_guard<std::mutex> lock(tracker.mutex);
+            for (uint32_t stage = 0; stage < LATENCY_STAGE_COUNT; stage++) {
+                if (stage == LATENCY_PRESENT && !presented) continue;
+                tracker.latest_ms[stage] = ms[stage];
+                tracker.total_ms[stage] += ms[stage];
+                tracker.count[stage]++;
+                tracker.history[stage][tracker.history_head] = ms[stage];
+            }
+            tracker.history_head = (tracker.history_head + 1) % LATENCY_HISTORY;
+            tracker.waiting_on = VK_NULL_HANDLE;
+        }
+        tracker.released.notify_all();
+    }
+}
+
+void start_latency_tracker(Init& init, RenderData& data) {
+    data.latency = std::make_unique<LatencyTracker>();
+    for (auto& history : data.latency->history) history.assign(LATENCY_HISTORY, 0.0f);
+    data.latency->worker = std::thread(latency_worker, &init, &data);
+}
+
+// Hands the frame just submitted to the latency worker; swapchain is null for
+// headless frames, which only report up to GPU completion.
+void track_latency(RenderData& data, VkSwapchainKHR swapchain) {
+    if (!data.latency) return;
+    {
+        std::lock_guard<std::mutex> lock(data.latency->mutex);
+        data.latency->pending.push_back(
+            { data.frame_number, data.input_time, std::chrono::steady_clock::now(), swapchain });
+    }
+    data.latency->wake.notify_one();
+}
+
+// Makes sure the worker no longer touches a swapchain that is about to be destroyed.
+void release_latency_swapchain(RenderData& data, VkSwapchainKHR swapchain) {
+    if (!data.latency) return;
+    LatencyTracker& tracker = *data.latency;
+    std::unique_lock<std::mutex> lock(tracker.mutex);
+    for (LatencySample& sample : tracker.pending) {
+        if (sample.swapchain == swapchain) sample.swapchain = VK_NULL_HANDLE;
+    }
+    tracker.retiring = swapchain;
+    tracker.released.wait(lock, [&]() { return tracker.waiting_on != swapchain; });
+    tracker.retiring = VK_NULL_HANDLE;
+}
+
+void stop_latency_tracker(RenderData& data) {
+    if (!data.latency) return;
+    LatencyTracker& tracker = *data.latency;
+    {
+        std::lock_guard<std::mutex> lock(tracker.mutex);
+        tracker.stop = true;
+    }
+    tracker.wake.notify_all();
+    if (tracker.worker.joinable()) tracker.worker.join();
+
+    for (uint32_t stage = 0; stage < LATENCY_STAGE_COUNT; stage++) {
+        if (tracker.count[stage] == 0) continue;
+        std::cout << LATENCY_STAGE_NAMES[stage] << ": " << tracker.total_ms[stage] / tracker.count[stage]
+                  << " ms average over " << tracker.count[stage] << " frames\n";
+    }
+    data.latency.reset();
+}
+
+int device_initialization(Init& init, const Options& options) {
+    init.headless = options.headless;
+    init.present_mode = options.present_mode;
+    if (!init.headless) {
+        init.window = create_window_glfw("Vulkan Triangle", true);
+    }
+
+    vkb::InstanceBuilder instance_builder;
+    if (options.validation) {
+        instance_builder.use_default_debug_messenger().request_validation_layers();
+    }
+    auto instance_ret = instance_builder.require_api_version(1, 3, 0)
+        .set_headless(init.headless)
+        .build();
+    if (!instance_ret) {
+        std::cout << instance_ret.error().message() << "\n";
+        return -1;
+    }
+    init.instance = instance_ret.value();
+
+    init.inst_disp = init.instance.make_table();
+
+    // the march step counters use atomics from the fragment shader; the bindless
+    // table is indexed with push constants
+    VkPhysicalDeviceFeatures required_features = {};
+    required_features.fragmentStoresAndAtomics = VK_TRUE;
+    required_features.shaderStorageImageArrayDynamicIndexing = VK_TRUE;
+    required_features.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+    required_features.shaderStorageBufferArrayDynamicIndexing = VK_TRUE;
+
+    // frames are paced on a timeline semaphore; bindless table slots are written
+    // while earlier frames still have the set bound
+    VkPhysicalDeviceVulkan12Features required_features_12 = {};
+    required_features_12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    required_features_12.timelineSemaphore = VK_TRUE;
+    required_features_12.descriptorBindingPartiallyBound = VK_TRUE;
+    required_features_12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    required_features_12.descriptorBindingStorageImageUpdateAfterBind = VK_TRUE;
+    required_features_12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    required_features_12.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+
+    vkb::PhysicalDeviceSelector phys_device_selector(init.instance);
+    phys_device_selector.set_required_features(required_features);
+    phys_device_selector.set_required_features_12(required_features_12);
+    if (options.software) phys_device_selector.prefer_gpu_device_type(vkb::PreferredDeviceType::cpu);
+    if (init.headless) {
+        init.output_extent = { options.width, options.height };
+        init.output_format = VK_FORMAT_B8G8R8A8_UNORM;
+    } else {
+        init.surface = create_surface_glfw(init.instance, init.window);
+        phys_device_selector.set_surface(init.surface);
+    }
+
+    auto phys_device_ret = phys_device_selector.select();
+    if (!phys_device_ret) {
+        std::cout << phys_device_ret.error().message() << "\n";
+        return -1;
+    }
+    vkb::PhysicalDevice physical_device = phys_device_ret.value();
+
+    // present latency needs present ids to wait on; without them only GPU completion is measured
+    VkPhysicalDevicePresentIdFeaturesKHR present_id_features = {};
+    present_id_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features = {};
+    present_wait_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    if (!init.headless && physical_device.is_extension_present(VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+        physical_device.is_extension_present(VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+        present_id_features.pNext = &present_wait_features;
+        VkPhysicalDeviceFeatures2 features2 = {};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &present_id_features;
+        init.inst_disp.getPhysicalDeviceFeatures2(physical_device.physical_device, &features2);
+        present_id_features.pNext = nullptr;
+        init.present_wait = present_id_features.presentId && present_wait_features.presentWait;
+    }
+
+    if (init.present_wait) {
+        physical_device.enable_extension_if_present(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        physical_device.enable_extension_if_present(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+    }
+
+    vkb::DeviceBuilder device_builder{ physical_device };
+    if (init.present_wait) {
+        device_builder.add_pNext(&present_id_features);
+        device_builder.add_pNext(&present_wait_features);
+    }
+    auto device_ret = device_builder.build();
+    if (!device_ret) {
+        std::cout << device_ret.error().message() << "\n";
+        return -1;
+    }
+    init.device = device_ret.value();
+
+    init.disp = init.device.make_table();
+
+    return 0;
+}
+
+const char* present_mode_name(VkPresentModeKHR mode) {
+    for (uint32_t i = 0; i < PRESENT_MODE_COUNT; i++) {
+        if (PRESENT_MODES[i] == mode) return PRESENT_MODE_NAMES[i];
+    }
+    return "other";
+}
+
+int create_swapchain(Init& init) {
+
+    uint32_t mode_count = 0;
+    VkPhysicalDevice physical_device = init.device.physical_device.physical_device;
+    init.inst_disp.getPhysicalDeviceSurfacePresentModesKHR(physical_device, init.surface, &mode_count, nullptr);
+    std::vector<VkPresentModeKHR> modes(mode_count);
+    init.inst_disp.getPhysicalDeviceSurfacePresentModesKHR(physical_device, init.surface, &mode_count, modes.data());
+    for (uint32_t i = 0; i < PRESENT_MODE_COUNT; i++) {
+        init.present_mode_supported[i] = std::find(modes.begin(), modes.end(), PRESENT_MODES[i]) != modes.end();
+    }
+
+    // set surface format
+    VkSurfaceFormatKHR format = { VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
+
+    vkb::SwapchainBuilder swapchain_builder{ init.device };
+    swapchain_builder
+        .set_desired_present_mode(init.present_mode)
+    .set_desired_format(format)
+    .add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+
+    auto swap_ret = swapchain_builder.set_old_swapchain(init.swapchain).build();
+    if (!swap_ret) {
+        std::cout << swap_ret.error().message() << " " << swap_ret.vk_result() << "\n";
+        return -1;
+    }
+    // the retired swapchain is destroyed by the caller once its frames are done
+    init.swapchain = swap_ret.value();
+    init.output_extent = init.swapchain.extent;
+    init.output_format = init.swapchain.image_format;
+    // vk-bootstrap silently falls back to FIFO for a mode the surface lacks
+    if (init.swapchain.present_mode != init.present_mode) {
+        std::cout << "present mode " << present_mode_name(init.present_mode) << " is not supported, using "
+                  << present_mode_name(init.swapchain.present_mode) << "\n";
+        init.present_mode = init.swapchain.present_mode;
+    }
+    return 0;
+}
+
+int get_queues(Init& init, RenderData& data) {
+    auto gq = init.device.get_queue(vkb::QueueType::graphics);
+    if (!gq.has_value()) {
+        std::cout << "failed to get graphics queue: " << gq.error().message() << "\n";
+        return -1;
+    }
+    data.graphics_queue = gq.value();
+    data.graph.queue_families[RG_QUEUE_GRAPHICS] = init.device.get_queue_index(vkb::QueueType::graphics).value();
+    data.graph.queue_families[RG_QUEUE_COMPUTE] = data.graph.queue_families[RG_QUEUE_GRAPHICS];
+
+    // a family of its own for compute, if the device has one; otherwise async
+    // passes stay on the graphics queue
+    auto cq = init.device.get_queue(vkb::QueueType::compute);
+    auto cq_index = init.device.get_queue_index(vkb::QueueType::compute);
+    data.compute_queue = VK_NULL_HANDLE;
+    if (cq.has_value() && cq_index.has_value()) {
+        data.compute_queue = cq.value();
+        data.graph.queue_families[RG_QUEUE_COMPUTE] = cq_index.value();
+        data.compute_timestamps = init.device.queue_families[cq_index.value()].timestampValidBits > 0;
+    }
+
+    if (init.headless) {
+        data.present_queue = VK_NULL_HANDLE;
+        return 0;
+    }
+
+    auto pq = init.device.get_queue(vkb::QueueType::present);
+    if (!pq.has_value()) {
+        std::cout << "failed to get present queue: " << pq.error().message() << "\n";
+        return -1;
+    }
+    data.present_queue = pq.value();
+    return 0;
+}
+
+// Command buffer for the index-th batch of a frame on `queue` after the first
+// graphics one, allocated from that queue's pool on first use and begun.
+VkCommandBuffer begin_batch_command_buffer(Init& init, RenderData& data, RgQueue queue, uint32_t index) {
+    std::vector<VkCommandBuffer>& buffers = data.batch_command_buffers[queue][data.current_frame];
+    if (index >= buffers.size()) {
+        VkCommandBufferAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.commandPool = queue == RG_QUEUE_COMPUTE ? data.compute_command_pool : data.command_pool;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.commandBufferCount = 1;
+
+        VkCommandBuffer buffer = VK_NULL_HANDLE;
+        if (init.disp.allocateCommandBuffers(&alloc_info, &buffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate batch command buffer");
+        }
+        buffers.push_back(buffer);
+    }
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (init.disp.beginCommandBuffer(buffers[index], &begin_info) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording command buffer!");
+    }
+    return buffers[index];
+}
+
+// Binds the scene set with this frame's constants and the bindless table, and
+// pushes the table indices, for every scene pass recorded into `cmd` after it.
+// Compute queue command buffers only get the compute bind point.
+void bind_frame_descriptors(Init& init, RenderData& data, VkCommandBuffer cmd, bool graphics) {
+    VkDescriptorSet sets[] = { data.scene_set, data.bindless.set };
+    init.disp.cmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, data.pipeline_layout,
+        0, 2, sets, 1, &data.frame_constants_offset);
+    if (graphics) {
+        init.disp.cmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, data.pipeline_layout,
+            0, 2, sets, 1, &data.frame_constants_offset);
+    }
+    init.disp.cmdPushConstants(cmd, data.pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT,
+        0, sizeof(BindlessIndices), &data.bindless_indices);
+}
+
+// Records the compiled graph in declaration order, batch by batch. Batch 0 goes
+// into `cmd`, which the caller began and ends; every later batch gets a command
+// buffer of its own, ended here, for submit_frame. The frame's descriptors are
+// bound once per command buffer rather than per pass, and every timed pass is
+// recorded inside its profiler scope.
+void rg_execute(Init& init, RenderData& data, VkCommandBuffer cmd) {
+    RenderGraph& graph = data.graph;
+    uint32_t extra_batches[RG_QUEUE_COUNT] = {};
+    for (size_t b = 0; b < graph.batches.size(); b++) {
+        RgBatch& batch = graph.batches[b];
+        batch.cmd = b == 0 ? cmd : begin_batch_command_buffer(init, data, batch.queue, extra_batches[batch.queue]++);
+        bool graphics = batch.queue == RG_QUEUE_GRAPHICS;
+        bind_frame_descriptors(init, data, batch.cmd, graphics);
+        // queue families without timestamps leave their passes untimed
+        bool timed = graphics || data.compute_timestamps;
+        for (uint32_t index : batch.passes) {
+            const RgPass& pass = graph.passes[index];
+            bool timed_pass = timed && pass.scope != GPU_SCOPE_COUNT;
+            if (timed_pass) gpu_scope_begin(init, data, batch.cmd, static_cast<GpuScope>(pass.scope));
+            rg_record_pass(init.disp, graph, batch.cmd, pass);
+            if (timed_pass) gpu_scope_end(init, data, batch.cmd, static_cast<GpuScope>(pass.scope));
+            // bound state is undefined after executing secondary command buffers
+            if (pass.secondary) bind_frame_descriptors(init, data, batch.cmd, graphics);
+        }
+        rg_barriers(init.disp, batch.cmd, batch.release);
+        if (b + 1 == graph.batches.size()) rg_barriers(init.disp, batch.cmd, graph.final_barriers);
+        if (b > 0 && init.disp.endCommandBuffer(batch.cmd) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer");
+        }
+    }
+}
+
+// Both render passes come from the graph; the pipelines and ImGui only need them
+// for compatibility.
+int create_render_pass(Init& init, RenderData& data) {
+    // every scene pixel is marched; the overlay draws on top of the upscaled scene
+    data.render_pass = rg_render_pass(init.disp, data.graph, SCENE_FORMAT, VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+    data.overlay_render_pass = rg_render_pass(init.disp, data.graph, init.output_format, VK_ATTACHMENT_LOAD_OP_LOAD);
+    if (data.render_pass == VK_NULL_HANDLE || data.overlay_render_pass == VK_NULL_HANDLE) return -1;
+    return 0;
+}
+
+// Prefix of the pipeline cache file. The Vulkan cache header already carries the
+// vendor, device and cache UUID; the driver version is only available from the
+// device properties, so it is stored here too.
+struct PipelineCacheFileHeader {
+    uint32_t magic;
+    uint32_t driver_version;
+    uint8_t cache_uuid[VK_UUID_SIZE];
+    uint64_t data_size;
+};
+
+const uint32_t PIPELINE_CACHE_MAGIC = 0x4C414F43; // "COAL"
+
+// Returns the cache payload if the file was written by this device and driver.
+std::vector<char> load_pipeline_cache_data(const Init& init, const std::string& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) return {};
+
+    size_t file_size = (size_t)file.tellg();
+    if (file_size < sizeof(PipelineCacheFileHeader)) return {};
+    file.seekg(0);
+
+    PipelineCacheFileHeader header = {};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+    const VkPhysicalDeviceProperties& properties = init.device.physical_device.properties;
+    if (header.magic != PIPELINE_CACHE_MAGIC || header.driver_version != properties.driverVersion ||
+        memcmp(header.cache_uuid, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0 ||
+        header.data_size != file_size - sizeof(header)) {
+        std::cout << "pipeline cache " << path << " is stale or corrupt, ignoring it\n";
+        return {};
+    }
+
+    std::vector<char> data(header.data_size);
+    file.read(data.data(), static_cast<std::streamsize>(data.size()));
+
+    VkPipelineCacheHeaderVersionOne vk_header = {};
+    if (data.size() < sizeof(vk_header)) return {};
+    memcpy(&vk_header, data.data(), sizeof(vk_header));
+    if (vk_header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE || vk_header.vendorID != properties.vendorID ||
+        vk_header.deviceID != properties.deviceID) {
+        std::cout << "pipeline cache " << path << " is for another device, ignoring it\n";
+        return {};
+    }
+    return data;
+}
+
+int create_pipeline_cache(Init& init, const std::string& path) {
+    init.pipeline_cache_path = path;
+    std::vector<char> data;
+    if (!path.empty()) data = load_pipeline_cache_data(init, path);
+    init.pipeline_cache_warm = !data.empty();
+
+    VkPipelineCacheCreateInfo cache_info = {};
+    cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cache_info.initialDataSize = data.size();
+    cache_info.pInitialData = data.empty() ? nullptr : data.data();
+
+    if (init.disp.createPipelineCache(&cache_info, nullptr, &init.pipeline_cache) != VK_SUCCESS) {
+        std::cout << "failed to create pipeline cache\n";
+        return -1;
+    }
+    return 0;
+}
+
+// Writes the cache next to its destination and renames it into place, so a
+// crash mid-write never leaves a truncated cache behind.
+int save_pipeline_cache(Init& init) {
+    if (init.pipeline_cache == VK_NULL_HANDLE || init.pipeline_cache_path.empty()) return 0;
+
+    size_t data_size = 0;
+    if (init.disp.getPipelineCacheData(init.pipeline_cache, &data_size, nullptr) != VK_SUCCESS) {
+        std::cout << "failed to query pipeline cache size\n";
+        return -1;
+    }
+    std::vector<char> data(data_size);
+    if (init.disp.getPipelineCacheData(init.pipeline_cache, &data_size, data.data()) != VK_SUCCESS) {
+        std::cout << "failed to read pipeline cache\n";
+        return -1;
+    }
+
+    const VkPhysicalDeviceProperties& properties = init.device.physical_device.properties;
+    PipelineCacheFileHeader header = {};
+    header.magic = PIPELINE_CACHE_MAGIC;
+    header.driver_version = properties.driverVersion;
+    memcpy(header.cache_uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+    header.data_size = data_size;
+
+    std::string temp_path = init.pipeline_cache_path + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cout << "failed to open " << temp_path << " for writing\n";
+            return -1;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(data.data(), static_cast<std::streamsize>(data_size));
+        if (!file.good()) {
+            std::cout << "failed to write " << temp_path << "\n";
+            return -1;
+        }
+    }
+    if (std::rename(temp_path.c_str(), init.pipeline_cache_path.c_str()) != 0) {
+        // rename doesn't replace an existing file on every platform
+        std::remove(init.pipeline_cache_path.c_str());
+        if (std::rename(temp_path.c_str(), init.pipeline_cache_path.c_str()) != 0) {
+            std::cout << "failed to move " << temp_path << " to " << init.pipeline_cache_path << "\n";
+            std::remove(temp_path.c_str());
+            return -1;
+        }
+    }
+    return 0;
+}
+
+std::vector<char> readFile(const std::string& filename) {
+    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file!");
+    }
+
+    size_t file_size = (size_t)file.tellg();
+    std::vector<char> buffer(file_size);
+
+    file.seekg(0);
+    file.read(buffer.data(), static_cast<std::streamsize>(file_size));
+
+    file.close();
+
+    return buffer;
+}
+
+VkShaderModule createShaderModule(Init& init, const std::vector<char>& code) {
+    VkShaderModuleCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    create_info.codeSize = code.size();
+    create_info.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+    VkShaderModule shaderModule;
+    if (init.disp.createShaderModule(&create_info, nullptr, &shaderModule) != VK_SUCCESS) {
+        return VK_NULL_HANDLE; // failed to create shader module
+    }
+
+    return shaderModule;
+}
+
+// Map entries for a QualitySpecialization stored at `offset` in the specialization data.
+void append_quality_entries(std::vector<VkSpecializationMapEntry>& entries, uint32_t offset) {
+    entries.push_back({ 10, offset + (uint32_t)offsetof(QualitySpecialization, max_steps), sizeof(int32_t) });
+    entries.push_back({ 11, offset + (uint32_t)offsetof(QualitySpecialization, max_dist), sizeof(float) });
+    entries.push_back({ 12, offset + (uint32_t)offsetof(QualitySpecialization, epsilon), sizeof(float) });
+    entries.push_back({ 13, offset + (uint32_t)offsetof(QualitySpecialization, shadow_steps), sizeof(int32_t) });
+    entries.push_back({ 14, offset + (uint32_t)offsetof(QualitySpecialization, ao_samples), sizeof(int32_t) });
+}
+
+// Specialization of a stage that only uses the quality constants; `entries`
+// backs the returned info and must outlive it.
+VkSpecializationInfo quality_spec_info(QualityTier tier, std::vector<VkSpecializationMapEntry>& entries) {
+    entries.clear();
+    append_quality_entries(entries, 0);
+    VkSpecializationInfo spec_info = {};
+    spec_info.mapEntryCount = static_cast<uint32_t>(entries.size());
+    spec_info.pMapEntries = entries.data();
+    spec_info.dataSize = sizeof(QualitySpecialization);
+    spec_info.pData = &QUALITY_TIERS[tier];
+    return spec_info;
+}
+
+// Builds the fullscreen ray march pipeline of one tier from the compiled shaders
+// on disk. Only reads layouts and the render pass, so the hot-reload worker can call it.
+int build_graphics_pipeline(Init& init, const RenderData& data, QualityTier tier, VkPipeline& pipeline) {
+    auto vert_code = readFile("shaders/main.vert.spv");
+    auto frag_code = readFile("shaders/main.frag.spv");
+
+    VkShaderModule vert_module = createShaderModule(init, vert_code);
+    VkShaderModule frag_module = createShaderModule(init, frag_code);
+    if (vert_module == VK_NULL_HANDLE || frag_module == VK_NULL_HANDLE) {
+        std::cout << "failed to create shader module\n";
+        return -1; // failed to create shader modules
+    }
+
+    VkPipelineShaderStageCreateInfo vert_stage_info = {};
+    vert_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    vert_stage_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    vert_stage_info.module = vert_module;
+    vert_stage_info.pName = "main";
+
+    VkPipelineShaderStageCreateInfo frag_stage_info = {};
+    frag_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    frag_stage_info.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    frag_stage_info.module = frag_module;
+    frag_stage_info.pName = "main";
+
+    std::vector<VkSpecializationMapEntry> spec_entries;
+    VkSpecializationInfo spec_info = quality_spec_info(tier, spec_entries);
+    frag_stage_info.pSpecializationInfo = &spec_info;
+
+    VkPipelineShaderStageCreateInfo shader_stages[] = { vert_stage_info, frag_stage_info };
+
+    VkPipelineVertexInputStateCreateInfo vertex_input_info = {};
+    vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertex_input_info.vertexBindingDescriptionCount = 0;
+    vertex_input_info.vertexAttributeDescriptionCount = 0;
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+    input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+    input_assembly.primitiveRestartEnable = VK_FALSE;
+
+    VkViewport viewport = {};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = (float)init.output_extent.width;
+    viewport.height = (float)init.output_extent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+
+    VkRect2D scissor = {};
+    scissor.offset = { 0, 0 };
+    scissor.extent = init.output_extent;
+
+    VkPipelineViewportStateCreateInfo viewport_state = {};
+    viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport_state.viewportCount = 1;
+    viewport_state.pViewports = &viewport;
+    viewport_state.scissorCount = 1;
+    viewport_state.pScissors = &scissor;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = {};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.depthClampEnable = VK_FALSE;
+    rasterizer.rasterizerDiscardEnable = VK_FALSE;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    rasterizer.depthBiasEnable = VK_FALSE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.sampleShadingEnable = VK_FALSE;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+    colorBlendAttachment.colorWriteMask =
+        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = VK_FALSE;
+
+    VkPipelineColorBlendStateCreateInfo color_blending = {};
+    color_blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    color_blending.logicOpEnable = VK_FALSE;
+    color_blending.logicOp = VK_LOGIC_OP_COPY;
+    color_blending.attachmentCount = 1;
+    color_blending.pAttachments = &colorBlendAttachment;
+    color_blending.blendConstants[0] = 0.0f;
+    color_blending.blendConstants[1] = 0.0f;
+    color_blending.blendConstants[2] = 0.0f;
+    color_blending.blendConstants[3] = 0.0f;
+
+    std::vector<VkDynamicState> dynamic_states = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+    VkPipelineDynamicStateCreateInfo dynamic_info = {};
+    dynamic_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_info.dynamicStateCount = static_cast<uint32_t>(dynamic_states.size());
+    dynamic_info.pDynamicStates = dynamic_states.data();
+
+    VkGraphicsPipelineCreateInfo pipeline_info = {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipeline_info.stageCount = 2;
+    pipeline_info.pStages = shader_stages;
+    pipeline_info.pVertexInputState = &vertex_input_info;
+    pipeline_info.pInputAssemblyState = &input_assembly;
+    pipeline_info.pViewportState = &viewport_state;
+    pipeline_info.pRasterizationState = &rasterizer;
+    pipeline_info.pMultisampleState = &multisampling;
+    pipeline_info.pColorBlendState = &color_blending;
+    pipeline_info.pDynamicState = &dynamic_info;
+    pipeline_info.layout = data.pipeline_layout;
+    pipeline_info.renderPass = data.render_pass;
+    pipeline_info.subpass = 0;
+    pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+
+    VkResult result = init.disp.createGraphicsPipelines(init.pipeline_cache, 1, &pipeline_info, nullptr, &pipeline);
+
+    init.disp.destroyShaderModule(frag_module, nullptr);
+    init.disp.destroyShaderModule(vert_module, nullptr);
+    if (result != VK_SUCCESS) {
+        std::cout << "failed to create pipline\n";
+        return -1; // failed to create graphics pipeline
+    }
+    return 0;
+}
+
+int create_graphics_pipeline(Init& init, RenderData& data) {
+    for (uint32_t tier = 0; tier < QUALITY_TIER_COUNT; tier++) {
+        if (0 != build_graphics_pipeline(init, data, (QualityTier)tier, data.pipelines.graphics[tier])) return -1;
+    }
+    return 0;
+}
+
+// Fullscreen blend of the premultiplied ImGui layer onto the output image, in the
+// overlay render pass. Only reads layouts and the render pass, like the scene pipelines.
+int build_ui_blend_pipeline(Init& init, const RenderData& data, VkPipeline& pipeline) {
+    auto vert_code = readFile("shaders/main.vert.spv");
+    auto frag_code = readFile("shaders/ui_blend.frag.spv");
+
+    VkShaderModule vert_module = createShaderModule(init, vert_code);
+    VkShaderModule frag_module = createShaderModule(init, frag_code);
+    if (vert_module == VK_NULL_HANDLE || frag_module == VK_NULL_HANDLE) {
+        std::cout << "failed to create shader module\n";
+        return -1;
+    }
+
+    VkPipelineShaderStageCreateInfo shader_stages[2] = {};
+    shader_stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shader_stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shader_stages[0].module = vert_module;
+    shader_stages[0].pName = "main";
+    shader_stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shader_stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shader_stages[1].module = frag_module;
+    shader_stages[1].pName = "main";
+
+    VkPipelineVertexInputStateCreateInfo vertex_input_info = {};
+    vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+    input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+    input_assembly.primitiveRestartEnable = VK_FALSE;
+
+    // viewport and scissor are dynamic, set by the graph
+    VkPipelineViewportStateCreateInfo viewport_state = {};
+    viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport_state.viewportCount = 1;
+    viewport_state.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = {};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineColorBlendAttachmentState blend_attachment = {};
+    blend_attachment.colorWriteMask =
+        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    blend_attachment.blendEnable = VK_TRUE;
+    blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;
+    blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+    VkPipelineColorBlendStateCreateInfo color_blending = {};
+    color_blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    color_blending.attachmentCount = 1;
+    color_blending.pAttachments = &blend_attachment;
+
+    VkDynamicState dynamic_states[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamic_info = {};
+    dynamic_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_info.dynamicStateCount = 2;
+    dynamic_info.pDynamicStates = dynamic_states;
+
+    VkGraphicsPipelineCreateInfo pipeline_info = {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipeline_info.stageCount = 2;
+    pipeline_info.pStages = shader_stages;
+    pipeline_info.pVertexInputState = &vertex_input_info;
+    pipeline_info.pInputAssemblyState = &input_assembly;
+    pipeline_info.pViewportState = &viewport_state;
+    pipeline_info.pRasterizationState = &rasterizer;
+    pipeline_info.pMultisampleState = &multisampling;
+    pipeline_info.pColorBlendState = &color_blending;
+    pipeline_info.pDynamicState = &dynamic_info;
+    pipeline_info.layout = data.pipeline_layout;
+    pipeline_info.renderPass = data.overlay_render_pass;
+    pipeline_info.subpass = 0;
+
+    VkResult result = init.disp.createGraphicsPipelines(init.pipeline_cache, 1, &pipeline_info, nullptr, &pipeline);
+
+    init.disp.destroyShaderModule(frag_module, nullptr);
+    init.disp.destroyShaderModule(vert_module, nullptr);
+    if (result != VK_SUCCESS) {
+        std::cout << "failed to create ui blend pipeline\n";
+        return -1;
+    }
+    return 0;
+}
+
+int create_ui_blend_pipeline(Init& init, RenderData& data) {
+    return build_ui_blend_pipeline(init, data, data.pipelines.ui_blend);
+}
+
+SdfPrimitive make_primitive(SdfPrimitiveType type, const float position[3], const float params[4], const float material[4]) {
+    SdfPrimitive prim = {};
+    for (int i = 0; i < 3; i++) prim.position_type[i] = position[i];
+    prim.position_type[3] = static_cast<float>(type);
+    for (int i = 0; i < 4; i++) prim.params[i] = params[i];
+    for (int i = 0; i < 4; i++) prim.material[i] = material[i];
+    return prim;
+}
+
+// The original hard-coded scene (floor, cube, back wall) plus an optional grid
+// of small boxes and spheres for stress testing the culling pre-pass.
+std::vector<SdfPrimitive> build_scene(const Options& options) {
+    std::vector<SdfPrimitive> scene;
+
+    const float origin[3] = { 0.0f, 0.0f, 0.0f };
+    const float floor_params[4] = { 0.0f, 1.0f, 0.0f, 0.0f };
+    const float floor_material[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    scene.push_back(make_primitive(SDF_PLANE, origin, floor_params, floor_material));
+
+    const float cube_position[3] = { 0.0f, 1.0f, 0.0f };
+    const float cube_params[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+    const float cube_material[4] = { 0.2f, 0.4f, 0.8f, 0.0f };
+    scene.push_back(make_primitive(SDF_BOX, cube_position, cube_params, cube_material));
+
+    const float wall_params[4] = { 0.0f, 0.0f, 1.0f, -10.0f };
+    const float wall_material[4] = { 0.8f, 0.8f, 0.9f, 0.0f };
+    scene.push_back(make_primitive(SDF_PLANE, origin, wall_params, wall_material));
+
+    for (uint32_t z = 0; z < options.grid; z++) {
+        for (uint32_t x = 0; x < options.grid; x++) {
+            float u = options.grid > 1 ? (float)x / (float)(options.grid - 1) : 0.5f;
+            float v = options.grid > 1 ? (float)z / (float)(options.grid - 1) : 0.5f;
+            float size = 0.25f;
+            const float position[3] = { -7.0f + 14.0f * u, size, 2.0f + 7.0f * v };
+            const float material[4] = { 0.3f + 0.6f * u, 0.3f + 0.6f * v, 0.5f, 0.0f };
+            if ((x + z) % 2 == 0) {
+                const float params[4] = { size, size, size, 0.0f };
+                scene.push_back(make_primitive(SDF_BOX, position, params, material));
+            } else {
+                const float params[4] = { size, 0.0f, 0.0f, 0.0f };
+                scene.push_back(make_primitive(SDF_SPHERE, position, params, material));
+            }
+        }
+    }
+    return scene;
+}
+
+void unmap_file(MappedFile& file) {
+#ifdef _WIN32
+    if (file.data != nullptr) UnmapViewOfFile(file.data);
+    if (file.mapping != nullptr) CloseHandle(file.mapping);
+    if (file.file != INVALID_HANDLE_VALUE) CloseHandle(file.file);
+#else
+    if (file.data != nullptr) munmap(const_cast<uint8_t*>(file.data), file.size);
+#endif
+    file = MappedFile{};
+}
+
+int map_file(const std::string& path, MappedFile& file) {
+#ifdef _WIN32
+    file.file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file.file == INVALID_HANDLE_VALUE) {
+        std::cout << "failed to open " << path << "\n";
+        return -1;
+    }
+    LARGE_INTEGER size = {};
+    if (!GetFileSizeEx(file.file, &size) || size.QuadPart == 0) {
+        std::cout << path << " is empty\n";
+        unmap_file(file);
+        return -1;
+    }
+    file.mapping = CreateFileMappingA(file.file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (file.mapping != nullptr) {
+        file.data = static_cast<const uint8_t*>(MapViewOfFile(file.mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (file.data == nullptr) {
+        std::cout << "failed to map " << path << "\n";
+        unmap_file(file);
+        return -1;
+    }
+    file.size = static_cast<size_t>(size.QuadPart);
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cout << "failed to open " << path << "\n";
+        return -1;
+    }
+    struct stat info = {};
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        std::cout << path << " is empty\n";
+        close(fd);
+        return -1;
+    }
+    size_t size = static_cast<size_t>(info.st_size);
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps the file open
+    if (data == MAP_FAILED) {
+        std::cout << "failed to map " << path << "\n";
+        return -1;
+    }
+    // streamed front to back once
+    madvise(data, size, MADV_SEQUENTIAL);
+    file.data = static_cast<const uint8_t*>(data);
+    file.size = size;
+#endif
+    return 0;
+}
+
+// count elements of stride bytes at offset are inside the file and aligned
+bool scene_array_fits(const MappedFile& file, uint64_t offset, uint32_t count, size_t stride) {
+    if (count == 0) return true;
+    return offset % SCENE_FILE_ALIGNMENT == 0 && offset <= file.size && (file.size - offset) / stride >= count;
+}
+
+// Maps the file and points the scene arrays into it; nothing is copied, the
+// pages are read as the scene streams to the GPU.
+int load_scene_file(const std::string& path, SceneSource& scene) {
+    if (0 != map_file(path, scene.file)) return -1;
+    SceneFileHeader header = {};
+    if (scene.file.size >= sizeof(header)) memcpy(&header, scene.file.data, sizeof(header));
+    if (memcmp(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic)) != 0 || header.version != SCENE_FILE_VERSION) {
+        std::cout << path << " is not a version " << SCENE_FILE_VERSION << " scene file\n";
+        unmap_file(scene.file);
+        return -1;
+    }
+    if (!scene_array_fits(scene.file, header.primitive_offset, header.primitive_count, sizeof(SdfPrimitive)) ||
+        !scene_array_fits(scene.file, header.light_offset, header.light_count, sizeof(SceneLight)) ||
+        !scene_array_fits(scene.file, header.camera_offset, header.camera_count, sizeof(SceneCamera))) {
+        std::cout << path << " is truncated or has misaligned arrays\n";
+        unmap_file(scene.file);
+        return -1;
+    }
+
+    scene.primitives = reinterpret_cast<const SdfPrimitive*>(scene.file.data + header.primitive_offset);
+    scene.primitive_count = header.primitive_count;
+    scene.lights = reinterpret_cast<const SceneLight*>(scene.file.data + header.light_offset);
+    scene.light_count = header.light_count;
+    scene.cameras = reinterpret_cast<const SceneCamera*>(scene.file.data + header.camera_offset);
+    scene.camera_count = header.camera_count;
+    if (scene.light_count == 0) {
+        scene.built_lights = { DEFAULT_LIGHT };
+        scene.lights = scene.built_lights.data();
+        scene.light_count = 1;
+    }
+    std::cout << "mapped " << path << ": " << scene.primitive_count << " primitives, " << header.light_count
+              << " lights, " << scene.camera_count << " cameras\n";
+    return 0;
+}
+
+int write_scene_file(const std::string& path, const SceneSource& scene) {
+    SceneFileHeader header = {};
+    memcpy(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic));
+    header.version = SCENE_FILE_VERSION;
+    header.primitive_count = scene.primitive_count;
+    header.light_count = scene.light_count;
+    header.camera_count = scene.camera_count;
+    header.primitive_offset = sizeof(SceneFileHeader);
+    header.light_offset = header.primitive_offset + sizeof(SdfPrimitive) * scene.primitive_count;
+    header.camera_offset = header.light_offset + sizeof(SceneLight) * scene.light_count;
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "failed to open " << path << " for writing\n";
+        return -1;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(scene.primitives), sizeof(SdfPrimitive) * scene.primitive_count);
+    file.write(reinterpret_cast<const char*>(scene.lights), sizeof(SceneLight) * scene.light_count);
+    file.write(reinterpret_cast<const char*>(scene.cameras), sizeof(SceneCamera) * scene.camera_count);
+    if (!file) {
+        std::cout << "failed to write " << path << "\n";
+        return -1;
+    }
+    std::cout << "wrote " << scene.primitive_count << " primitives to " << path << "\n";
+    return 0;
+}
+
+// --scene maps a scene file; otherwise the built-in scene is built in memory.
+int load_scene(const Options& options, SceneSource& scene) {
+    if (!options.scene_path.empty()) return load_scene_file(options.scene_path, scene);
+    scene.built_primitives = build_scene(options);
+    scene.built_lights = { DEFAULT_LIGHT };
+    scene.built_cameras = { { { 0.0f, 5.0f, -5.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f } } };
+    scene.primitives = scene.built_primitives.data();
+    scene.primitive_count = static_cast<uint32_t>(scene.built_primitives.size());
+    scene.lights = scene.built_lights.data();
+    scene.light_count = static_cast<uint32_t>(scene.built_lights.size());
+    scene.cameras = scene.built_cameras.data();
+    scene.camera_count = static_cast<uint32_t>(scene.built_cameras.size());
+    return 0;
+}
+
+// Moves the view to one of the scene's cameras, if it has that many.
+void apply_scene_camera(const SceneSource& scene, uint32_t index, Camera& camera) {
+    if (index >= scene.camera_count) return;
+    for (int i = 0; i < 3; i++) {
+        camera.position[i] = scene.cameras[index].position[i];
+        camera.target[i] = scene.cameras[index].target[i];
+    }
+}
+
+// Uploads the primitives into a storage buffer and creates the scene descriptor set
+// layout for what lives as long as the scene: binding 0 = primitives, 3 = march
+// step counters, 6/7 = brick map indirection and atlas, 8 = lights, 9 = frame
+// constants (see create_scene_descriptor_set). Everything sized to the output is in
+// the bindless table instead. The brick map fields of the header are filled in by
+// create_brick_map.
+int create_scene_resources(Init& init, RenderData& data) {
+    const uint32_t numbers[6] = { 0, 3, 6, 7, 8, 9 };
+    const VkDescriptorType types[6] = {
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC
+    };
+    VkDescriptorSetLayoutBinding bindings[6] = {};
+    for (uint32_t i = 0; i < 6; i++) {
+        bindings[i].binding = numbers[i];
+        bindings[i].descriptorType = types[i];
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo set_layout_info = {};
+    set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    set_layout_info.bindingCount = 6;
+    set_layout_info.pBindings = bindings;
+
+    if (init.disp.createDescriptorSetLayout(&set_layout_info, nullptr, &data.scene_set_layout) != VK_SUCCESS) {
+        std::cout << "failed to create scene descriptor set layout\n";
+        return -1;
+    }
+
+    // device local and empty: stream_scene fills both buffers through the
+    // staging ring, and the upload pass writes the header and later edits
+    const SceneSource& source = data.scene_source;
+    if (sizeof(SceneLight) * source.light_count > STAGING_RING_SIZE) {
+        std::cout << source.light_count << " lights do not fit the staging ring\n";
+        return -1;
+    }
+    VkDeviceSize size = sizeof(SceneHeader) + sizeof(SdfPrimitive) * source.primitive_count;
+    if (0 != create_buffer(init, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 0,
+            data.scene_buffer)) {
+        return -1;
+    }
+    if (0 != create_buffer(init, sizeof(SceneLight) * source.light_count,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 0, data.light_buffer)) {
+        return -1;
+    }
+    if (0 != create_buffer(init, STAGING_RING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, data.staging_ring.buffer)) {
+        return -1;
+    }
+    data.scene_header = SceneHeader{};
+    data.scene_header.light_count = source.light_count;
+    data.scene_stream = SceneStream{};
+    // the CPU copy the brick map is baked from and edits are applied to
+    data.scene_primitives.assign(source.primitives, source.primitives + source.primitive_count);
+    apply_scene_camera(source, 0, data.camera);
+    data.previous_camera = data.camera;
+
+    if (0 != create_buffer(init, MAX_FRAMES_IN_FLIGHT * 2 * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT, data.step_counters)) {
+        return -1;
+    }
+    // sized for MAX_FRAMES_IN_FLIGHT so the frames in flight setting can change;
+    // bound on both queues, and outside the render graph, so shared concurrently
+    data.frame_uniforms.alignment = std::max<VkDeviceSize>(
+        init.device.physical_device.properties.limits.minUniformBufferOffsetAlignment, 16);
+    uint32_t uniform_families = data.compute_queue != VK_NULL_HANDLE ? RG_QUEUE_COUNT : 1;
+    if (0 != create_buffer(init, FRAME_UNIFORM_SLICE_SIZE * MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, data.frame_uniforms.buffer, uniform_families,
+            data.graph.queue_families)) {
+        return -1;
+    }
+    memset(data.step_counters.mapped, 0, data.step_counters.size);
+    vmaFlushAllocation(init.allocator, data.step_counters.allocation, 0, VK_WHOLE_SIZE);
+
+    return 0;
+}
+
+// The bindless table: one update-after-bind set with an array per BindlessKind,
+// from a pool of its own since update-after-bind sets need a pool created for them.
+int create_bindless_table(Init& init, RenderData& data) {
+    BindlessTable& table = data.bindless;
+    VkDescriptorSetLayoutBinding bindings[BINDLESS_KIND_COUNT] = {};
+    VkDescriptorBindingFlags binding_flags[BINDLESS_KIND_COUNT] = {};
+    VkDescriptorPoolSize pool_sizes[BINDLESS_KIND_COUNT] = {};
+    for (uint32_t i = 0; i < BINDLESS_KIND_COUNT; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = BINDLESS_DESCRIPTOR_TYPES[i];
+        bindings[i].descriptorCount = BINDLESS_CAPACITY[i];
+        bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+        // slots nobody has taken yet are never written
+        binding_flags[i] = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+            VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+        pool_sizes[i] = { BINDLESS_DESCRIPTOR_TYPES[i], BINDLESS_CAPACITY[i] };
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flags_info = {};
+    flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    flags_info.bindingCount = BINDLESS_KIND_COUNT;
+    flags_info.pBindingFlags = binding_flags;
+
+    VkDescriptorSetLayoutCreateInfo set_layout_info = {};
+    set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    set_layout_info.pNext = &flags_info;
+    set_layout_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    set_layout_info.bindingCount = BINDLESS_KIND_COUNT;
+    set_layout_info.pBindings = bindings;
+
+    if (init.disp.createDescriptorSetLayout(&set_layout_info, nullptr, &table.layout) != VK_SUCCESS) {
+        std::cout << "failed to create bindless descriptor set layout\n";
+        return -1;
+    }
+
+    VkDescriptorPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    pool_info.maxSets = 1;
+    pool_info.poolSizeCount = BINDLESS_KIND_COUNT;
+    pool_info.pPoolSizes = pool_sizes;
+
+    if (init.disp.createDescriptorPool(&pool_info, nullptr, &table.pool) != VK_SUCCESS) {
+        std::cout << "failed to create bindless descriptor pool\n";
+        return -1;
+    }
+
+    VkDescriptorSetAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = table.pool;
+    alloc_info.descriptorSetCount = 1;
+    alloc_info.pSetLayouts = &table.layout;
+    if (init.disp.allocateDescriptorSets(&alloc_info, &table.set) != VK_SUCCESS) {
+        std::cout << "failed to allocate bindless descriptor set\n";
+        return -1;
+    }
+    return 0;
+}
+
+// Moves `index` to a fresh slot of `kind`. The slot it held goes back to the free
+// list only once every frame recorded so far has finished, so frames in flight
+// keep reading the resource they were recorded with.
+int bindless_take_slot(RenderData& data, BindlessKind kind, uint32_t& index) {
+    BindlessTable& table = data.bindless;
+    if (index != UINT32_MAX) {
+        uint32_t old_index = index;
+        defer_destroy(data, [&data, kind, old_index]() { data.bindless.free_slots[kind].push_back(old_index); });
+        index = UINT32_MAX;
+    }
+    if (!table.free_slots[kind].empty()) {
+        index = table.free_slots[kind].back();
+        table.free_slots[kind].pop_back();
+    } else if (table.used[kind] < BINDLESS_CAPACITY[kind]) {
+        index = table.used[kind]++;
+    } else {
+        std::cout << "bindless table is out of " << BINDLESS_CAPACITY[kind] << " slots for binding " << kind << "\n";
+        return -1;
+    }
+    return 0;
+}
+
+// Gives an image a slot of `kind` (storage or sampled), read and written in `layout`.
+int bindless_store_image(Init& init, RenderData& data, BindlessKind kind, VkImageView view, VkImageLayout layout,
+    uint32_t& index) {
+    if (0 != bindless_take_slot(data, kind, index)) return -1;
+
+    VkDescriptorImageInfo image_info = {};
+    image_info.imageView = view;
+    image_info.imageLayout = layout;
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = data.bindless.set;
+    write.dstBinding = kind;
+    write.dstArrayElement = index;
+    write.descriptorCount = 1;
+    write.descriptorType = BINDLESS_DESCRIPTOR_TYPES[kind];
+    write.pImageInfo = &image_info;
+    init.disp.updateDescriptorSets(1, &write, 0, nullptr);
+    return 0;
+}
+
+int bindless_store_buffer(Init& init, RenderData& data, VkBuffer buffer, uint32_t& index) {
+    if (0 != bindless_take_slot(data, BINDLESS_STORAGE_BUFFER, index)) return -1;
+
+    VkDescriptorBufferInfo buffer_info = {};
+    buffer_info.buffer = buffer;
+    buffer_info.range = VK_WHOLE_SIZE;
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = data.bindless.set;
+    write.dstBinding = BINDLESS_STORAGE_BUFFER;
+    write.dstArrayElement = index;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &buffer_info;
+    init.disp.updateDescriptorSets(1, &write, 0, nullptr);
+    return 0;
+}
+
+// The one layout of every scene pipeline: the scene set, the bindless table and
+// the table indices as push constants.
+int create_pipeline_layout(Init& init, RenderData& data) {
+    VkDescriptorSetLayout set_layouts[] = { data.scene_set_layout, data.bindless.layout };
+
+    VkPushConstantRange push_range = {};
+    push_range.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+    push_range.size = sizeof(BindlessIndices);
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.setLayoutCount = 2;
+    pipeline_layout_info.pSetLayouts = set_layouts;
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &push_range;
+
+    if (init.disp.createPipelineLayout(&pipeline_layout_info, nullptr, &data.pipeline_layout) != VK_SUCCESS) {
+        std::cout << "failed to create pipeline layout\n";
+        return -1;
+    }
+    return 0;
+}
+
+VkExtent2D cull_tile_count(VkExtent2D extent) {
+    return { (extent.width + CULL_TILE_SIZE - 1) / CULL_TILE_SIZE, (extent.height + CULL_TILE_SIZE - 1) / CULL_TILE_SIZE };
+}
+
+// (Re)creates the per-tile primitive lists, sized to the output, and their table slot.
+int create_tile_lists(Init& init, RenderData& data) {
+    if (data.tile_list_buffer.buffer != VK_NULL_HANDLE) {
+        rg_forget(data.graph, rg_key(data.tile_list_buffer.buffer));
+        AllocatedBuffer old = data.tile_list_buffer;
+        defer_destroy(data, [&init, old]() mutable { destroy_buffer(init, old); });
+        data.tile_list_buffer = AllocatedBuffer{};
+    }
+
+    VkExtent2D tiles = cull_tile_count(init.output_extent);
+    VkDeviceSize size = (VkDeviceSize)tiles.width * tiles.height * (MAX_TILE_PRIMITIVES + 1) * sizeof(uint32_t);
+    if (0 != create_buffer(init, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, 0, data.tile_list_buffer)) return -1;
+    return bindless_store_buffer(init, data, data.tile_list_buffer.buffer, data.bindless_indices.tile_lists);
+}
+
+// Creates the shadow/AO and checker history images, each with a bindless table
+// slot, unless they already match the output size.
+int create_history_images(Init& init, RenderData& data) {
+    VkExtent2D extent = data.history[0].extent;
+    if (data.history[0].image != VK_NULL_HANDLE &&
+        extent.width == init.output_extent.width && extent.height == init.output_extent.height) {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < 4; i++) {
+        AllocatedImage& image = i < 2 ? data.history[i] : data.checker_history[i - 2];
+        if (image.image != VK_NULL_HANDLE) {
+            rg_forget(data.graph, rg_key(image.image));
+            AllocatedImage old = image;
+            defer_destroy(data, [&init, old]() mutable { destroy_image(init, old); });
+            image = AllocatedImage{};
+        }
+        if (0 != create_image(init, init.output_extent, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT,
+                image)) {
+            return -1;
+        }
+        uint32_t& index = i < 2 ? data.bindless_indices.history[i] : data.bindless_indices.checker_history[i - 2];
+        if (0 != bindless_store_image(init, data, BINDLESS_STORAGE_IMAGE, image.view, VK_IMAGE_LAYOUT_GENERAL,
+                index)) {
+            return -1;
+        }
+    }
+    data.history_frames = 0;
+    data.checker_frames = 0;
+    return 0;
+}
+
+int build_compute_pipeline(Init& init, const std::string& spv_path, VkPipelineLayout layout,
+    const VkSpecializationInfo* spec_info, VkPipeline& pipeline) {
+    auto comp_code = readFile(spv_path);
+    VkShaderModule comp_module = createShaderModule(init, comp_code);
+    if (comp_module == VK_NULL_HANDLE) {
+        std::cout << "failed to create shader module\n";
+        return -1;
+    }
+
+    VkComputePipelineCreateInfo pipeline_info = {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_info.stage.module = comp_module;
+    pipeline_info.stage.pName = "main";
+    pipeline_info.stage.pSpecializationInfo = spec_info;
+    pipeline_info.layout = layout;
+
+    VkResult result = init.disp.createComputePipelines(init.pipeline_cache, 1, &pipeline_info, nullptr, &pipeline);
+    init.disp.destroyShaderModule(comp_module, nullptr);
+    if (result != VK_SUCCESS) {
+        std::cout << "failed to create compute pipeline " << spv_path << "\n";
+        return -1;
+    }
+    return 0;
+}
+
+// Culling only needs the largest EPSILON of any tier for its bounds inflation.
+int build_cull_pipeline(Init& init, const RenderData& data, VkPipeline& pipeline) {
+    std::vector<VkSpecializationMapEntry> spec_entries;
+    VkSpecializationInfo spec_info = quality_spec_info(QUALITY_LOW, spec_entries);
+    return build_compute_pipeline(init, "shaders/cull.comp.spv", data.pipeline_layout, &spec_info, pipeline);
+}
+
+int build_prepass_pipeline(Init& init, const RenderData& data, QualityTier tier, VkPipeline& pipeline) {
+    std::vector<VkSpecializationMapEntry> spec_entries;
+    VkSpecializationInfo spec_info = quality_spec_info(tier, spec_entries);
+    return build_compute_pipeline(init, "shaders/prepass.comp.spv", data.pipeline_layout, &spec_info, pipeline);
+}
+
+// The culling and coarse depth pre-passes.
+int create_scene_compute_pipelines(Init& init, RenderData& data) {
+    if (0 != build_cull_pipeline(init, data, data.pipelines.cull)) return -1;
+    for (uint32_t tier = 0; tier < QUALITY_TIER_COUNT; tier++) {
+        if (0 != build_prepass_pipeline(init, data, (QualityTier)tier, data.pipelines.prepass[tier])) return -1;
+    }
+    return 0;
+}
+
+// Compute pipeline with compute_tile_size workgroups and one tier's quality constants.
+int build_tiled_pipeline(Init& init, const RenderData& data, const std::string& spv_path, VkPipelineLayout layout,
+    QualityTier tier, VkPipeline& pipeline) {
+    struct {
+        uint32_t tile_size[2];
+        QualitySpecialization quality;
+    } spec_data = { { data.compute_tile_size, data.compute_tile_size }, QUALITY_TIERS[tier] };
+
+    // local_size_x_id = 0, local_size_y_id = 1
+    std::vector<VkSpecializationMapEntry> spec_entries = {
+        { 0, 0, sizeof(uint32_t) },
+        { 1, sizeof(uint32_t), sizeof(uint32_t) }
+    };
+    append_quality_entries(spec_entries, (uint32_t)offsetof(decltype(spec_data), quality));
+    VkSpecializationInfo spec_info = {};
+    spec_info.mapEntryCount = static_cast<uint32_t>(spec_entries.size());
+    spec_info.pMapEntries = spec_entries.data();
+    spec_info.dataSize = sizeof(spec_data);
+    spec_info.pData = &spec_data;
+
+    return build_compute_pipeline(init, spv_path, layout, &spec_info, pipeline);
+}
+
+int build_raymarch_pipeline(Init& init, const RenderData& data, QualityTier tier, VkPipeline& pipeline) {
+    return build_tiled_pipeline(init, data, "shaders/raymarch.comp.spv", data.pipeline_layout, tier, pipeline);
+}
+
+int create_compute_pipeline(Init& init, RenderData& data) {
+    for (uint32_t tier = 0; tier < QUALITY_TIER_COUNT; tier++) {
+        if (0 != build_raymarch_pipeline(init, data, (QualityTier)tier, data.pipelines.raymarch[tier])) return -1;
+    }
+    return 0;
+}
+
+// G-buffer, shadow/AO, composite and checkerboard reconstruct passes of one tier.
+int build_split_pipelines(Init& init, const RenderData& data, QualityTier tier, ShaderPipelines& pipelines) {
+    VkPipelineLayout layout = data.pipeline_layout;
+    if (0 != build_tiled_pipeline(init, data, "shaders/gbuffer.comp.spv", layout, tier, pipelines.gbuffer[tier])) {
+        return -1;
+    }
+    if (0 != build_tiled_pipeline(init, data, "shaders/lighting.comp.spv", layout, tier, pipelines.lighting[tier])) {
+        return -1;
+    }
+    if (0 != build_tiled_pipeline(init, data, "shaders/composite.comp.spv", layout, tier, pipelines.composite[tier])) {
+        return -1;
+    }
+    return build_tiled_pipeline(init, data, "shaders/reconstruct.comp.spv", layout, tier, pipelines.reconstruct[tier]);
+}
+
+int create_split_pipelines(Init& init, RenderData& data) {
+    for (uint32_t tier = 0; tier < QUALITY_TIER_COUNT; tier++) {
+        if (0 != build_split_pipelines(init, data, (QualityTier)tier, data.pipelines)) return -1;
+    }
+    return 0;
+}
+
+void destroy_shader_pipelines(Init& init, ShaderPipelines& pipelines) {
+    for (uint32_t tier = 0; tier < QUALITY_TIER_COUNT; tier++) {
+        init.disp.destroyPipeline(pipelines.graphics[tier], nullptr);
+        init.disp.destroyPipeline(pipelines.raymarch[tier], nullptr);
+        init.disp.destroyPipeline(pipelines.prepass[tier], nullptr);
+        init.disp.destroyPipeline(pipelines.gbuffer[tier], nullptr);
+        init.disp.destroyPipeline(pipelines.lighting[tier], nullptr);
+        init.disp.destroyPipeline(pipelines.composite[tier], nullptr);
+        init.disp.destroyPipeline(pipelines.reconstruct[tier], nullptr);
+    }
+    init.disp.destroyPipeline(pipelines.cull, nullptr);
+    init.disp.destroyPipeline(pipelines.ui_blend, nullptr);
+    pipelines = ShaderPipelines{};
+}
+
+int build_shader_pipelines(Init& init, const RenderData& data, ShaderPipelines& pipelines) {
+    try {
+        bool built = 0 == build_cull_pipeline(init, data, pipelines.cull) &&
+            0 == build_ui_blend_pipeline(init, data, pipelines.ui_blend);
+        for (uint32_t tier = 0; built && tier < QUALITY_TIER_COUNT; tier++) {
+            built = 0 == build_graphics_pipeline(init, data, (QualityTier)tier, pipelines.graphics[tier]) &&
+                0 == build_raymarch_pipeline(init, data, (QualityTier)tier, pipelines.raymarch[tier]) &&
+                0 == build_prepass_pipeline(init, data, (QualityTier)tier, pipelines.prepass[tier]) &&
+                0 == build_split_pipelines(init, data, (QualityTier)tier, pipelines);
+        }
+        if (built) return 0;
+    } catch (const std::exception& e) {
+        std::cout << e.what() << "\n";
+    }
+    destroy_shader_pipelines(init, pipelines);
+    return -1;
+}
+
+// Modification times of everything in the shader source dir, GLSL includes included.
+std::map<std::string, std::filesystem::file_time_type> shader_source_times() {
+    std::map<std::string, std::filesystem::file_time_type> times;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(COAL_SHADER_SOURCE_DIR, error)) {
+        std::string extension = entry.path().extension().string();
+        if (extension == ".vert" || extension == ".frag" || extension == ".comp" || extension == ".glsl") {
+            times[entry.path().string()] = entry.last_write_time(error);
+        }
+    }
+    return times;
+}
+
+// Compiles every stage into shaders/*.spv. All stages go to temporary files
+// first so a syntax error leaves the working SPIR-V untouched.
+int compile_shader_sources() {
+    std::vector<std::filesystem::path> sources;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(COAL_SHADER_SOURCE_DIR, error)) {
+        std::string extension = entry.path().extension().string();
+        if (extension == ".vert" || extension == ".frag" || extension == ".comp") {
+            sources.push_back(entry.path());
+        }
+    }
+
+    for (const auto& source : sources) {
+        std::string output = "shaders/" + source.filename().string() + ".spv.tmp";
+        std::string command = std::string("\"") + COAL_GLSLC + "\" -o \"" + output + "\" \"" + source.string() + "\"";
+        if (std::system(command.c_str()) != 0) {
+            std::cout << "failed to compile " << source.string() << ", keeping the current pipelines\n";
+            return -1;
+        }
+    }
+    for (const auto& source : sources) {
+        std::string output = "shaders/" + source.filename().string() + ".spv";
+        std::filesystem::rename(output + ".tmp", output, error);
+        if (error) {
+            std::cout << "failed to replace " << output << "\n";
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void shader_reload_worker(Init* init, RenderData* data) {
+    ShaderReloader& reloader = *data->shader_reloader;
+    auto times = shader_source_times();
+    while (!reloader.stop) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        auto current = shader_source_times();
+        if (current == times) continue;
+        // editors often save in several steps; let the writes settle
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        times = shader_source_times();
+
+        auto start = std::chrono::steady_clock::now();
+        ShaderPipelines pipelines;
+        if (0 != compile_shader_sources() || 0 != build_shader_pipelines(*init, *data, pipelines)) continue;
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "shaders reloaded in " << elapsed.count() << " ms\n";
+
+        std::lock_guard<std::mutex> lock(reloader.mutex);
+        if (reloader.ready) {
+            // never handed to the render loop, so nothing on the GPU uses it
+            destroy_shader_pipelines(*init, reloader.pending);
+        }
+        reloader.pending = pipelines;
+        reloader.ready = true;
+    }
+}
+
+void start_shader_reloader(Init& init, RenderData& data) {
+    data.shader_reloader = std::make_unique<ShaderReloader>();
+    data.shader_reloader->worker = std::thread(shader_reload_worker, &init, &data);
+    std::cout << "watching " << COAL_SHADER_SOURCE_DIR << " for shader changes\n";
+}
+
+// Called at a frame boundary, once the current slot's last frame has finished:
+// frees retired pipelines no frame in flight can still use and swaps in a
+// freshly built set if the worker has one ready.
+void update_shader_reloader(Init& init, RenderData& data) {
+    if (!data.shader_reloader) return;
+    ShaderReloader& reloader = *data.shader_reloader;
+
+    auto& retired = reloader.retired;
+    for (auto it = retired.begin(); it != retired.end();) {
+        if (it->last_frame <= data.completed_frames) {
+            destroy_shader_pipelines(init, it->pipelines);
+            it = retired.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(reloader.mutex, std::try_to_lock);
+    if (!lock.owns_lock() || !reloader.ready) return;
+
+    RetiredPipelines old = {};
+    old.pipelines = data.pipelines;
+    old.last_frame = data.frame_number;
+    retired.push_back(old);
+
+    data.pipelines = reloader.pending;
+    reloader.pending = ShaderPipelines{};
+    reloader.ready = false;
+}
+
+void stop_shader_reloader(Init& init, RenderData& data) {
+    if (!data.shader_reloader) return;
+    ShaderReloader& reloader = *data.shader_reloader;
+    reloader.stop = true;
+    if (reloader.worker.joinable()) reloader.worker.join();
+    // callers have waited for the device to go idle
+    destroy_shader_pipelines(init, reloader.pending);
+    for (auto& old : reloader.retired) destroy_shader_pipelines(init, old.pipelines);
+    data.shader_reloader.reset();
+}
+
+int create_offscreen_targets(Init& init, RenderData& data) {
+    data.offscreen_images.resize(MAX_FRAMES_IN_FLIGHT);
+    // a sequence reads back through the encoders' ring only, one buffer per frame
+    // in flight otherwise
+    data.readback_buffers.resize(data.readback_ring > 0 ? data.readback_ring : MAX_FRAMES_IN_FLIGHT);
+
+    VkDeviceSize readback_size = (VkDeviceSize)init.output_extent.width * init.output_extent.height * 4;
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        if (0 != create_image(init, init.output_extent, init.output_format,
+                VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                data.offscreen_images[i])) {
+            return -1;
+        }
+    }
+    for (size_t i = 0; i < data.readback_buffers.size(); i++) {
+        if (0 != create_buffer(init, readback_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT, data.readback_buffers[i])) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Output images the frame ends in: the swapchain images, or the offscreen targets
+// when headless. Their framebuffers are created by the render graph on first use.
+int create_output_images(Init& init, RenderData& data) {
+    if (init.headless) {
+        if (0 != create_offscreen_targets(init, data)) return -1;
+        data.swapchain_images.clear();
+        data.swapchain_image_views.clear();
+        for (auto& target : data.offscreen_images) {
+            data.swapchain_images.push_back(target.image);
+            data.swapchain_image_views.push_back(target.view);
+        }
+    } else {
+        data.swapchain_images = init.swapchain.get_images().value();
+        data.swapchain_image_views = init.swapchain.get_image_views().value();
+    }
+    return 0;
+}
+
+int create_command_pool(Init& init, RenderData& data) {
+    VkCommandPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.queueFamilyIndex = init.device.get_queue_index(vkb::QueueType::graphics).value();
+    pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+    if (init.disp.createCommandPool(&pool_info, nullptr, &data.command_pool) != VK_SUCCESS) {
+        std::cout << "failed to create command pool\n";
+        return -1; // failed to create command pool
+    }
+    if (data.compute_queue != VK_NULL_HANDLE) {
+        pool_info.queueFamilyIndex = data.graph.queue_families[RG_QUEUE_COMPUTE];
+        if (init.disp.createCommandPool(&pool_info, nullptr, &data.compute_command_pool) != VK_SUCCESS) {
+            std::cout << "failed to create compute command pool\n";
+            return -1;
+        }
+    }
+    return 0;
+}
+
+FrameConstants frame_constants(const Init& init, const RenderData& data) {
+    FrameConstants constants = {};
+    for (int i = 0; i < 3; i++) {
+        constants.camera_position[i] = data.camera.position[i];
+        constants.camera_target[i] = data.camera.target[i];
+        constants.prev_camera_position[i] = data.previous_camera.position[i];
+        constants.prev_camera_target[i] = data.previous_camera.target[i];
+    }
+    constants.resolution[0] = data.render_extent.width;
+    constants.resolution[1] = data.render_extent.height;
+    constants.prev_resolution[0] = data.previous_render_extent.width;
+    constants.prev_resolution[1] = data.previous_render_extent.height;
+    constants.frame_index = data.frame_index;
+    constants.frame_slot = static_cast<uint32_t>(data.current_frame);
+    constants.lighting_scale = data.lighting_scale;
+    constants.checker_phase = data.frame_index & 1u;
+    if (data.depth_prepass) constants.flags |= FRAME_FLAG_DEPTH_PREPASS;
+    if (data.step_stats) constants.flags |= FRAME_FLAG_STEP_STATS;
+    if (data.step_heatmap) constants.flags |= FRAME_FLAG_STEP_HEATMAP;
+    if (data.temporal) constants.flags |= FRAME_FLAG_TEMPORAL;
+    if (data.temporal && data.history_frames > 0) constants.flags |= FRAME_FLAG_HISTORY_VALID;
+    // the bricks already hold primitives that are still streaming in
+    if (data.use_brick_map && scene_resident(data)) constants.flags |= FRAME_FLAG_BRICK_MAP;
+    if (data.split_passes && data.checkerboard) {
+        constants.flags |= FRAME_FLAG_CHECKERBOARD;
+        if (data.checker_frames > 0) constants.flags |= FRAME_FLAG_CHECKER_HISTORY;
+    }
+    return constants;
+}
+
+void update_camera(RenderData& data) {
+    data.previous_camera = data.camera;
+    if (!data.orbit_camera) return;
+
+    // fixed step per frame so headless runs are reproducible
+    data.camera_angle += 0.005f;
+    const float radius = 5.0f;
+    data.camera.position[0] = data.camera.target[0] + radius * std::sin(data.camera_angle);
+    data.camera.position[2] = data.camera.target[2] - radius * std::cos(data.camera_angle);
+}
+
+// Builds the per-tile primitive lists read by both ray march paths.
+void record_cull_pass(Init& init, RenderData& data, VkCommandBuffer cmd) {
+    init.disp.cmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, data.pipelines.cull);
+
+    VkExtent2D tiles = cull_tile_count(data.render_extent);
+    init.disp.cmdDispatch(cmd, tiles.width, tiles.height, 1);
+}
+
+// Cone-marches one ray per PREPASS_BLOCK_SIZE block into coarse_depth.
+void record_depth_prepass(Init& init, RenderData& data, VkCommandBuffer cmd) {
+    init.disp.cmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, data.pipelines.prepass[data.quality_tier]);
+
+    uint32_t blocks_x = (data.render_extent.width + PREPASS_BLOCK_SIZE - 1) / PREPASS_BLOCK_SIZE;
+    uint32_t blocks_y = (data.render_extent.height + PREPASS_BLOCK_SIZE - 1) / PREPASS_BLOCK_SIZE;
+    init.disp.cmdDispatch(cmd, (blocks_x + 7) / 8, (blocks_y + 7) / 8, 1);
+}
+
+// Marches the scene in tiles into scene_target.
+void record_compute_scene(Init& init, RenderData& data, VkCommandBuffer cmd) {
+    init.disp.cmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, data.pipelines.raymarch[data.quality_tier]);
+
+    VkExtent2D extent = data.render_extent;
+    uint32_t tile = data.compute_tile_size;
+    init.disp.cmdDispatch(cmd, (extent.width + tile - 1) / tile, (extent.height + tile - 1) / tile, 1);
+}
+
+// One of the split passes over extent, in compute tiles.
+void record_split_pass(Init& init, RenderData& data, VkCommandBuffer cmd, VkPipeline pipeline, VkExtent2D extent) {
+    init.disp.cmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+    uint32_t tile = data.compute_tile_size;
+    init.disp.cmdDispatch(cmd, (extent.width + tile - 1) / tile, (extent.height + tile - 1) / tile, 1);
+}
+
+// Shadow/AO blocks covering the render extent at the current lighting scale.
+VkExtent2D lighting_extent(const RenderData& data) {
+    return { (data.render_extent.width + data.lighting_scale - 1) / data.lighting_scale,
+        (data.render_extent.height + data.lighting_scale - 1) / data.lighting_scale };
+}
+
+// Fullscreen-quad ray march into scene_target; the graph begins the scene render
+// pass over render_extent.
+void record_fragment_scene(Init& init, RenderData& data, VkCommandBuffer cmd) {
+    init.disp.cmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, data.pipelines.graphics[data.quality_tier]);
+
+    init.disp.cmdDraw(cmd, 4, 1, 0, 0);
+}
+
+// Scales the render_extent corner of scene_target up to the whole output image.
+void record_upscale(Init& init, RenderData& data, VkCommandBuffer cmd, uint32_t image_index) {
+    VkImageBlit blit = {};
+    blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    blit.srcSubresource.layerCount = 1;
+    blit.srcOffsets[1] = { (int32_t)data.render_extent.width, (int32_t)data.render_extent.height, 1 };
+    blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    blit.dstSubresource.layerCount = 1;
+    blit.dstOffsets[1] = { (int32_t)init.output_extent.width, (int32_t)init.output_extent.height, 1 };
+
+    bool scaled = data.render_extent.width != init.output_extent.width ||
+        data.render_extent.height != init.output_extent.height;
+    init.disp.cmdBlitImage(cmd, data.graph.transients[data.scene_target].image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        data.swapchain_images[image_index], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit,
+        scaled ? VK_FILTER_LINEAR : VK_FILTER_NEAREST);
+}
+
+// Headless: copies the finished output image into the frame's readback buffer.
+void record_readback(Init& init, RenderData& data, VkCommandBuffer cmd, uint32_t image_index, uint32_t buffer) {
+    VkBufferImageCopy region = {};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = { init.output_extent.width, init.output_extent.height, 1 };
+    init.disp.cmdCopyImageToBuffer(cmd, data.swapchain_images[image_index],
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, data.readback_buffers[buffer].buffer, 1, &region);
+}
+
+// Copies the next slice of the scene source into the staging ring for this
+// frame's upload pass: the lights first, then primitives in order, at most
+// SCENE_STREAM_BYTES_PER_FRAME a frame. The header's primitive count follows the
+// copies, so a large scene fills in over several frames while draw_frame never
+// waits on it; a ring still busy with earlier frames just delays the next slice.
+void stream_scene(Init& init, RenderData& data) {
+    SceneStream& stream = data.scene_stream;
+    const SceneSource& source = data.scene_source;
+    StagingRing& ring = data.staging_ring;
+    if (stream.lights_resident && stream.resident_primitives == source.primitive_count) return;
+    staging_ring_reclaim(ring, data.completed_frames);
+
+    auto* mapped = static_cast<uint8_t*>(ring.buffer.mapped);
+    VkDeviceSize offset = 0;
+    if (!stream.lights_resident) {
+        VkDeviceSize size = sizeof(SceneLight) * source.light_count;
+        if (!staging_ring_alloc(ring, size, STAGING_RING_ALIGNMENT, offset)) return;
+        memcpy(mapped + offset, source.lights, size);
+        vmaFlushAllocation(init.allocator, ring.buffer.allocation, offset, size);
+        stream.light_copies.push_back({ offset, 0, size });
+        stream.lights_resident = true;
+    }
+
+    uint32_t remaining = source.primitive_count - stream.resident_primitives;
+    uint32_t count = std::min(remaining, static_cast<uint32_t>(SCENE_STREAM_BYTES_PER_FRAME / sizeof(SdfPrimitive)));
+    if (count > 0) {
+        // a smaller slice still fits when the ring is partly in flight
+        while (!staging_ring_alloc(ring, sizeof(SdfPrimitive) * count, STAGING_RING_ALIGNMENT, offset)) {
+            count /= 2;
+            if (count == 0) break;
+        }
+    }
+    if (count > 0) {
+        VkDeviceSize size = sizeof(SdfPrimitive) * count;
+        memcpy(mapped + offset, source.primitives + stream.resident_primitives, size);
+        vmaFlushAllocation(init.allocator, ring.buffer.allocation, offset, size);
+        VkDeviceSize destination = sizeof(SceneHeader) + sizeof(SdfPrimitive) * stream.resident_primitives;
+        stream.primitive_copies.push_back({ offset, destination, size });
+        stream.resident_primitives += count;
+        data.scene_header.primitive_count = stream.resident_primitives;
+        stream.header_dirty = true;
+    }
+    staging_ring_submit(ring, data.frame_number);
+}
+
+// Records this frame's slice of the scene stream and the header.
+void record_scene_upload(Init& init, RenderData& data, VkCommandBuffer cmd) {
+    SceneStream& stream = data.scene_stream;
+    VkBuffer ring = data.staging_ring.buffer.buffer;
+    if (!stream.light_copies.empty()) {
+        init.disp.cmdCopyBuffer(cmd, ring, data.light_buffer.buffer,
+            static_cast<uint32_t>(stream.light_copies.size()), stream.light_copies.data());
+    }
+    if (!stream.primitive_copies.empty()) {
+        init.disp.cmdCopyBuffer(cmd, ring, data.scene_buffer.buffer,
+            static_cast<uint32_t>(stream.primitive_copies.size()), stream.primitive_copies.data());
+    }
+    if (stream.header_dirty) {
+        init.disp.cmdUpdateBuffer(cmd, data.scene_buffer.buffer, 0, sizeof(SceneHeader), &data.scene_header);
+    }
+    stream.light_copies.clear();
+    stream.primitive_copies.clear();
+    stream.header_dirty = false;
+}
+
+bool uploads_pending(const RenderData& data) {
+    const SceneStream& stream = data.scene_stream;
+    return stream.header_dirty || !stream.light_copies.empty() || !stream.primitive_copies.empty() ||
+        !data.brick_map.pending.empty();
+}
+
+// Headless runs stream the whole scene before their first frame so that every
+// run renders the same frames; one submit per slice, waiting for each.
+int finish_scene_stream(Init& init, RenderData& data) {
+    while (!scene_resident(data) || data.scene_stream.header_dirty) {
+        stream_scene(init, data);
+
+        VkCommandBufferAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.commandPool = data.command_pool;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.commandBufferCount = 1;
+        VkCommandBuffer cmd = VK_NULL_HANDLE;
+        if (init.disp.allocateCommandBuffers(&alloc_info, &cmd) != VK_SUCCESS) {
+            std::cout << "failed to allocate scene upload command buffer\n";
+            return -1;
+        }
+
+        VkCommandBufferBeginInfo begin_info = {};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        init.disp.beginCommandBuffer(cmd, &begin_info);
+        record_scene_upload(init, data, cmd);
+        // the frame graph starts without knowing about these writes
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        init.disp.cmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &barrier, 0, nullptr,
+            0, nullptr);
+        init.disp.endCommandBuffer(cmd);
+
+        VkSubmitInfo submit_info = {};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &cmd;
+        int res = 0;
+        if (init.disp.queueSubmit(data.graphics_queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+            std::cout << "failed to submit scene upload\n";
+            res = -1;
+        }
+        init.disp.queueWaitIdle(data.graphics_queue);
+        init.disp.freeCommandBuffers(data.command_pool, 1, &cmd);
+        if (res != 0) return res;
+
+        StagingRing& ring = data.staging_ring;
+        ring.tail = ring.head;
+        ring.frames.clear();
+    }
+    return 0;
+}
+
+// Records every pending brick map upload and primitive edit; the staging buffers
+// are released once this frame has finished.
+void record_brick_upload(Init& init, RenderData& data, VkCommandBuffer cmd) {
+    BrickMap& map = data.brick_map;
+    for (BrickUpload& upload : map.pending) {
+        for (const auto& edit : upload.primitives) {
+            VkDeviceSize offset = sizeof(SceneHeader) + sizeof(SdfPrimitive) * edit.first;
+            init.disp.cmdUpdateBuffer(cmd, data.scene_buffer.buffer, offset, sizeof(SdfPrimitive), &edit.second);
+        }
+        if (!upload.bricks.empty()) {
+            init.disp.cmdCopyBufferToImage(cmd, upload.staging.buffer, map.atlas.image,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(upload.bricks.size()), upload.bricks.data());
+        }
+        if (!upload.indirection.empty()) {
+            init.disp.cmdCopyBufferToImage(cmd, upload.staging.buffer, map.indirection.image,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(upload.indirection.size()),
+                upload.indirection.data());
+        }
+
+        AllocatedBuffer staging = upload.staging;
+        defer_destroy(data, [&init, staging]() mutable { destroy_buffer(init, staging); });
+    }
+    map.pending.clear();
+}
+
+// Declares this frame's passes and what each of them reads and writes. A plan
+// build declares every optional pass, so rg_realize sees the longest lifetimes.
+void build_frame_graph(Init& init, RenderData& data, uint32_t image_index, bool plan) {
+    RenderGraph& graph = data.graph;
+    rg_begin(graph);
+
+    RgHandle tile_lists = rg_import_buffer(graph, "tile_lists", data.tile_list_buffer.buffer, nullptr);
+    RgHandle step_counters = rg_import_buffer(graph, "step_counters", data.step_counters.buffer, nullptr);
+    rg_set_final(graph, step_counters, RG_HOST_READ);
+    RgHandle history[2];
+    for (uint32_t i = 0; i < 2; i++) {
+        history[i] = rg_import_image(graph, "history", data.history[i].image, data.history[i].view,
+            data.history[i].format, data.history[i].extent, nullptr);
+        rg_retain(graph, history[i]);
+    }
+    RgHandle coarse_depth = rg_use_transient(graph, data.coarse_depth);
+    RgHandle scene_target = rg_use_transient(graph, data.scene_target);
+    RgHandle scene_buffer = rg_import_buffer(graph, "scene", data.scene_buffer.buffer, nullptr);
+    RgHandle light_buffer = rg_import_buffer(graph, "lights", data.light_buffer.buffer, nullptr);
+    BrickMap& brick_map = data.brick_map;
+    RgHandle brick_indirection = rg_import_image(graph, "brick_indirection", brick_map.indirection.image,
+        brick_map.indirection.view, brick_map.indirection.format, brick_map.indirection.extent, nullptr);
+    RgHandle brick_atlas = rg_import_image(graph, "brick_atlas", brick_map.atlas.image, brick_map.atlas.view,
+        brick_map.atlas.format, brick_map.atlas.extent, nullptr);
+
+    // a swapchain image is ready once the acquire semaphore, waited on at color
+    // attachment output, signals; an offscreen image once its last readback is done
+    RgState output_state = {};
+    if (init.headless) {
+        output_state.read_stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    } else {
+        output_state.write_stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    }
+    RgHandle output = rg_import_image(graph, "output", data.swapchain_images[image_index],
+        data.swapchain_image_views[image_index], init.output_format, init.output_extent, &output_state);
+    if (!init.headless) rg_set_final(graph, output, RG_PRESENT);
+
+    // streamed scene data, baked bricks and primitive edits, first in the frame
+    // so every pass sees them
+    if (uploads_pending(data)) {
+        uint32_t upload = rg_add_pass(graph, "upload", GPU_SCOPE_UPLOAD, [&init, &data](VkCommandBuffer cmd) {
+            record_scene_upload(init, data, cmd);
+            record_brick_upload(init, data, cmd);
+        });
+        rg_use(graph, upload, scene_buffer, RG_TRANSFER_DST);
+        rg_use(graph, upload, light_buffer, RG_TRANSFER_DST);
+        rg_use(graph, upload, brick_indirection, RG_TRANSFER_DST);
+        rg_use(graph, upload, brick_atlas, RG_TRANSFER_DST);
+        rg_retain(graph, scene_buffer);
+        rg_retain(graph, light_buffer);
+        rg_retain(graph, brick_indirection);
+        rg_retain(graph, brick_atlas);
+    }
+
+    uint32_t cull = rg_add_pass(graph, "cull", GPU_SCOPE_CULL,
+        [&init, &data](VkCommandBuffer cmd) { record_cull_pass(init, data, cmd); });
+    rg_use(graph, cull, tile_lists, RG_COMPUTE_READ_WRITE);
+    rg_use(graph, cull, scene_buffer, RG_COMPUTE_READ);
+
+    if (data.depth_prepass || plan) {
+        uint32_t prepass = rg_add_pass(graph, "prepass", GPU_SCOPE_PREPASS,
+            [&init, &data](VkCommandBuffer cmd) { record_depth_prepass(init, data, cmd); });
+        rg_use(graph, prepass, tile_lists, RG_COMPUTE_READ);
+        rg_use(graph, prepass, coarse_depth, RG_COMPUTE_READ_WRITE);
+        rg_use(graph, prepass, scene_buffer, RG_COMPUTE_READ);
+        rg_use(graph, prepass, brick_indirection, RG_COMPUTE_READ);
+        rg_use(graph, prepass, brick_atlas, RG_COMPUTE_READ);
+    }
+
+    RgHandle gbuffer_normal_depth = rg_use_transient(graph, data.gbuffer_normal_depth);
+    RgHandle gbuffer_material = rg_use_transient(graph, data.gbuffer_material);
+    RgHandle shadow_ao = rg_use_transient(graph, data.shadow_ao);
+    // only worth the extra blend when the lighting pass overlaps it
+    bool layered_ui = !init.headless && ((data.split_passes && graph.async && data.show_ui) || plan);
+    RgHandle ui_layer = layered_ui ? rg_use_transient(graph, data.ui_layer) : RG_NONE;
+
+    if (!data.split_passes || plan) {
+        RgUsage scene_read = data.use_compute ? RG_COMPUTE_READ : RG_FRAGMENT_READ;
+        RgUsage scene_read_write = data.use_compute ? RG_COMPUTE_READ_WRITE : RG_FRAGMENT_READ_WRITE;
+        uint32_t scene = rg_add_pass(graph, "scene", GPU_SCOPE_SCENE, [&init, &data](VkCommandBuffer cmd) {
+            if (data.use_compute) {
+                record_compute_scene(init, data, cmd);
+            } else {
+                record_fragment_scene(init, data, cmd);
+            }
+        });
+        rg_use(graph, scene, tile_lists, scene_read);
+        rg_use(graph, scene, scene_buffer, scene_read);
+        rg_use(graph, scene, light_buffer, scene_read);
+        rg_use(graph, scene, brick_indirection, scene_read);
+        rg_use(graph, scene, brick_atlas, scene_read);
+        // declared even with the pre-pass off so the bound image is always in GENERAL
+        rg_use(graph, scene, coarse_depth, scene_read);
+        rg_use(graph, scene, history[0], scene_read_write);
+        rg_use(graph, scene, history[1], scene_read_write);
+        rg_use(graph, scene, step_counters, scene_read_write);
+        if (data.use_compute) {
+            rg_use(graph, scene, scene_target, RG_COMPUTE_READ_WRITE);
+        } else {
+            rg_color_attachment(graph, scene, scene_target, VK_ATTACHMENT_LOAD_OP_DONT_CARE, data.render_extent);
+        }
+    }
+
+    // declared after the single scene pass so a plan build keeps both paths alive
+    if (data.split_passes || plan) {
+        uint32_t gbuffer = rg_add_pass(graph, "gbuffer", GPU_SCOPE_GBUFFER, [&init, &data](VkCommandBuffer cmd) {
+            record_split_pass(init, data, cmd, data.pipelines.gbuffer[data.quality_tier], data.render_extent);
+        });
+        rg_use(graph, gbuffer, tile_lists, RG_COMPUTE_READ);
+        rg_use(graph, gbuffer, scene_buffer, RG_COMPUTE_READ);
+        rg_use(graph, gbuffer, brick_indirection, RG_COMPUTE_READ);
+        rg_use(graph, gbuffer, brick_atlas, RG_COMPUTE_READ);
+        rg_use(graph, gbuffer, coarse_depth, RG_COMPUTE_READ);
+        rg_use(graph, gbuffer, step_counters, RG_COMPUTE_READ_WRITE);
+        rg_use(graph, gbuffer, gbuffer_normal_depth, RG_COMPUTE_READ_WRITE);
+        rg_use(graph, gbuffer, gbuffer_material, RG_COMPUTE_READ_WRITE);
+        // the step heatmap goes straight to the target
+        rg_use(graph, gbuffer, scene_target, RG_COMPUTE_READ_WRITE);
+
+        uint32_t lighting = rg_add_pass(graph, "lighting", GPU_SCOPE_LIGHTING, [&init, &data](VkCommandBuffer cmd) {
+            record_split_pass(init, data, cmd, data.pipelines.lighting[data.quality_tier], lighting_extent(data));
+        });
+        rg_use(graph, lighting, tile_lists, RG_COMPUTE_READ);
+        rg_use(graph, lighting, scene_buffer, RG_COMPUTE_READ);
+        rg_use(graph, lighting, light_buffer, RG_COMPUTE_READ);
+        rg_use(graph, lighting, brick_indirection, RG_COMPUTE_READ);
+        rg_use(graph, lighting, brick_atlas, RG_COMPUTE_READ);
+        rg_use(graph, lighting, gbuffer_normal_depth, RG_COMPUTE_READ);
+        rg_use(graph, lighting, shadow_ao, RG_COMPUTE_READ_WRITE);
+        graph.passes[lighting].async = true;
+
+        // the graphics queue draws the UI while the compute queue lights the frame
+        if (ui_layer != RG_NONE) {
+            uint32_t overlay = rg_add_pass(graph, "overlay", GPU_SCOPE_OVERLAY,
+                [&init, &data](VkCommandBuffer cmd) {
+                    VkCommandBuffer overlay_cmd = finish_overlay_recording(data);
+                    init.disp.cmdExecuteCommands(cmd, 1, &overlay_cmd);
+                });
+            rg_color_attachment(graph, overlay, ui_layer, VK_ATTACHMENT_LOAD_OP_CLEAR, init.output_extent);
+            graph.passes[overlay].secondary = true;
+        }
+
+        uint32_t composite = rg_add_pass(graph, "composite", GPU_SCOPE_COMPOSITE, [&init, &data](VkCommandBuffer cmd) {
+            record_split_pass(init, data, cmd, data.pipelines.composite[data.quality_tier], data.render_extent);
+        });
+        rg_use(graph, composite, scene_buffer, RG_COMPUTE_READ);
+        rg_use(graph, composite, light_buffer, RG_COMPUTE_READ);
+        rg_use(graph, composite, gbuffer_normal_depth, RG_COMPUTE_READ);
+        rg_use(graph, composite, gbuffer_material, RG_COMPUTE_READ);
+        rg_use(graph, composite, shadow_ao, RG_COMPUTE_READ);
+        rg_use(graph, composite, scene_target, RG_COMPUTE_READ_WRITE);
+
+        if (data.checkerboard || plan) {
+            RgHandle checker_history[2];
+            for (uint32_t i = 0; i < 2; i++) {
+                const AllocatedImage& image = data.checker_history[i];
+                checker_history[i] = rg_import_image(graph, "checker_history", image.image, image.view, image.format,
+                    image.extent, nullptr);
+                rg_retain(graph, checker_history[i]);
+            }
+            uint32_t reconstruct = rg_add_pass(graph, "reconstruct", GPU_SCOPE_RECONSTRUCT,
+                [&init, &data](VkCommandBuffer cmd) {
+                    record_split_pass(init, data, cmd, data.pipelines.reconstruct[data.quality_tier],
+                        data.render_extent);
+                });
+            rg_use(graph, reconstruct, gbuffer_normal_depth, RG_COMPUTE_READ);
+            rg_use(graph, reconstruct, checker_history[0], RG_COMPUTE_READ_WRITE);
+            rg_use(graph, reconstruct, checker_history[1], RG_COMPUTE_READ_WRITE);
+            rg_use(graph, reconstruct, scene_target, RG_COMPUTE_READ_WRITE);
+        }
+    }
+
+    uint32_t upscale = rg_add_pass(graph, "upscale", GPU_SCOPE_UPSCALE,
+        [&init, &data, image_index](VkCommandBuffer cmd) { record_upscale(init, data, cmd, image_index); });
+    rg_use(graph, upscale, scene_target, RG_TRANSFER_SRC);
+    rg_use(graph, upscale, output, RG_TRANSFER_DST);
+
+    if (!init.headless) {
+        if (ui_layer != RG_NONE) {
+            uint32_t blend = rg_add_pass(graph, "ui_blend", GPU_SCOPE_COUNT, [&init, &data](VkCommandBuffer cmd) {
+                init.disp.cmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, data.pipelines.ui_blend);
+                init.disp.cmdDraw(cmd, 4, 1, 0, 0);
+            });
+            rg_use(graph, blend, ui_layer, RG_FRAGMENT_READ);
+            rg_color_attachment(graph, blend, output, VK_ATTACHMENT_LOAD_OP_LOAD, init.output_extent);
+        } else if (data.show_ui) {
+            // recorded by the overlay worker since draw() started
+            uint32_t overlay = rg_add_pass(graph, "overlay", GPU_SCOPE_OVERLAY,
+                [&init, &data](VkCommandBuffer cmd) {
+                    VkCommandBuffer overlay_cmd = finish_overlay_recording(data);
+                    init.disp.cmdExecuteCommands(cmd, 1, &overlay_cmd);
+                });
+            rg_color_attachment(graph, overlay, output, VK_ATTACHMENT_LOAD_OP_LOAD, init.output_extent);
+            graph.passes[overlay].secondary = true;
+        }
+    } else {
+        // the host only reads the buffer once this frame has finished
+        uint32_t slot = data.readback_slot;
+        RgState readback_state = {};
+        RgHandle readback_buffer = rg_import_buffer(graph, "readback", data.readback_buffers[slot].buffer,
+            &readback_state);
+        rg_set_final(graph, readback_buffer, RG_HOST_READ);
+
+        uint32_t readback = rg_add_pass(graph, "readback", GPU_SCOPE_READBACK,
+            [&init, &data, image_index, slot](VkCommandBuffer cmd) {
+                record_readback(init, data, cmd, image_index, slot);
+            });
+        rg_use(graph, readback, output, RG_TRANSFER_SRC);
+        rg_use(graph, readback, readback_buffer, RG_TRANSFER_DST);
+    }
+}
+
+// Transients sized to the output: the scene target (marched at render_extent into
+// its top-left corner), the coarse depth written by the pre-pass and the images of
+// the split passes. Their memory is planned from a frame with every optional pass
+// declared; each takes a slot in the bindless table once realized.
+int create_transient_images(Init& init, RenderData& data) {
+    RenderGraph& graph = data.graph;
+    if (!graph.transients.empty()) {
+        RgRetired retired = rg_detach_transients(graph);
+        defer_destroy(data, [&init, retired]() mutable { rg_destroy_retired(init.disp, init.allocator, retired); });
+    }
+    data.scene_target = rg_add_transient(graph, "scene_target", init.output_extent, SCENE_FORMAT,
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+    VkExtent2D depth_extent = {
+        (init.output_extent.width + PREPASS_BLOCK_SIZE - 1) / PREPASS_BLOCK_SIZE,
+        (init.output_extent.height + PREPASS_BLOCK_SIZE - 1) / PREPASS_BLOCK_SIZE
+    };
+    data.coarse_depth = rg_add_transient(graph, "coarse_depth", depth_extent, VK_FORMAT_R32_SFLOAT,
+        VK_IMAGE_USAGE_STORAGE_BIT);
+    // the shadow/AO samples are allocated for lighting_scale 1 so the scale can
+    // change without recreating them
+    data.gbuffer_normal_depth = rg_add_transient(graph, "gbuffer_normal_depth", init.output_extent,
+        VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT);
+    data.gbuffer_material = rg_add_transient(graph, "gbuffer_material", init.output_extent, VK_FORMAT_R32_UINT,
+        VK_IMAGE_USAGE_STORAGE_BIT);
+    data.shadow_ao = rg_add_transient(graph, "shadow_ao", init.output_extent, VK_FORMAT_R16G16B16A16_SFLOAT,
+        VK_IMAGE_USAGE_STORAGE_BIT);
+    if (!init.headless) {
+        data.ui_layer = rg_add_transient(graph, "ui_layer", init.output_extent, init.output_format,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+    }
+
+    build_frame_graph(init, data, 0, true);
+    rg_compile(graph, true);
+    if (0 != rg_realize(init.disp, init.allocator, graph)) return -1;
+
+    BindlessIndices& indices = data.bindless_indices;
+    const uint32_t storage_images[5] = { data.coarse_depth, data.gbuffer_normal_depth, data.gbuffer_material,
+        data.shadow_ao, data.scene_target };
+    uint32_t* storage_indices[5] = { &indices.coarse_depth, &indices.gbuffer_normal_depth, &indices.gbuffer_material,
+        &indices.shadow_ao, &indices.scene_target };
+    for (uint32_t i = 0; i < 5; i++) {
+        if (0 != bindless_store_image(init, data, BINDLESS_STORAGE_IMAGE, graph.transients[storage_images[i]].view,
+                VK_IMAGE_LAYOUT_GENERAL, *storage_indices[i])) {
+            return -1;
+        }
+    }
+    // the ImGui layer, read where the blend pass leaves it
+    if (init.headless) return 0;
+    return bindless_store_image(init, data, BINDLESS_SAMPLED_IMAGE, graph.transients[data.ui_layer].view,
+        rg_access(RG_FRAGMENT_READ).layout, indices.ui_layer);
+}
+
+// Scene set pointing at the resources that live as long as the scene; written
+// once, after create_brick_map.
+int create_scene_descriptor_set(Init& init, RenderData& data) {
+    VkDescriptorSetAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = init.descriptor_pool;
+    alloc_info.descriptorSetCount = 1;
+    alloc_info.pSetLayouts = &data.scene_set_layout;
+    if (init.disp.allocateDescriptorSets(&alloc_info, &data.scene_set) != VK_SUCCESS) {
+        std::cout << "failed to allocate scene descriptor set\n";
+        return -1;
+    }
+
+    VkDescriptorBufferInfo buffer_infos[3] = {};
+    buffer_infos[0].buffer = data.scene_buffer.buffer;
+    buffer_infos[0].range = VK_WHOLE_SIZE;
+    buffer_infos[1].buffer = data.step_counters.buffer;
+    buffer_infos[1].range = VK_WHOLE_SIZE;
+    buffer_infos[2].buffer = data.light_buffer.buffer;
+    buffer_infos[2].range = VK_WHOLE_SIZE;
+
+    VkDescriptorImageInfo image_infos[2] = {};
+    image_infos[0].imageView = data.brick_map.indirection.view;
+    image_infos[1].imageView = data.brick_map.atlas.view;
+    image_infos[1].sampler = data.brick_map.sampler;
+    for (auto& info : image_infos) info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    // FrameConstants, moved with a dynamic offset every frame
+    VkDescriptorBufferInfo uniform_info = {};
+    uniform_info.buffer = data.frame_uniforms.buffer.buffer;
+    uniform_info.range = sizeof(FrameConstants);
+
+    const uint32_t numbers[6] = { 0, 3, 6, 7, 8, 9 };
+    const VkDescriptorType types[6] = {
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC
+    };
+    const VkDescriptorBufferInfo* binding_buffers[6] = { &buffer_infos[0], &buffer_infos[1], nullptr, nullptr,
+        &buffer_infos[2], &uniform_info };
+    const VkDescriptorImageInfo* binding_images[6] = { nullptr, nullptr, &image_infos[0], &image_infos[1], nullptr,
+        nullptr };
+    VkWriteDescriptorSet writes[6] = {};
+    for (uint32_t i = 0; i < 6; i++) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = data.scene_set;
+        writes[i].dstBinding = numbers[i];
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = types[i];
+        writes[i].pBufferInfo = binding_buffers[i];
+        writes[i].pImageInfo = binding_images[i];
+    }
+    init.disp.updateDescriptorSets(6, writes, 0, nullptr);
+    return 0;
+}
+
+// Everything sized to the output extent; recreated with the swapchain.
+int create_screen_resources(Init& init, RenderData& data) {
+    if (0 != create_tile_lists(init, data)) return -1;
+    if (0 != create_history_images(init, data)) return -1;
+    if (0 != create_transient_images(init, data)) return -1;
+    return 0;
+}
+
+// Render extent for the current scale, kept even and never below a cull tile.
+VkExtent2D scaled_extent(VkExtent2D extent, float scale) {
+    uint32_t width = static_cast<uint32_t>(extent.width * scale) & ~1u;
+    uint32_t height = static_cast<uint32_t>(extent.height * scale) & ~1u;
+    width = std::min(std::max(width, CULL_TILE_SIZE), extent.width);
+    height = std::min(std::max(height, CULL_TILE_SIZE), extent.height);
+    return { width, height };
+}
+
+int create_profiler(Init& init, RenderData& data, const std::string& csv_path) {
+    Profiler& profiler = data.profiler;
+    uint32_t family = init.device.get_queue_index(vkb::QueueType::graphics).value();
+    profiler.gpu_timestamps = init.device.queue_families[family].timestampValidBits > 0;
+    profiler.timestamp_period = init.device.physical_device.properties.limits.timestampPeriod;
+    if (!profiler.gpu_timestamps) {
+        std::cout << "graphics queue has no timestamp support, GPU timings disabled\n";
+    }
+
+    profiler.query_pools.assign(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+    profiler.written_scopes.assign(MAX_FRAMES_IN_FLIGHT, 0);
+    profiler.slot_frame.assign(MAX_FRAMES_IN_FLIGHT, 0);
+    profiler.slot_extent.assign(MAX_FRAMES_IN_FLIGHT, VkExtent2D{});
+    profiler.slot_cpu_ms.assign(MAX_FRAMES_IN_FLIGHT, std::vector<float>(CPU_SCOPE_COUNT, 0.0f));
+    for (auto& samples : profiler.history) samples.assign(PROFILER_HISTORY, 0.0f);
+
+    if (profiler.gpu_timestamps) {
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            VkQueryPoolCreateInfo pool_info = {};
+            pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            pool_info.queryCount = 2 * GPU_SCOPE_COUNT;
+
+            if (init.disp.createQueryPool(&pool_info, nullptr, &profiler.query_pools[i]) != VK_SUCCESS) {
+                std::cout << "failed to create timestamp query pool\n";
+                return -1;
+            }
+        }
+    }
+
+    if (!csv_path.empty()) {
+        profiler.csv.open(csv_path);
+        if (!profiler.csv.is_open()) {
+            std::cout << "failed to open " << csv_path << " for writing\n";
+            return -1;
+        }
+        profiler.csv << "frame,render_width,render_height";
+        for (uint32_t i = 0; i < GPU_SCOPE_COUNT; i++) profiler.csv << ",gpu_" << GPU_SCOPE_NAMES[i] << "_ms";
+        for (uint32_t i = 0; i < CPU_SCOPE_COUNT; i++) profiler.csv << ",cpu_" << CPU_SCOPE_NAMES[i] << "_ms";
+        profiler.csv << "\n";
+    }
+    return 0;
+}
+
+void destroy_profiler(Init& init, RenderData& data) {
+    for (auto pool : data.profiler.query_pools) {
+        init.disp.destroyQueryPool(pool, nullptr);
+    }
+    data.profiler.query_pools.clear();
+}
+
+// Adds the wall time of its lifetime to elapsed_ms.
+struct CpuScopeTimer {
+    float& elapsed_ms;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    explicit CpuScopeTimer(float& elapsed_ms) : elapsed_ms(elapsed_ms) {}
+    ~CpuScopeTimer() {
+        std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        elapsed_ms += elapsed.count();
+    }
+};
+
+// CPU timing of the frame being built in the current slot.
+float& cpu_scope(RenderData& data, CpuScope scope) {
+    return data.profiler.slot_cpu_ms[data.current_frame][scope];
+}
+
+void gpu_scope_begin(Init& init, RenderData& data, VkCommandBuffer cmd, GpuScope scope) {
+    Profiler& profiler = data.profiler;
+    if (!profiler.gpu_timestamps) return;
+    init.disp.cmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        profiler.query_pools[data.current_frame], 2 * scope);
+}
+
+void gpu_scope_end(Init& init, RenderData& data, VkCommandBuffer cmd, GpuScope scope) {
+    Profiler& profiler = data.profiler;
+    if (!profiler.gpu_timestamps) return;
+    init.disp.cmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        profiler.query_pools[data.current_frame], 2 * scope + 1);
+    profiler.written_scopes[data.current_frame] |= 1u << scope;
+}
+
+// Collects the timings of the frame that last used this slot; only valid once
+// that frame has finished. Afterwards the slot is ready for the next frame.
+void collect_profiler(Init& init, RenderData& data) {
+    Profiler& profiler = data.profiler;
+    size_t slot = data.current_frame;
+    std::vector<float>& cpu_ms = profiler.slot_cpu_ms[slot];
+
+    // slot_frame is cleared below, so a frame abandoned after the frame wait
+    // (swapchain recreation) doesn't report this slot twice
+    if (profiler.slot_frame[slot] > 0) {
+        float gpu_ms[GPU_SCOPE_COUNT] = {};
+        uint32_t written = profiler.written_scopes[slot];
+        if (written != 0) {
+            // value + availability per query, so unwritten scopes don't fail the whole read
+            uint64_t results[2 * GPU_SCOPE_COUNT][2] = {};
+            init.disp.getQueryPoolResults(profiler.query_pools[slot], 0, 2 * GPU_SCOPE_COUNT, sizeof(results),
+                results, sizeof(results[0]), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+            for (uint32_t i = 0; i < GPU_SCOPE_COUNT; i++) {
+                if (!(written & (1u << i)) || !results[2 * i][1] || !results[2 * i + 1][1]) continue;
+                uint64_t ticks = results[2 * i + 1][0] - results[2 * i][0];
+                gpu_ms[i] = static_cast<float>(ticks * profiler.timestamp_period * 1e-6);
+            }
+        }
+
+        profiler.frame = profiler.slot_frame[slot];
+        profiler.gpu_total_ms = 0.0f;
+        profiler.cpu_total_ms = 0.0f;
+        for (uint32_t i = 0; i < GPU_SCOPE_COUNT; i++) {
+            profiler.gpu_ms[i] = gpu_ms[i];
+            profiler.gpu_total_ms += gpu_ms[i];
+            profiler.history[i][profiler.history_head] = gpu_ms[i];
+        }
+        for (uint32_t i = 0; i < CPU_SCOPE_COUNT; i++) {
+            profiler.cpu_ms[i] = cpu_ms[i];
+            if (i != CPU_SCOPE_FRAME_WAIT) profiler.cpu_total_ms += cpu_ms[i];
+            profiler.history[GPU_SCOPE_COUNT + i][profiler.history_head] = cpu_ms[i];
+        }
+        profiler.history[GPU_SCOPE_COUNT + CPU_SCOPE_COUNT][profiler.history_head] = profiler.gpu_total_ms;
+        profiler.history[GPU_SCOPE_COUNT + CPU_SCOPE_COUNT + 1][profiler.history_head] = profiler.cpu_total_ms;
+        profiler.history_head = (profiler.history_head + 1) % PROFILER_HISTORY;
+
+        if (profiler.csv.is_open()) {
+            VkExtent2D extent = profiler.slot_extent[slot];
+            profiler.csv << profiler.frame << "," << extent.width << "," << extent.height;
+            for (uint32_t i = 0; i < GPU_SCOPE_COUNT; i++) profiler.csv << "," << gpu_ms[i];
+            for (uint32_t i = 0; i < CPU_SCOPE_COUNT; i++) profiler.csv << "," << cpu_ms[i];
+            profiler.csv << "\n";
+        }
+    }
+
+    profiler.slot_frame[slot] = 0;
+    profiler.written_scopes[slot] = 0;
+    std::fill(cpu_ms.begin(), cpu_ms.end(), 0.0f);
+}
+
+// Moves the render scale towards the frame time budget using the scene work
+// of the last collected frame.
+void update_render_scale(RenderData& data) {
+    const Profiler& profiler = data.profiler;
+    data.gpu_scene_ms = profiler.gpu_ms[GPU_SCOPE_CULL] + profiler.gpu_ms[GPU_SCOPE_PREPASS] +
+        profiler.gpu_ms[GPU_SCOPE_SCENE] + profiler.gpu_ms[GPU_SCOPE_GBUFFER] + profiler.gpu_ms[GPU_SCOPE_LIGHTING] +
+        profiler.gpu_ms[GPU_SCOPE_COMPOSITE] + profiler.gpu_ms[GPU_SCOPE_RECONSTRUCT];
+
+    if (!data.dynamic_resolution || data.gpu_scene_ms <= 0.0f) return;
+
+    // scene cost is proportional to the pixel count, i.e. to scale squared
+    float desired = data.render_scale * std::sqrt(data.target_frame_ms / data.gpu_scene_ms);
+    desired = std::min(std::max(desired, data.min_render_scale), 1.0f);
+    // damped, and ignore tiny corrections so the resolution doesn't flicker
+    if (std::fabs(desired - data.render_scale) > 0.02f) {
+        data.render_scale += 0.25f * (desired - data.render_scale);
+    }
+}
+
+// Steps the quality tier when the GPU scene time stays off budget. With dynamic
+// resolution on, the scale adapts first and the tier only moves once the scale
+// is pinned at one of its limits.
+void update_quality_tier(RenderData& data) {
+    data.quality_frames++;
+    if (!data.auto_quality || data.gpu_scene_ms <= 0.0f) return;
+
+    // > 0 when over budget, < 0 with headroom; smoothed over ~30 frames
+    float pressure = data.gpu_scene_ms / data.target_frame_ms - 1.0f;
+    data.quality_pressure += (pressure - data.quality_pressure) / 30.0f;
+
+    // let the previous change show up in the timings first
+    if (data.quality_frames < 60) return;
+
+    bool scale_at_min = !data.dynamic_resolution || data.render_scale <= data.min_render_scale + 0.01f;
+    bool scale_at_max = !data.dynamic_resolution || data.render_scale >= 0.99f;
+    if (data.quality_pressure > 0.1f && scale_at_min && data.quality_tier > QUALITY_LOW) {
+        data.quality_tier = (QualityTier)(data.quality_tier - 1);
+    } else if (data.quality_pressure < -0.4f && scale_at_max && data.quality_tier < QUALITY_ULTRA) {
+        // each tier costs roughly 1.5x the one below, so only step up with that much headroom
+        data.quality_tier = (QualityTier)(data.quality_tier + 1);
+    } else {
+        return;
+    }
+    data.quality_frames = 0;
+    data.quality_pressure = 0.0f;
+}
+
+void draw(Init& init, RenderData& data, uint32_t image_index)
+{
+    VkCommandBuffer cmd = data.command_buffers[data.current_frame];
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+    if (init.disp.beginCommandBuffer(cmd, &begin_info) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording command buffer!");
+    }
+
+    // widgets first, so their edits apply to the graph built below; the worker
+    // records their draw data while this thread records the rest of the frame
+    if (!init.headless && data.show_ui) {
+        build_imgui_frame(init, data);
+        begin_overlay_recording(data);
+    }
+
+    data.render_extent = scaled_extent(init.output_extent, data.render_scale);
+    if (data.previous_render_extent.width == 0) data.previous_render_extent = data.render_extent;
+
+    if (data.profiler.gpu_timestamps) {
+        init.disp.cmdResetQueryPool(cmd, data.profiler.query_pools[data.current_frame], 0, 2 * GPU_SCOPE_COUNT);
+    }
+    data.slot_frame_number[data.current_frame] = ++data.frame_number;
+    data.profiler.slot_frame[data.current_frame] = data.frame_number;
+    data.profiler.slot_extent[data.current_frame] = data.render_extent;
+
+    update_camera(data);
+    stream_scene(init, data);
+    // edits from the UI, uploaded by this frame's graph
+    if (0 != apply_scene_edits(init, data)) {
+        throw std::runtime_error("failed to rebake the brick map");
+    }
+    // written once, bound by every pass of the frame
+    frame_uniforms_begin(data.frame_uniforms, data.current_frame);
+    FrameConstants constants = frame_constants(init, data);
+    data.frame_constants_offset = frame_uniforms_push(init, data.frame_uniforms, &constants, sizeof(constants));
+    data.graph.async = data.async_compute && data.compute_queue != VK_NULL_HANDLE;
+    build_frame_graph(init, data, image_index, false);
+    rg_compile(data.graph, false);
+    rg_execute(init, data, cmd);
+
+    if (init.disp.endCommandBuffer(cmd) != VK_SUCCESS) {
+        std::cout << "failed to record command buffer\n";
+        throw std::runtime_error("failed to record command buffer");
+    }
+    data.frame_index++;
+    data.previous_render_extent = data.render_extent;
+    // history is only written while temporal accumulation is on
+    // the split passes leave the history untouched
+    data.history_frames = data.temporal && !data.split_passes ? data.history_frames + 1 : 0;
+    data.checker_frames = data.checkerboard && data.split_passes ? data.checker_frames + 1 : 0;
+}
+
+int create_command_buffers(Init& init, RenderData& data) {
+    data.command_buffers.resize(MAX_FRAMES_IN_FLIGHT);
+
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = data.command_pool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = (uint32_t)data.command_buffers.size();
+
+    if (init.disp.allocateCommandBuffers(&allocInfo, data.command_buffers.data()) != VK_SUCCESS) {
+        return -1; // failed to allocate command buffers;
+    }
+
+    return 0;
+}
+
+int create_sync_objects(Init& init, RenderData& data) {
+    data.slot_frame_number.assign(MAX_FRAMES_IN_FLIGHT, 0);
+    data.available_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
+    data.finished_semaphore.resize(MAX_FRAMES_IN_FLIGHT);
+
+    VkSemaphoreTypeCreateInfo timeline_info = {};
+    timeline_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timeline_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timeline_info.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphore_info = {};
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    semaphore_info.pNext = &timeline_info;
+    if (init.disp.createSemaphore(&semaphore_info, nullptr, &data.frame_timeline) != VK_SUCCESS) {
+        std::cout << "failed to create frame timeline semaphore\n";
+        return -1;
+    }
+    for (uint32_t q = 0; q < RG_QUEUE_COUNT; q++) {
+        if (init.disp.createSemaphore(&semaphore_info, nullptr, &data.queue_timelines[q]) != VK_SUCCESS) {
+            std::cout << "failed to create queue timeline semaphore\n";
+            return -1;
+        }
+    }
+    semaphore_info.pNext = nullptr;
+
+    // acquire and present only take binary semaphores
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        if (init.disp.createSemaphore(&semaphore_info, nullptr, &data.available_semaphores[i]) != VK_SUCCESS ||
+            init.disp.createSemaphore(&semaphore_info, nullptr, &data.finished_semaphore[i]) != VK_SUCCESS) {
+            std::cout << "failed to create sync objects\n";
+            return -1; // failed to create synchronization objects for a frame
+        }
+    }
+    return 0;
+}
+
+// Builds the new swapchain from the retired one while earlier frames are still in
+// flight. The old swapchain, its views and framebuffers go through the deferred
+// queue; screen resources are only rebuilt when the size actually changed.
+int recreate_swapchain(Init& init, RenderData& data) {
+    VkExtent2D old_extent = init.output_extent;
+    vkb::Swapchain old_swapchain = init.swapchain;
+    std::vector<VkImageView> old_views = data.swapchain_image_views;
+    init.present_mode = data.present_mode;
+    {
+        // the retired swapchain is used by the build, keep the latency worker off it
+        std::unique_lock<std::mutex> lock;
+        if (data.latency) lock = std::unique_lock<std::mutex>(data.latency->present_mutex);
+        if (0 != create_swapchain(init)) return -1;
+    }
+    data.present_mode = init.present_mode;
+
+    RgRetired framebuffers = rg_detach_framebuffers(data.graph);
+    defer_destroy(data, [&init, &data, old_swapchain, old_views, framebuffers]() mutable {
+        release_latency_swapchain(data, old_swapchain.swapchain);
+        rg_destroy_retired(init.disp, init.allocator, framebuffers);
+        old_swapchain.destroy_image_views(old_views);
+        vkb::destroy_swapchain(old_swapchain);
+    });
+
+    if (0 != create_output_images(init, data)) return -1;
+    if (old_extent.width != init.output_extent.width || old_extent.height != init.output_extent.height) {
+        if (0 != create_screen_resources(init, data)) return -1;
+    }
+    return 0;
+}
+
+// Reads and resets the step counters of the frame that last used this slot;
+// only valid once that frame has finished.
+void collect_step_stats(Init& init, RenderData& data) {
+    if (!data.step_stats) return;
+    vmaInvalidateAllocation(init.allocator, data.step_counters.allocation, 0, VK_WHOLE_SIZE);
+    auto* counters = static_cast<uint32_t*>(data.step_counters.mapped) + data.current_frame * 2;
+    if (counters[1] > 0) {
+        data.average_steps = static_cast<float>(counters[0]) / static_cast<float>(counters[1]);
+    }
+    counters[0] = 0;
+    counters[1] = 0;
+    vmaFlushAllocation(init.allocator, data.step_counters.allocation, 0, VK_WHOLE_SIZE);
+}
+
+// Submits the recorded frame batch by batch. A batch waits for the one of the
+// other queue it depends on through that queue's timeline, the batch first
+// touching the swapchain image also for `acquired`; the last batch signals
+// frame_timeline with the frame number and `finished` for present. The
+// semaphores are null when headless.
+int submit_frame(Init& init, RenderData& data, VkSemaphore acquired, VkSemaphore finished) {
+    std::vector<RgBatch>& batches = data.graph.batches;
+    for (size_t b = 0; b < batches.size(); b++) {
+        RgBatch& batch = batches[b];
+        bool last = b + 1 == batches.size();
+
+        VkSemaphore wait_semaphores[2];
+        uint64_t wait_values[2];
+        VkPipelineStageFlags wait_stages[2];
+        uint32_t wait_count = 0;
+        if (batch.wait != UINT32_MAX) {
+            const RgBatch& waited = batches[batch.wait];
+            wait_semaphores[wait_count] = data.queue_timelines[waited.queue];
+            wait_values[wait_count] = waited.signal_value;
+            wait_stages[wait_count++] = batch.wait_stages;
+        }
+        if (acquired != VK_NULL_HANDLE && b == data.graph.present_batch) {
+            wait_semaphores[wait_count] = acquired;
+            wait_values[wait_count] = 0;
+            wait_stages[wait_count++] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        }
+
+        VkSemaphore signal_semaphores[2];
+        uint64_t signal_values[2];
+        uint32_t signal_count = 0;
+        if (last) {
+            signal_semaphores[signal_count] = data.frame_timeline;
+            signal_values[signal_count++] = data.frame_number;
+            if (finished != VK_NULL_HANDLE) {
+                signal_semaphores[signal_count] = finished;
+                signal_values[signal_count++] = 0;
+            }
+        } else {
+            batch.signal_value = ++data.queue_timeline_values[batch.queue];
+            signal_semaphores[signal_count] = data.queue_timelines[batch.queue];
+            signal_values[signal_count++] = batch.signal_value;
+        }
+
+        VkTimelineSemaphoreSubmitInfo timeline_submit = {};
+        timeline_submit.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timeline_submit.waitSemaphoreValueCount = wait_count;
+        timeline_submit.pWaitSemaphoreValues = wait_values;
+        timeline_submit.signalSemaphoreValueCount = signal_count;
+        timeline_submit.pSignalSemaphoreValues = signal_values;
+
+        VkSubmitInfo submit_info = {};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.pNext = &timeline_submit;
+        submit_info.waitSemaphoreCount = wait_count;
+        submit_info.pWaitSemaphores = wait_semaphores;
+        submit_info.pWaitDstStageMask = wait_stages;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &batch.cmd;
+        submit_info.signalSemaphoreCount = signal_count;
+        submit_info.pSignalSemaphores = signal_semaphores;
+
+        VkQueue queue = batch.queue == RG_QUEUE_COMPUTE ? data.compute_queue : data.graphics_queue;
+        if (init.disp.queueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+            std::cout << "failed to submit draw command buffer\n";
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int draw_frame(Init& init, RenderData& data) {
+    if (data.current_frame >= data.frames_in_flight) data.current_frame = 0;
+    float frame_wait_ms = 0.0f;
+    {
+        CpuScopeTimer timer(frame_wait_ms);
+        wait_for_frame_slot(init, data);
+    }
+    update_completed_frames(init, data);
+    flush_deferred_destroys(data, false);
+    collect_step_stats(init, data);
+    collect_profiler(init, data);
+    update_render_scale(data);
+    update_quality_tier(data);
+    update_shader_reloader(init, data);
+    cpu_scope(data, CPU_SCOPE_FRAME_WAIT) = frame_wait_ms;
+
+    if (data.present_mode != init.present_mode) {
+        return recreate_swapchain(init, data);
+    }
+
+    uint32_t image_index = 0;
+    VkResult result;
+    {
+        CpuScopeTimer timer(cpu_scope(data, CPU_SCOPE_ACQUIRE));
+        result = init.disp.acquireNextImageKHR(
+            init.swapchain, UINT64_MAX, data.available_semaphores[data.current_frame], VK_NULL_HANDLE, &image_index);
+    }
+
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        return recreate_swapchain(init, data);
+    } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+        std::cout << "failed to acquire swapchain image. Error " << result << "\n";
+        return -1;
+    }
+
+    {
+        CpuScopeTimer timer(cpu_scope(data, CPU_SCOPE_RECORD));
+        draw(init, data, image_index);
+    }
+
+    {
+        CpuScopeTimer timer(cpu_scope(data, CPU_SCOPE_SUBMIT));
+        if (0 != submit_frame(init, data, data.available_semaphores[data.current_frame],
+                data.finished_semaphore[data.current_frame])) {
+            return -1;
+        }
+    }
+    track_latency(data, init.present_wait ? init.swapchain.swapchain : VK_NULL_HANDLE);
+
+    VkPresentInfoKHR present_info = {};
+    present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+
+    present_info.waitSemaphoreCount = 1;
+    present_info.pWaitSemaphores = &data.finished_semaphore[data.current_frame];
+
+    VkSwapchainKHR swapChains[] = { init.swapchain };
+    present_info.swapchainCount = 1;
+    present_info.pSwapchains = swapChains;
+
+    present_info.pImageIndices = &image_index;
+
+    // the frame number doubles as the present id the latency worker waits for
+    VkPresentIdKHR present_id = {};
+    present_id.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+    present_id.swapchainCount = 1;
+    present_id.pPresentIds = &data.frame_number;
+    if (init.present_wait) present_info.pNext = &present_id;
+
+    {
+        CpuScopeTimer timer(cpu_scope(data, CPU_SCOPE_PRESENT));
+        std::unique_lock<std::mutex> lock;
+        if (data.latency) lock = std::unique_lock<std::mutex>(data.latency->present_mutex);
+        result = init.disp.queuePresentKHR(data.present_queue, &present_info);
+    }
+    // the frame is submitted either way, so move on to the next slot before any recreate
+    data.current_frame = (data.current_frame + 1) % data.frames_in_flight;
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+        return recreate_swapchain(init, data);
+    } else if (result != VK_SUCCESS) {
+        std::cout << "failed to present swapchain image\n";
+        return -1;
+    }
+    return 0;
+}
+
+int write_ppm(const std::string& path, const uint8_t* pixels, uint32_t width, uint32_t height, VkFormat format);
+int write_png(const std::string& path, const uint8_t* pixels, uint32_t width, uint32_t height, VkFormat format);
+
+// Waits for its frame, then writes each job's buffer to disk and hands it back.
+void encoder_worker(Init* init, RenderData* data) {
+    EncoderPool& pool = *data->encoders;
+    while (true) {
+        EncodeJob job;
+        {
+            std::unique_lock<std::mutex> lock(pool.mutex);
+            pool.work.wait(lock, [&]() { return pool.stop || !pool.jobs.empty(); });
+            if (pool.jobs.empty()) return;
+            job = pool.jobs.front();
+            pool.jobs.pop_front();
+        }
+
+        VkSemaphoreWaitInfo wait_info = {};
+        wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        wait_info.semaphoreCount = 1;
+        wait_info.pSemaphores = &data->frame_timeline;
+        wait_info.pValues = &job.frame;
+        init->disp.waitSemaphores(&wait_info, UINT64_MAX);
+
+        auto start = std::chrono::steady_clock::now();
+        AllocatedBuffer& buffer = data->readback_buffers[job.buffer];
+        vmaInvalidateAllocation(init->allocator, buffer.allocation, 0, VK_WHOLE_SIZE);
+        char number[16];
+        snprintf(number, sizeof(number), "_%05u.", job.sequence);
+        std::string path = pool.path + number + pool.format;
+        const uint8_t* pixels = static_cast<const uint8_t*>(buffer.mapped);
+        int res = pool.format == "png"
+            ? write_png(path, pixels, pool.extent.width, pool.extent.height, pool.pixel_format)
+            : write_ppm(path, pixels, pool.extent.width, pool.extent.height, pool.pixel_format);
+        if (res != 0) pool.failed = true;
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        {
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            pool.free_buffers.push_back(job.buffer);
+            pool.encode_ms += elapsed.count();
+            pool.encoded++;
+        }
+        pool.freed.notify_one();
+    }
+}
+
+void start_encoders(Init& init, RenderData& data, const Options& options) {
+    data.encoders = std::make_unique<EncoderPool>();
+    EncoderPool& pool = *data.encoders;
+    pool.path = options.sequence_path;
+    pool.format = options.sequence_format;
+    pool.extent = init.output_extent;
+    pool.pixel_format = init.output_format;
+    for (uint32_t i = 0; i < data.readback_buffers.size(); i++) pool.free_buffers.push_back(i);
+
+    uint32_t threads = options.encoder_threads;
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency() / 2);
+    for (uint32_t i = 0; i < threads; i++) {
+        pool.workers.emplace_back(encoder_worker, &init, &data);
+    }
+}
+
+// Blocks until an encoder has released a readback buffer.
+uint32_t acquire_readback_buffer(RenderData& data) {
+    EncoderPool& pool = *data.encoders;
+    std::unique_lock<std::mutex> lock(pool.mutex);
+    pool.freed.wait(lock, [&]() { return !pool.free_buffers.empty(); });
+    uint32_t buffer = pool.free_buffers.back();
+    pool.free_buffers.pop_back();
+    return buffer;
+}
+
+void queue_encode(RenderData& data, uint32_t buffer, uint64_t frame) {
+    EncoderPool& pool = *data.encoders;
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.jobs.push_back({ buffer, frame, pool.next_sequence++ });
+    }
+    pool.work.notify_one();
+}
+
+// Headless variant of draw_frame: no acquire/present, every frame in flight owns
+// its own color target and readback buffer so the GPU is never throttled by vsync.
+int draw_frame_headless(Init& init, RenderData& data) {
+    data.input_time = std::chrono::steady_clock::now();
+    float frame_wait_ms = 0.0f;
+    {
+        CpuScopeTimer timer(frame_wait_ms);
+        wait_for_frame_slot(init, data);
+    }
+    update_completed_frames(init, data);
+    flush_deferred_destroys(data, false);
+    collect_step_stats(init, data);
+    collect_profiler(init, data);
+    update_render_scale(data);
+    update_quality_tier(data);
+    update_shader_reloader(init, data);
+    cpu_scope(data, CPU_SCOPE_FRAME_WAIT) = frame_wait_ms;
+
+    uint32_t image_index = static_cast<uint32_t>(data.current_frame);
+    data.readback_slot = image_index;
+    if (data.encoders) {
+        float stall_ms = 0.0f;
+        {
+            CpuScopeTimer timer(stall_ms);
+            data.readback_slot = acquire_readback_buffer(data);
+        }
+        data.readback_stall_ms += stall_ms;
+        cpu_scope(data, CPU_SCOPE_FRAME_WAIT) += stall_ms;
+    }
+    {
+        CpuScopeTimer timer(cpu_scope(data, CPU_SCOPE_RECORD));
+        draw(init, data, image_index);
+    }
+
+    {
+        CpuScopeTimer timer(cpu_scope(data, CPU_SCOPE_SUBMIT));
+        if (0 != submit_frame(init, data, VK_NULL_HANDLE, VK_NULL_HANDLE)) return -1;
+    }
+    track_latency(data, VK_NULL_HANDLE);
+    if (data.encoders) queue_encode(data, data.readback_slot, data.frame_number);
+
+    data.current_frame = (data.current_frame + 1) % data.frames_in_flight;
+    return 0;
+}
+
+// Writes a BGRA8 or RGBA8 readback buffer as a binary PPM.
+int write_ppm(const std::string& path, const uint8_t* pixels, uint32_t width, uint32_t height, VkFormat format) {
+    bool bgra = format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "failed to open " << path << " for writing\n";
+        return -1;
+    }
+    file << "P6\n" << width << " " << height << "\n255\n";
+    std::vector<uint8_t> row(width * 3);
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t* src = pixels + (size_t)y * width * 4;
+        for (uint32_t x = 0; x < width; x++) {
+            row[x * 3 + 0] = src[x * 4 + (bgra ? 2 : 0)];
+            row[x * 3 + 1] = src[x * 4 + 1];
+            row[x * 3 + 2] = src[x * 4 + (bgra ? 0 : 2)];
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(row.size()));
+    }
+    if (!file) {
+        std::cout << "failed to write " << path << "\n";
+        return -1;
+    }
+    return 0;
+}
+
+// Minimal PNG writer: 8-bit RGB in stored (uncompressed) deflate blocks, so it
+// needs no zlib. Files are larger than compressed PNGs but encode at memcpy speed.
+uint32_t png_crc(const uint8_t* bytes, size_t size, uint32_t crc = 0xFFFFFFFFu) {
+    // built once; static initialization is thread-safe for the encoder pool
+    static const std::vector<uint32_t> table = []() {
+        std::vector<uint32_t> entries(256);
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) c = (c & 1u) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            entries[n] = c;
+        }
+        return entries;
+    }();
+    for (size_t i = 0; i < size; i++) crc = table[(crc ^ bytes[i]) & 0xFFu] ^ (crc >> 8);
+    return crc;
+}
+
+void png_chunk(std::ofstream& file, const char type[4], const std::vector<uint8_t>& payload) {
+    uint8_t header[8] = {
+        (uint8_t)(payload.size() >> 24), (uint8_t)(payload.size() >> 16), (uint8_t)(payload.size() >> 8),
+        (uint8_t)payload.size(), (uint8_t)type[0], (uint8_t)type[1], (uint8_t)type[2], (uint8_t)type[3]
+    };
+    uint32_t crc = png_crc(header + 4, 4);
+    crc = png_crc(payload.data(), payload.size(), crc) ^ 0xFFFFFFFFu;
+    uint8_t footer[4] = { (uint8_t)(crc >> 24), (uint8_t)(crc >> 16), (uint8_t)(crc >> 8), (uint8_t)crc };
+    file.write(reinterpret_cast<const char*>(header), 8);
+    file.write(reinterpret_cast<const char*>(payload.data()), static_cast<std::streamsize>(payload.size()));
+    file.write(reinterpret_cast<const char*>(footer), 4);
+}
+
+int write_png(const std::string& path, const uint8_t* pixels, uint32_t width, uint32_t height, VkFormat format) {
+    bool bgra = format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "failed to open " << path << " for writing\n";
+        return -1;
+    }
+
+    // scanlines with a leading "no filter" byte
+    std::vector<uint8_t> raw((size_t)(width * 3 + 1) * height);
+    for (uint32_t y = 0; y < height; y++) {
+        uint8_t* dst = raw.data() + (size_t)y * (width * 3 + 1);
+        const uint8_t* src = pixels + (size_t)y * width * 4;
+        dst[0] = 0;
+        for (uint32_t x = 0; x < width; x++) {
+            dst[1 + x * 3 + 0] = src[x * 4 + (bgra ? 2 : 0)];
+            dst[1 + x * 3 + 1] = src[x * 4 + 1];
+            dst[1 + x * 3 + 2] = src[x * 4 + (bgra ? 0 : 2)];
+        }
+    }
+
+    std::vector<uint8_t> zlib = { 0x78, 0x01 };
+    zlib.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    uint32_t a = 1;
+    uint32_t b = 0;
+    size_t offset = 0;
+    bool last = false;
+    while (!last) {
+        size_t size = std::min<size_t>(raw.size() - offset, 65535);
+        last = offset + size == raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back((uint8_t)size);
+        zlib.push_back((uint8_t)(size >> 8));
+        zlib.push_back((uint8_t)~size);
+        zlib.push_back((uint8_t)(~size >> 8));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + size);
+        for (size_t i = offset; i < offset + size; i++) {
+            a = (a + raw[i]) % 65521;
+            b = (b + a) % 65521;
+        }
+        offset += size;
+    }
+    uint32_t adler = (b << 16) | a;
+    zlib.insert(zlib.end(), { (uint8_t)(adler >> 24), (uint8_t)(adler >> 16), (uint8_t)(adler >> 8), (uint8_t)adler });
+
+    const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    file.write(reinterpret_cast<const char*>(signature), 8);
+    std::vector<uint8_t> ihdr = {
+        (uint8_t)(width >> 24), (uint8_t)(width >> 16), (uint8_t)(width >> 8), (uint8_t)width,
+        (uint8_t)(height >> 24), (uint8_t)(height >> 16), (uint8_t)(height >> 8), (uint8_t)height,
+        8, 2, 0, 0, 0 // 8-bit, truecolor, deflate, adaptive filtering, no interlace
+    };
+    png_chunk(file, "IHDR", ihdr);
+    png_chunk(file, "IDAT", zlib);
+    png_chunk(file, "IEND", {});
+    return file.good() ? 0 : -1;
+}
+
+// --sequence: every frame goes through the readback ring to the encoder pool.
+// The render thread only waits when all readback_ring buffers are still queued
+// or being encoded; that stall is reported so disk-bound runs are obvious.
+int run_sequence(Init& init, RenderData& data, const Options& options) {
+    start_encoders(init, data, options);
+    std::cout << "writing " << options.frame_count << " frames to " << options.sequence_path << "_*."
+              << options.sequence_format << " with " << data.encoders->workers.size() << " encoder threads and "
+              << data.readback_buffers.size() << " readback buffers\n";
+
+    double gpu_busy_ms = 0.0;
+    uint64_t profiled_frame = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < options.frame_count; frame++) {
+        if (0 != draw_frame_headless(init, data)) return -1;
+        if (data.profiler.frame != profiled_frame) {
+            profiled_frame = data.profiler.frame;
+            gpu_busy_ms += data.profiler.gpu_total_ms;
+        }
+    }
+    init.disp.deviceWaitIdle();
+    auto rendered = std::chrono::steady_clock::now();
+    EncoderPool& pool = *data.encoders;
+    double encode_ms = 0.0;
+    uint64_t encoded = 0;
+    {
+        // every buffer back in the ring means every queued frame was written
+        std::unique_lock<std::mutex> lock(pool.mutex);
+        pool.freed.wait(lock, [&]() { return pool.free_buffers.size() == data.readback_buffers.size(); });
+        encode_ms = pool.encode_ms;
+        encoded = pool.encoded;
+    }
+    auto end = std::chrono::steady_clock::now();
+    bool failed = pool.failed;
+    data.encoders.reset();
+
+    double render_s = std::chrono::duration<double>(rendered - start).count();
+    double total_s = std::chrono::duration<double>(end - start).count();
+    std::cout << "sequence: " << options.frame_count << " frames in " << total_s << " s ("
+              << (total_s > 0.0 ? options.frame_count / total_s : 0.0) << " fps sustained, GPU done after "
+              << render_s << " s)\n";
+    std::cout << "render thread blocked on encoders for " << data.readback_stall_ms << " ms, encoding took "
+              << (encoded > 0 ? encode_ms / encoded : 0.0) << " ms per frame";
+    if (data.profiler.gpu_timestamps && render_s > 0.0) {
+        std::cout << ", GPU busy " << 100.0 * gpu_busy_ms / (render_s * 1000.0) << "% of the render time";
+    }
+    std::cout << "\n";
+    if (failed) {
+        std::cout << "failed to write some frames of the sequence\n";
+        return -1;
+    }
+    return 0;
+}
+
+int run_headless(Init& init, RenderData& data, const Options& options) {
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < options.frame_count; frame++) {
+        if (0 != draw_frame_headless(init, data)) return -1;
+    }
+    init.disp.deviceWaitIdle();
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << "rendered " << options.frame_count << " frames at " << init.output_extent.width << "x"
+              << init.output_extent.height << " in " << seconds << " s ("
+              << (seconds > 0.0 ? options.frame_count / seconds : 0.0) << " fps)\n";
+
+    if (!options.output_path.empty() && options.frame_count > 0) {
+        size_t last = (data.current_frame + data.frames_in_flight - 1) % data.frames_in_flight;
+        AllocatedBuffer& readback = data.readback_buffers[last];
+        vmaInvalidateAllocation(init.allocator, readback.allocation, 0, VK_WHOLE_SIZE);
+        if (0 != write_ppm(options.output_path, static_cast<const uint8_t*>(readback.mapped),
+                init.output_extent.width, init.output_extent.height, init.output_format)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Layout, pipeline and resources of a batched multi-view render: every camera is
+// one layer of `views`, all marched by a single dispatch.
+struct MultiViewPass {
+    VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+    VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    AllocatedBuffer cameras;  // ViewCamera per layer
+    AllocatedImage views;     // SCENE_FORMAT, one layer per camera
+    AllocatedBuffer readback; // every layer, tightly packed
+};
+
+void destroy_multiview_pass(Init& init, MultiViewPass& pass) {
+    if (pass.set != VK_NULL_HANDLE) init.disp.freeDescriptorSets(init.descriptor_pool, 1, &pass.set);
+    destroy_buffer(init, pass.readback);
+    destroy_image(init, pass.views);
+    destroy_buffer(init, pass.cameras);
+    init.disp.destroyPipeline(pass.pipeline, nullptr);
+    init.disp.destroyPipelineLayout(pass.pipeline_layout, nullptr);
+    init.disp.destroyDescriptorSetLayout(pass.set_layout, nullptr);
+    pass = MultiViewPass{};
+}
+
+int create_multiview_pass(Init& init, RenderData& data, const std::vector<ViewCamera>& cameras, VkExtent2D extent,
+    MultiViewPass& pass) {
+    uint32_t count = static_cast<uint32_t>(cameras.size());
+    if (count > init.device.physical_device.properties.limits.maxImageArrayLayers) {
+        std::cout << count << " views exceed the device limit of "
+                  << init.device.physical_device.properties.limits.maxImageArrayLayers << " array layers\n";
+        return -1;
+    }
+
+    VkDescriptorSetLayoutBinding bindings[2] = {};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo set_layout_info = {};
+    set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    set_layout_info.bindingCount = 2;
+    set_layout_info.pBindings = bindings;
+
+    if (init.disp.createDescriptorSetLayout(&set_layout_info, nullptr, &pass.set_layout) != VK_SUCCESS) {
+        std::cout << "failed to create multi-view descriptor set layout\n";
+        return -1;
+    }
+
+    // the scene pipeline layout plus the views in set 2
+    VkDescriptorSetLayout set_layouts[] = { data.scene_set_layout, data.bindless.layout, pass.set_layout };
+
+    VkPushConstantRange push_range = {};
+    push_range.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+    push_range.size = sizeof(BindlessIndices);
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.setLayoutCount = 3;
+    pipeline_layout_info.pSetLayouts = set_layouts;
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &push_range;
+
+    if (init.disp.createPipelineLayout(&pipeline_layout_info, nullptr, &pass.pipeline_layout) != VK_SUCCESS) {
+        std::cout << "failed to create multi-view pipeline layout\n";
+        return -1;
+    }
+    if (0 != build_tiled_pipeline(init, data, "shaders/multiview.comp.spv", pass.pipeline_layout, data.quality_tier,
+            pass.pipeline)) {
+        return -1;
+    }
+
+    if (0 != create_buffer(init, sizeof(ViewCamera) * count, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, pass.cameras)) {
+        return -1;
+    }
+    memcpy(pass.cameras.mapped, cameras.data(), sizeof(ViewCamera) * count);
+    vmaFlushAllocation(init.allocator, pass.cameras.allocation, 0, VK_WHOLE_SIZE);
+
+    if (0 != create_image(init, extent, SCENE_FORMAT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+            pass.views, count)) {
+        return -1;
+    }
+    if (0 != create_buffer(init, (VkDeviceSize)extent.width * extent.height * 4 * count,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT, pass.readback)) {
+        return -1;
+    }
+
+    VkDescriptorSetAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = init.descriptor_pool;
+    alloc_info.descriptorSetCount = 1;
+    alloc_info.pSetLayouts = &pass.set_layout;
+    if (init.disp.allocateDescriptorSets(&alloc_info, &pass.set) != VK_SUCCESS) {
+        std::cout << "failed to allocate multi-view descriptor set\n";
+        return -1;
+    }
+
+    VkDescriptorImageInfo image_info = {};
+    image_info.imageView = pass.views.view;
+    image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    VkDescriptorBufferInfo buffer_info = {};
+    buffer_info.buffer = pass.cameras.buffer;
+    buffer_info.range = VK_WHOLE_SIZE;
+
+    VkWriteDescriptorSet writes[2] = {};
+    writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[0].dstSet = pass.set;
+    writes[0].dstBinding = 0;
+    writes[0].descriptorCount = 1;
+    writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    writes[0].pImageInfo = &image_info;
+    writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[1].dstSet = pass.set;
+    writes[1].dstBinding = 1;
+    writes[1].descriptorCount = 1;
+    writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writes[1].pBufferInfo = &buffer_info;
+    init.disp.updateDescriptorSets(2, writes, 0, nullptr);
+    return 0;
+}
+
+// Marches every view with one pipeline bind and one dispatch, then copies all
+// layers into the readback buffer.
+void record_multiview(Init& init, RenderData& data, VkCommandBuffer cmd, const MultiViewPass& pass) {
+    VkExtent2D extent = pass.views.extent;
+    VkImageMemoryBarrier to_general = image_barrier(pass.views.image, VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_GENERAL, 0, VK_ACCESS_SHADER_WRITE_BIT);
+    to_general.subresourceRange.layerCount = pass.views.layers;
+    init.disp.cmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &to_general);
+
+    // no tile lists, pre-pass or history for these cameras
+    FrameConstants constants = {};
+    constants.resolution[0] = extent.width;
+    constants.resolution[1] = extent.height;
+    uint32_t constants_offset = frame_uniforms_push(init, data.frame_uniforms, &constants, sizeof(constants));
+    VkDescriptorSet sets[] = { data.scene_set, data.bindless.set, pass.set };
+    init.disp.cmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pass.pipeline);
+    init.disp.cmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pass.pipeline_layout,
+        0, 3, sets, 1, &constants_offset);
+    init.disp.cmdPushConstants(cmd, pass.pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT,
+        0, sizeof(BindlessIndices), &data.bindless_indices);
+    uint32_t tile = data.compute_tile_size;
+    init.disp.cmdDispatch(cmd, (extent.width + tile - 1) / tile, (extent.height + tile - 1) / tile, pass.views.layers);
+
+    VkImageMemoryBarrier to_transfer = image_barrier(pass.views.image, VK_IMAGE_LAYOUT_GENERAL,
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    to_transfer.subresourceRange.layerCount = pass.views.layers;
+    init.disp.cmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &to_transfer);
+
+    VkBufferImageCopy region = {};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = pass.views.layers;
+    region.imageExtent = { extent.width, extent.height, 1 };
+    init.disp.cmdCopyImageToBuffer(cmd, pass.views.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        pass.readback.buffer, 1, &region);
+
+    VkBufferMemoryBarrier to_host = {};
+    to_host.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    to_host.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    to_host.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    to_host.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    to_host.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    to_host.buffer = pass.readback.buffer;
+    to_host.size = VK_WHOLE_SIZE;
+    init.disp.cmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+        0, 0, nullptr, 1, &to_host, 0, nullptr);
+}
+
+// Records and submits the whole batch in one command buffer, then waits for it.
+int render_views(Init& init, RenderData& data, const MultiViewPass& pass) {
+    VkCommandBufferAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.commandPool = data.command_pool;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandBufferCount = 1;
+
+    VkCommandBuffer cmd = VK_NULL_HANDLE;
+    if (init.disp.allocateCommandBuffers(&alloc_info, &cmd) != VK_SUCCESS) {
+        std::cout << "failed to allocate multi-view command buffer\n";
+        return -1;
+    }
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    init.disp.beginCommandBuffer(cmd, &begin_info);
+    // nothing else is in flight: this runs before the first frame
+    frame_uniforms_begin(data.frame_uniforms, data.current_frame);
+    record_multiview(init, data, cmd, pass);
+    init.disp.endCommandBuffer(cmd);
+
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &cmd;
+    int res = 0;
+    if (init.disp.queueSubmit(data.graphics_queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+        std::cout << "failed to submit multi-view command buffer\n";
+        res = -1;
+    }
+    init.disp.queueWaitIdle(data.graphics_queue);
+    init.disp.freeCommandBuffers(data.command_pool, 1, &cmd);
+    return res;
+}
+
+// Cameras evenly spaced on a circle around the main camera's target, at its
+// current distance and height.
+std::vector<ViewCamera> turntable_cameras(const RenderData& data, uint32_t count, float fov_degrees) {
+    const Camera& camera = data.camera;
+    float dx = camera.position[0] - camera.target[0];
+    float dz = camera.position[2] - camera.target[2];
+    float radius = std::sqrt(dx * dx + dz * dz);
+    float start = std::atan2(dx, -dz);
+
+    std::vector<ViewCamera> cameras(count);
+    for (uint32_t i = 0; i < count; i++) {
+        float angle = start + 2.0f * 3.14159265f * static_cast<float>(i) / static_cast<float>(count);
+        ViewCamera& view = cameras[i];
+        view.position[0] = camera.target[0] + radius * std::sin(angle);
+        view.position[1] = camera.position[1];
+        view.position[2] = camera.target[2] - radius * std::cos(angle);
+        view.position[3] = fov_degrees * 3.14159265f / 180.0f;
+        for (int c = 0; c < 3; c++) view.target[c] = camera.target[c];
+        view.target[3] = 0.0f;
+    }
+    return cameras;
+}
+
+// --views: renders a turntable into one layered image with a single submit and
+// writes each layer as <output>_<index>.ppm.
+int run_multiview(Init& init, RenderData& data, const Options& options) {
+    VkExtent2D extent = { options.width, options.height };
+    std::vector<ViewCamera> cameras = turntable_cameras(data, options.view_count, options.view_fov);
+
+    MultiViewPass pass;
+    int res = create_multiview_pass(init, data, cameras, extent, pass);
+    if (res == 0) {
+        auto start = std::chrono::steady_clock::now();
+        res = render_views(init, data, pass);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "rendered " << options.view_count << " views at " << extent.width << "x" << extent.height
+                  << " in one submit, " << elapsed.count() << " ms\n";
+    }
+
+    if (res == 0 && !options.output_path.empty()) {
+        vmaInvalidateAllocation(init.allocator, pass.readback.allocation, 0, VK_WHOLE_SIZE);
+        std::string stem = options.output_path;
+        if (stem.size() > 4 && stem.compare(stem.size() - 4, 4, ".ppm") == 0) stem.resize(stem.size() - 4);
+        size_t layer_size = (size_t)extent.width * extent.height * 4;
+        for (uint32_t i = 0; res == 0 && i < options.view_count; i++) {
+            res = write_ppm(stem + "_" + std::to_string(i) + ".ppm",
+                static_cast<const uint8_t*>(pass.readback.mapped) + layer_size * i, extent.width, extent.height,
+                SCENE_FORMAT);
+        }
+    }
+    destroy_multiview_pass(init, pass);
+    return res;
+}
+
+// CPU reference ray marcher (cpu_march.h): the tile pool and frame loop around the
+// 8-wide packet kernels. It renders when no Vulkan device is usable, and with --cpu
+// as a reference to diff GPU frames against.
+
+bool cpu_take_tile(CpuTilePool& pool, uint32_t self, uint32_t& tile) {
+    {
+        CpuTilePool::Queue& own = *pool.queues[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tiles.empty()) {
+            tile = own.tiles.front();
+            own.tiles.pop_front();
+            return true;
+        }
+    }
+    for (uint32_t i = 1; i < pool.queues.size(); i++) {
+        CpuTilePool::Queue& victim = *pool.queues[(self + i) % pool.queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tiles.empty()) {
+            tile = victim.tiles.back();
+            victim.tiles.pop_back();
+            pool.steals++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void cpu_tile_worker(CpuTilePool* pool, uint32_t self) {
+    uint64_t seen = 0;
+    while (true) {
+        std::function<void(uint32_t)> job;
+        {
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            pool->start.wait(lock, [&]() { return pool->stop || pool->generation != seen; });
+            if (pool->stop) return;
+            seen = pool->generation;
+            job = pool->job;
+        }
+        uint32_t tile = 0;
+        while (cpu_take_tile(*pool, self, tile)) job(tile);
+        {
+            std::lock_guard<std::mutex> lock(pool->mutex);
+            pool->busy--;
+        }
+        pool->done.notify_one();
+    }
+}
+
+void start_cpu_tile_pool(CpuTilePool& pool, uint32_t threads) {
+    for (uint32_t i = 0; i < threads; i++) pool.queues.push_back(std::make_unique<CpuTilePool::Queue>());
+    for (uint32_t i = 0; i < threads; i++) pool.workers.emplace_back(cpu_tile_worker, &pool, i);
+}
+
+// Runs job(tile) for every tile on the pool and returns once all are done.
+void cpu_run_tiles(CpuTilePool& pool, uint32_t tile_count, std::function<void(uint32_t)> job) {
+    uint32_t threads = static_cast<uint32_t>(pool.queues.size());
+    for (uint32_t i = 0; i < threads; i++) {
+        std::lock_guard<std::mutex> lock(pool.queues[i]->mutex);
+        for (uint32_t tile = tile_count * i / threads; tile < tile_count * (i + 1) / threads; tile++) {
+            pool.queues[i]->tiles.push_back(tile);
+        }
+    }
+    std::unique_lock<std::mutex> lock(pool.mutex);
+    pool.job = std::move(job);
+    pool.busy = threads;
+    pool.generation++;
+    pool.start.notify_all();
+    pool.done.wait(lock, [&]() { return pool.busy == 0; });
+}
+
+// Tiles are CPU_TILE_WIDTH packets wide and CPU_TILE_HEIGHT rows tall.
+const uint32_t CPU_TILE_WIDTH = 8 * 4;
+const uint32_t CPU_TILE_HEIGHT = 8;
+
+void cpu_render_frame(CpuTilePool& pool, const CpuScene& scene, const Camera& camera, VkExtent2D extent,
+    uint8_t* pixels) {
+    const CpuMarcher& marcher = cpu_marcher();
+    uint32_t tiles_x = (extent.width + CPU_TILE_WIDTH - 1) / CPU_TILE_WIDTH;
+    uint32_t tiles_y = (extent.height + CPU_TILE_HEIGHT - 1) / CPU_TILE_HEIGHT;
+    cpu_run_tiles(pool, tiles_x * tiles_y, [&](uint32_t tile) {
+        uint32_t x0 = tile % tiles_x * CPU_TILE_WIDTH;
+        uint32_t y0 = tile / tiles_x * CPU_TILE_HEIGHT;
+        for (uint32_t y = y0; y < std::min(y0 + CPU_TILE_HEIGHT, extent.height); y++) {
+            for (uint32_t x = x0; x < std::min(x0 + CPU_TILE_WIDTH, extent.width); x += 8) {
+                marcher.shade_packet(scene, camera, extent.width, extent.height, x, y, pixels);
+            }
+        }
+    });
+}
+
+// Headless rendering without Vulkan: same frame count, camera animation and
+// --output as run_headless. Temporal accumulation, the depth pre-pass, the baked
+// brick map distances and render scaling are GPU-only, and the CPU marches the
+// primitives analytically; compare against a GPU run with
+// --lighting-scale 1 --no-prepass --no-brick-map
+// (or --single-pass --no-temporal --no-prepass --no-brick-map).
+int run_cpu_reference(const Options& options) {
+    // only the camera state of RenderData is used
+    RenderData data;
+    data.orbit_camera = options.orbit;
+    SceneSource& source = data.scene_source;
+    if (0 != load_scene(options, source)) return -1;
+    CpuScene scene = { std::vector<SdfPrimitive>(source.primitives, source.primitives + source.primitive_count),
+        QUALITY_TIERS[options.quality], std::vector<SceneLight>(source.lights, source.lights + source.light_count) };
+    apply_scene_camera(source, 0, data.camera);
+    unmap_file(source.file);
+    VkExtent2D extent = { options.width, options.height };
+    std::vector<uint8_t> pixels((size_t)extent.width * extent.height * 4);
+
+    uint32_t threads = std::max(1u, std::thread::hardware_concurrency());
+    CpuTilePool pool;
+    start_cpu_tile_pool(pool, threads);
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < options.frame_count; frame++) {
+        update_camera(data);
+        cpu_render_frame(pool, scene, data.camera, extent, pixels.data());
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "cpu (" << cpu_marcher().name << ", " << threads << " threads): rendered " << options.frame_count
+              << " frames at " << extent.width << "x" << extent.height << " in " << seconds << " s ("
+              << (seconds > 0.0 ? options.frame_count / seconds : 0.0) << " fps, " << pool.steals.load()
+              << " tiles stolen)\n";
+
+    if (!options.output_path.empty() && options.frame_count > 0) {
+        return write_ppm(options.output_path, pixels.data(), extent.width, extent.height, VK_FORMAT_B8G8R8A8_UNORM);
+    }
+    return 0;
+}
+
+// Brick map baking: the SDF of data.scene_primitives sampled with the 8-wide
+// kernels of cpu_marcher() on a CPU tile pool, one job per packet of cells or
+// per brick. After an edit only the cells the edited primitive may be closest
+// in are revisited.
+
+static_assert(BRICK_SIZE == 8, "a row of brick samples is one packet");
+
+// Radius of a sphere around position_type bounding the primitive, negative when
+// unbounded (primitiveBoundingRadius in shaders/scene.glsl)
+float primitive_bounding_radius(const SdfPrimitive& prim) {
+    uint32_t type = static_cast<uint32_t>(prim.position_type[3]);
+    if (type == SDF_PLANE) return -1.0f;
+    if (type == SDF_BOX) {
+        return std::sqrt(prim.params[0] * prim.params[0] + prim.params[1] * prim.params[1] +
+            prim.params[2] * prim.params[2]);
+    }
+    return prim.params[0];
+}
+
+void brick_cell_center(const BrickMap& map, uint32_t cell, float center[3]) {
+    uint32_t index[3] = { cell % map.cells[0], cell / map.cells[0] % map.cells[1], cell / (map.cells[0] * map.cells[1]) };
+    for (int i = 0; i < 3; i++) center[i] = map.origin[i] + (static_cast<float>(index[i]) + 0.5f) * map.cell_size;
+}
+
+float brick_half_diagonal(const BrickMap& map) {
+    return 0.5f * std::sqrt(3.0f) * map.cell_size;
+}
+
+// The surface may pass through the cell or just outside of it
+bool brick_cell_needs_brick(const BrickMap& map, float distance) {
+    return std::fabs(distance) < brick_half_diagonal(map) + map.cell_size;
+}
+
+// Lower bound of the primitive's distance anywhere in the cell around center
+float brick_primitive_lower_bound(const SdfPrimitive& prim, const float center[3], float half_diagonal) {
+    float radius = primitive_bounding_radius(prim);
+    if (radius < 0.0f) return -FLT_MAX;
+    float dx = center[0] - prim.position_type[0];
+    float dy = center[1] - prim.position_type[1];
+    float dz = center[2] - prim.position_type[2];
+    return std::sqrt(dx * dx + dy * dy + dz * dz) - radius - half_diagonal;
+}
+
+// Round to nearest; denormals flush to zero and overflow clamps to the largest half
+uint16_t float_to_half(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xffu) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffffu;
+    if (exponent <= 0) return static_cast<uint16_t>(sign);
+    if (exponent >= 31) return static_cast<uint16_t>(sign | 0x7bffu);
+    uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000u) half++;
+    return static_cast<uint16_t>(sign | std::min(half, 0x7bffu));
+}
+
+void bake_center_distances(const CpuScene& scene, BrickMap& map, const std::vector<uint32_t>& cells) {
+    const CpuMarcher& marcher = cpu_marcher();
+    uint32_t packets = static_cast<uint32_t>((cells.size() + 7) / 8);
+    cpu_run_tiles(map.baker, packets, [&](uint32_t packet) {
+        size_t first = (size_t)packet * 8;
+        size_t count = std::min<size_t>(8, cells.size() - first);
+        float x[8], y[8], z[8], d[8];
+        for (size_t lane = 0; lane < 8; lane++) {
+            float center[3];
+            brick_cell_center(map, cells[first + std::min(lane, count - 1)], center);
+            x[lane] = center[0];
+            y[lane] = center[1];
+            z[lane] = center[2];
+        }
+        marcher.scene_distance(scene, x, y, z, d);
+        for (size_t lane = 0; lane < count; lane++) map.center_distance[cells[first + lane]] = d[lane];
+    });
+}
+
+// Gives the cells bricks or empty entries from their center distances, samples
+// every brick and queues the bricks with the entries of the cells for upload.
+int bake_brick_cells(Init& init, RenderData& data, const CpuScene& scene, const std::vector<uint32_t>& cells) {
+    BrickMap& map = data.brick_map;
+    const CpuMarcher& marcher = cpu_marcher();
+    float half_diagonal = brick_half_diagonal(map);
+
+    std::vector<std::pair<uint32_t, uint32_t>> bricks; // cell, atlas slot
+    map.overflow = 0;
+    for (uint32_t cell : cells) {
+        float distance = map.center_distance[cell];
+        uint32_t& entry = map.entries[cell];
+        bool has_brick = (entry & BRICK_EMPTY) == 0;
+        if (brick_cell_needs_brick(map, distance)) {
+            if (!has_brick) {
+                if (map.free_bricks.empty()) {
+                    // a zero distance leaves the cell to the primitives
+                    entry = BRICK_EMPTY;
+                    map.overflow++;
+                    continue;
+                }
+                entry = map.free_bricks.back();
+                map.free_bricks.pop_back();
+            }
+            bricks.push_back({ cell, entry });
+        } else {
+            if (has_brick) map.free_bricks.push_back(entry);
+            // rounded down so it stays a lower bound; zero inside solids
+            double fixed = std::floor(std::max(distance, 0.0f) * BRICK_DISTANCE_SCALE);
+            entry = BRICK_EMPTY | static_cast<uint32_t>(std::min(fixed, static_cast<double>(~BRICK_EMPTY)));
+        }
+    }
+
+    const uint32_t samples = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+    float voxel = map.cell_size / static_cast<float>(BRICK_SIZE - 1);
+    std::vector<uint16_t> halves(bricks.size() * samples);
+    cpu_run_tiles(map.baker, static_cast<uint32_t>(bricks.size()), [&](uint32_t job) {
+        uint32_t cell = bricks[job].first;
+        float center[3];
+        brick_cell_center(map, cell, center);
+
+        // only primitives that can be the closest somewhere in the cell
+        float reach = map.center_distance[cell] + half_diagonal;
+        std::vector<const SdfPrimitive*> candidates;
+        for (const SdfPrimitive& prim : scene.primitives) {
+            if (brick_primitive_lower_bound(prim, center, half_diagonal) <= reach) candidates.push_back(&prim);
+        }
+
+        float corner[3];
+        for (int i = 0; i < 3; i++) corner[i] = center[i] - 0.5f * map.cell_size;
+        float xs[8];
+        for (uint32_t i = 0; i < 8; i++) xs[i] = corner[0] + static_cast<float>(i) * voxel;
+        for (uint32_t z = 0; z < BRICK_SIZE; z++) {
+            for (uint32_t y = 0; y < BRICK_SIZE; y++) {
+                float row[8];
+                marcher.primitives_distance(candidates.data(), candidates.size(), scene.quality.max_dist, xs,
+                    corner[1] + static_cast<float>(y) * voxel, corner[2] + static_cast<float>(z) * voxel, row);
+                uint16_t* out = &halves[(size_t)job * samples + (z * BRICK_SIZE + y) * BRICK_SIZE];
+                for (uint32_t i = 0; i < 8; i++) out[i] = float_to_half(row[i]);
+            }
+        }
+    });
+
+    BrickUpload upload;
+    if (cells.empty()) {
+        // an edit that touches no cell still needs its primitive uploaded
+        map.pending.push_back(std::move(upload));
+        return 0;
+    }
+    VkDeviceSize brick_bytes = halves.size() * sizeof(uint16_t);
+    VkDeviceSize indirection_bytes = cells.size() * sizeof(uint32_t);
+    if (0 != create_buffer(init, brick_bytes + indirection_bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, upload.staging)) {
+        return -1;
+    }
+    auto* mapped = static_cast<uint8_t*>(upload.staging.mapped);
+    memcpy(mapped, halves.data(), brick_bytes);
+    auto* entries = reinterpret_cast<uint32_t*>(mapped + brick_bytes);
+    for (size_t i = 0; i < cells.size(); i++) entries[i] = map.entries[cells[i]];
+    vmaFlushAllocation(init.allocator, upload.staging.allocation, 0, VK_WHOLE_SIZE);
+
+    // consecutive cells of one row share a region, so a full bake copies whole
+    // rows and an edit only the few entries around the primitive
+    for (size_t first = 0; first < cells.size();) {
+        size_t last = first + 1;
+        while (last < cells.size() && cells[last] == cells[last - 1] + 1 && cells[last] % map.cells[0] != 0) last++;
+        uint32_t cell = cells[first];
+        VkBufferImageCopy region = {};
+        region.bufferOffset = brick_bytes + first * sizeof(uint32_t);
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = {
+            static_cast<int32_t>(cell % map.cells[0]),
+            static_cast<int32_t>(cell / map.cells[0] % map.cells[1]),
+            static_cast<int32_t>(cell / (map.cells[0] * map.cells[1]))
+        };
+        region.imageExtent = { static_cast<uint32_t>(last - first), 1, 1 };
+        upload.indirection.push_back(region);
+        first = last;
+    }
+
+    for (size_t i = 0; i < bricks.size(); i++) {
+        uint32_t slot = bricks[i].second;
+        VkBufferImageCopy region = {};
+        region.bufferOffset = i * samples * sizeof(uint16_t);
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = {
+            static_cast<int32_t>(slot % BRICK_ATLAS_BRICKS * BRICK_SIZE),
+            static_cast<int32_t>(slot / BRICK_ATLAS_BRICKS % BRICK_ATLAS_BRICKS * BRICK_SIZE),
+            static_cast<int32_t>(slot / (BRICK_ATLAS_BRICKS * BRICK_ATLAS_BRICKS) * BRICK_SIZE)
+        };
+        region.imageExtent = { BRICK_SIZE, BRICK_SIZE, BRICK_SIZE };
+        upload.bricks.push_back(region);
+    }
+    map.pending.push_back(std::move(upload));
+    return 0;
+}
+
+// Covers the bounded primitives plus padding with at most BRICK_MAP_MAX_CELLS
+// cells per axis, sizes the atlas for half again the bricks the scene needs so
+// edits rarely run out of slots, and bakes everything. Unbounded primitives
+// (planes) are baked wherever they cross the grid.
+int create_brick_map(Init& init, RenderData& data) {
+    BrickMap& map = data.brick_map;
+    auto start = std::chrono::steady_clock::now();
+
+    float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (const SdfPrimitive& prim : data.scene_primitives) {
+        float radius = primitive_bounding_radius(prim);
+        if (radius < 0.0f) continue;
+        for (int i = 0; i < 3; i++) {
+            lo[i] = std::min(lo[i], prim.position_type[i] - radius - BRICK_MAP_PADDING);
+            hi[i] = std::max(hi[i], prim.position_type[i] + radius + BRICK_MAP_PADDING);
+        }
+    }
+    if (lo[0] > hi[0]) {
+        for (int i = 0; i < 3; i++) {
+            lo[i] = -BRICK_MAP_PADDING;
+            hi[i] = BRICK_MAP_PADDING;
+        }
+    }
+    float extent = std::max(hi[0] - lo[0], std::max(hi[1] - lo[1], hi[2] - lo[2]));
+    map.cell_size = extent / static_cast<float>(BRICK_MAP_MAX_CELLS);
+    uint32_t cell_count = 1;
+    for (int i = 0; i < 3; i++) {
+        map.origin[i] = lo[i];
+        map.cells[i] = static_cast<uint32_t>(std::ceil((hi[i] - lo[i]) / map.cell_size));
+        map.cells[i] = std::min(std::max(map.cells[i], 1u), BRICK_MAP_MAX_CELLS);
+        cell_count *= map.cells[i];
+    }
+    map.entries.assign(cell_count, BRICK_EMPTY);
+    map.center_distance.assign(cell_count, 0.0f);
+
+    CpuScene scene = { data.scene_primitives, QUALITY_TIERS[QUALITY_HIGH] };
+    if (map.baker.workers.empty()) start_cpu_tile_pool(map.baker, std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<uint32_t> cells(cell_count);
+    for (uint32_t cell = 0; cell < cell_count; cell++) cells[cell] = cell;
+    bake_center_distances(scene, map, cells);
+
+    uint32_t needed = 0;
+    for (float distance : map.center_distance) {
+        if (brick_cell_needs_brick(map, distance)) needed++;
+    }
+    // at most BRICK_ATLAS_BRICKS layers of bricks keeps the atlas within the
+    // guaranteed 256 texel limit of 3D images, enough for every cell
+    uint32_t per_layer = BRICK_ATLAS_BRICKS * BRICK_ATLAS_BRICKS;
+    uint32_t wanted = std::min(needed + needed / 2 + 1, cell_count);
+    uint32_t layers = std::min((wanted + per_layer - 1) / per_layer, BRICK_ATLAS_BRICKS);
+    map.capacity = layers * per_layer;
+    map.free_bricks.clear();
+    for (uint32_t slot = map.capacity; slot-- > 0;) map.free_bricks.push_back(slot);
+
+    if (0 != create_image_3d(init, { map.cells[0], map.cells[1], map.cells[2] }, VK_FORMAT_R32_UINT,
+            VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, map.indirection)) {
+        return -1;
+    }
+    uint32_t atlas_size = BRICK_ATLAS_BRICKS * BRICK_SIZE;
+    if (0 != create_image_3d(init, { atlas_size, atlas_size, layers * BRICK_SIZE }, BRICK_ATLAS_FORMAT,
+            VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, map.atlas)) {
+        return -1;
+    }
+
+    VkSamplerCreateInfo sampler_info = {};
+    sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_info.magFilter = VK_FILTER_LINEAR;
+    sampler_info.minFilter = VK_FILTER_LINEAR;
+    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    if (init.disp.createSampler(&sampler_info, nullptr, &map.sampler) != VK_SUCCESS) {
+        std::cout << "failed to create brick map sampler\n";
+        return -1;
+    }
+
+    if (0 != bake_brick_cells(init, data, scene, cells)) return -1;
+
+    SceneHeader& header = data.scene_header;
+    for (int i = 0; i < 3; i++) {
+        header.brick_origin[i] = map.origin[i];
+        header.brick_cells[i] = map.cells[i];
+    }
+    header.brick_origin[3] = map.cell_size;
+    data.scene_stream.header_dirty = true;
+
+    std::chrono::duration<double, std::milli> bake_ms = std::chrono::steady_clock::now() - start;
+    map.bake_ms = bake_ms.count();
+    map.baked_cells = cell_count;
+    std::cout << "brick map: " << map.cells[0] << "x" << map.cells[1] << "x" << map.cells[2] << " cells of "
+              << map.cell_size << ", " << map.capacity - map.free_bricks.size() << "/" << map.capacity
+              << " bricks, baked in " << map.bake_ms << " ms\n";
+    return 0;
+}
+
+void destroy_brick_map(Init& init, BrickMap& map) {
+    for (BrickUpload& upload : map.pending) destroy_buffer(init, upload.staging);
+    map.pending.clear();
+    destroy_image(init, map.atlas);
+    destroy_image(init, map.indirection);
+    init.disp.destroySampler(map.sampler, nullptr);
+    map.sampler = VK_NULL_HANDLE;
+}
+
+// Moves or reshapes one primitive. Only the cells where the old or the new shape
+// may be the closest surface are rebaked; the primitive and those bricks reach
+// the GPU together in the next frame's upload pass. The grid keeps the bounds it
+// was created with, so geometry moved outside of it is marched analytically.
+int update_scene_primitive(Init& init, RenderData& data, uint32_t index, const SdfPrimitive& primitive) {
+    BrickMap& map = data.brick_map;
+    auto start = std::chrono::steady_clock::now();
+    SdfPrimitive previous = data.scene_primitives[index];
+    data.scene_primitives[index] = primitive;
+
+    // the scene distance anywhere in a cell is at most center distance plus half
+    // diagonal; a primitive whose lower bound exceeds that cannot be the closest
+    float half_diagonal = brick_half_diagonal(map);
+    std::vector<uint32_t> dirty;
+    for (uint32_t cell = 0; cell < map.entries.size(); cell++) {
+        float center[3];
+        brick_cell_center(map, cell, center);
+        float reach = map.center_distance[cell] + half_diagonal;
+        if (brick_primitive_lower_bound(previous, center, half_diagonal) <= reach ||
+            brick_primitive_lower_bound(primitive, center, half_diagonal) <= reach) {
+            dirty.push_back(cell);
+        }
+    }
+
+    CpuScene scene = { data.scene_primitives, QUALITY_TIERS[QUALITY_HIGH] };
+    bake_center_distances(scene, map, dirty);
+    if (0 != bake_brick_cells(init, data, scene, dirty)) return -1;
+    map.pending.back().primitives.push_back({ index, primitive });
+
+    std::chrono::duration<double, std::milli> bake_ms = std::chrono::steady_clock::now() - start;
+    map.bake_ms = bake_ms.count();
+    map.baked_cells = static_cast<uint32_t>(dirty.size());
+    return 0;
+}
+
+// Edits queued by the UI, applied before the frame that shows them is recorded.
+int apply_scene_edits(Init& init, RenderData& data) {
+    for (const auto& edit : data.scene_edits) {
+        if (0 != update_scene_primitive(init, data, edit.first, edit.second)) return -1;
+    }
+    data.scene_edits.clear();
+    return 0;
+}
+
+void cleanup_imgui() {
+    ImGui_ImplVulkan_Shutdown();
+    ImGui_ImplGlfw_Shutdown();
+    ImGui::DestroyContext();
+}
+
+void cleanup(Init& init, RenderData& data) {
+
+    // encoder threads still wait on frame_timeline and read the readback buffers
+    data.encoders.reset();
+
+    // clean up imgui
+    if (!init.headless) {
+        stop_overlay_recorder(init, data);
+        cleanup_imgui();
+    }
+
+    stop_shader_reloader(init, data);
+    stop_latency_tracker(data);
+    flush_deferred_destroys(data, true);
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        init.disp.destroySemaphore(data.finished_semaphore[i], nullptr);
+        init.disp.destroySemaphore(data.available_semaphores[i], nullptr);
+    }
+    init.disp.destroySemaphore(data.frame_timeline, nullptr);
+    for (VkSemaphore timeline : data.queue_timelines) init.disp.destroySemaphore(timeline, nullptr);
+
+    init.disp.destroyCommandPool(data.command_pool, nullptr);
+    if (data.compute_command_pool != VK_NULL_HANDLE) init.disp.destroyCommandPool(data.compute_command_pool, nullptr);
+
+    init.disp.destroyDescriptorPool(init.descriptor_pool, nullptr);
+    init.disp.destroyDescriptorPool(data.bindless.pool, nullptr);
+
+    destroy_image(init, data.history[0]);
+    destroy_image(init, data.history[1]);
+    destroy_image(init, data.checker_history[0]);
+    destroy_image(init, data.checker_history[1]);
+    destroy_buffer(init, data.step_counters);
+    destroy_buffer(init, data.frame_uniforms.buffer);
+    destroy_buffer(init, data.tile_list_buffer);
+    destroy_buffer(init, data.scene_buffer);
+    destroy_buffer(init, data.light_buffer);
+    destroy_buffer(init, data.staging_ring.buffer);
+    unmap_file(data.scene_source.file);
+    destroy_brick_map(init, data.brick_map);
+    destroy_shader_pipelines(init, data.pipelines);
+    init.disp.destroyDescriptorSetLayout(data.scene_set_layout, nullptr);
+    init.disp.destroyDescriptorSetLayout(data.bindless.layout, nullptr);
+
+    rg_destroy(init.disp, init.allocator, data.graph);
+    destroy_profiler(init, data);
+
+    init.disp.destroyPipelineLayout(data.pipeline_layout, nullptr);
+
+    if (init.headless) {
+        for (auto& image : data.offscreen_images) destroy_image(init, image);
+        for (auto& buffer : data.readback_buffers) destroy_buffer(init, buffer);
+    } else {
+        init.swapchain.destroy_image_views(data.swapchain_image_views);
+        vkb::destroy_swapchain(init.swapchain);
+    }
+
+    save_pipeline_cache(init);
+    init.disp.destroyPipelineCache(init.pipeline_cache, nullptr);
+
+    vmaDestroyAllocator(init.allocator);
+
+    vkb::destroy_device(init.device);
+    if (!init.headless) {
+        vkb::destroy_surface(init.instance, init.surface);
+    }
+    vkb::destroy_instance(init.instance);
+    if (!init.headless) {
+        destroy_window_glfw(init.window);
+    }
+}
+
+// Rolling graph of one profiler series, newest sample on the right.
+void plot_profiler_history(const Profiler& profiler, uint32_t series, const char* label, float value_ms) {
+    char overlay[32];
+    snprintf(overlay, sizeof(overlay), "%.3f ms", value_ms);
+    ImGui::PlotLines(label, profiler.history[series].data(), static_cast<int>(PROFILER_HISTORY),
+        static_cast<int>(profiler.history_head), overlay, 0.0f, FLT_MAX, ImVec2(0.0f, 32.0f));
+}
+
+void render_profiler_ui(const Profiler& profiler) {
+    // the frame wait is the CPU idling on the GPU; whichever side is busier bounds the frame
+    ImGui::Text("frame %llu: GPU %.2f ms, CPU %.2f ms (%s-bound)", static_cast<unsigned long long>(profiler.frame),
+        profiler.gpu_total_ms, profiler.cpu_total_ms, profiler.gpu_total_ms > profiler.cpu_total_ms ? "GPU" : "CPU");
+    if (!profiler.gpu_timestamps) {
+        ImGui::Text("GPU timestamps not supported on this queue");
+    }
+    plot_profiler_history(profiler, GPU_SCOPE_COUNT + CPU_SCOPE_COUNT, "GPU total", profiler.gpu_total_ms);
+    plot_profiler_history(profiler, GPU_SCOPE_COUNT + CPU_SCOPE_COUNT + 1, "CPU total", profiler.cpu_total_ms);
+
+    if (ImGui::TreeNode("GPU passes")) {
+        for (uint32_t i = 0; i < GPU_SCOPE_COUNT; i++) {
+            plot_profiler_history(profiler, i, GPU_SCOPE_NAMES[i], profiler.gpu_ms[i]);
+        }
+        ImGui::TreePop();
+    }
+    if (ImGui::TreeNode("CPU scopes")) {
+        for (uint32_t i = 0; i < CPU_SCOPE_COUNT; i++) {
+            plot_profiler_history(profiler, GPU_SCOPE_COUNT + i, CPU_SCOPE_NAMES[i], profiler.cpu_ms[i]);
+        }
+        ImGui::TreePop();
+    }
+}
+
+void render_latency_ui(LatencyTracker& tracker, bool present_wait) {
+    std::lock_guard<std::mutex> lock(tracker.mutex);
+    for (uint32_t stage = 0; stage < LATENCY_STAGE_COUNT; stage++) {
+        if (stage == LATENCY_PRESENT && !present_wait) {
+            ImGui::Text("%s: needs VK_KHR_present_wait", LATENCY_STAGE_NAMES[stage]);
+            continue;
+        }
+        char overlay[32];
+        snprintf(overlay, sizeof(overlay), "%.2f ms", tracker.latest_ms[stage]);
+        ImGui::PlotLines(LATENCY_STAGE_NAMES[stage], tracker.history[stage].data(), static_cast<int>(LATENCY_HISTORY),
+            static_cast<int>(tracker.history_head), overlay, 0.0f, FLT_MAX, ImVec2(0.0f, 32.0f));
+    }
+}
+
+// Runs the widgets and leaves the overlay's draw data in ImGui::GetDrawData().
+void build_imgui_frame(const Init& init, RenderData& data)
+{
+    ImGui_ImplVulkan_NewFrame();
+    ImGui_ImplGlfw_NewFrame();
+    ImGui::NewFrame();
+
+    // Your ImGui code here
+    ImGui::Begin("Hello, world!");
+    ImGui::Text("This is a simple ImGui application.");
+    ImGui::Text("%.3f ms/frame (%.1f fps)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+    ImGui::Checkbox("Split G-buffer passes", &data.split_passes);
+    if (data.split_passes) {
+        const char* scales[] = { "full", "half", "quarter" };
+        int scale_index = data.lighting_scale == 4 ? 2 : data.lighting_scale == 2 ? 1 : 0;
+        if (ImGui::Combo("Shadow/AO resolution", &scale_index, scales, 3)) data.lighting_scale = 1u << scale_index;
+        const Profiler& profiler = data.profiler;
+        ImGui::Text("gbuffer %.2f ms, lighting %.2f ms, composite %.2f ms", profiler.gpu_ms[GPU_SCOPE_GBUFFER],
+            profiler.gpu_ms[GPU_SCOPE_LIGHTING], profiler.gpu_ms[GPU_SCOPE_COMPOSITE]);
+        ImGui::Checkbox("Checkerboard", &data.checkerboard);
+        if (data.checkerboard) ImGui::Text("reconstruct %.2f ms", profiler.gpu_ms[GPU_SCOPE_RECONSTRUCT]);
+        if (data.compute_queue != VK_NULL_HANDLE) ImGui::Checkbox("Async compute lighting", &data.async_compute);
+    } else {
+        ImGui::Checkbox("Compute ray march", &data.use_compute);
+    }
+    if (data.split_passes || data.use_compute) {
+        ImGui::Text("tiles: %ux%u", data.compute_tile_size, data.compute_tile_size);
+    }
+    ImGui::Checkbox("Coarse depth pre-pass", &data.depth_prepass);
+    ImGui::Checkbox("Count march steps", &data.step_stats);
+    if (data.step_stats) {
+        ImGui::Text("%.1f steps/pixel", data.average_steps);
+    }
+    ImGui::Checkbox("Step heatmap", &data.step_heatmap);
+    if (!data.split_passes) ImGui::Checkbox("Temporal shadows/AO", &data.temporal);
+    ImGui::Checkbox("Orbit camera", &data.orbit_camera);
+    ImGui::Checkbox("Brick map", &data.use_brick_map);
+    const BrickMap& brick_map = data.brick_map;
+    ImGui::Text("bricks: %u/%u, last bake: %u cells in %.2f ms",
+        static_cast<uint32_t>(brick_map.capacity - brick_map.free_bricks.size()), brick_map.capacity,
+        brick_map.baked_cells, brick_map.bake_ms);
+    if (brick_map.overflow > 0) ImGui::Text("%u cells out of brick slots", brick_map.overflow);
+    for (uint32_t i = 0; data.scene_source.camera_count > 1 && i < data.scene_source.camera_count; i++) {
+        if (i > 0) ImGui::SameLine();
+        std::string label = "Camera " + std::to_string(i);
+        if (ImGui::Button(label.c_str())) apply_scene_camera(data.scene_source, i, data.camera);
+    }
+    if (!scene_resident(data)) {
+        ImGui::Text("streaming scene: %u/%u primitives", data.scene_stream.resident_primitives,
+            data.scene_source.primitive_count);
+    } else if (data.scene_source.file.data == nullptr && data.scene_primitives.size() > 1) {
+        // the cube of build_scene; moving it rebakes the cells around it
+        float height = data.scene_primitives[1].position_type[1];
+        if (ImGui::SliderFloat("Cube height", &height, 1.0f, 4.0f)) {
+            SdfPrimitive cube = data.scene_primitives[1];
+            cube.position_type[1] = height;
+            data.scene_edits.push_back({ 1, cube });
+        }
+    }
+
+    ImGui::Separator();
+    ImGui::Text("scene: %ux%u (%.0f%%), GPU %.2f ms", data.render_extent.width, data.render_extent.height,
+        data.render_scale * 100.0f, data.gpu_scene_ms);
+    ImGui::Text("transients: %.1f MiB (%.1f MiB without aliasing)", data.graph.transient_bytes / 1048576.0,
+        data.graph.unaliased_bytes / 1048576.0);
+    ImGui::Checkbox("Dynamic resolution", &data.dynamic_resolution);
+    if (data.dynamic_resolution) {
+        ImGui::SliderFloat("Min scale", &data.min_render_scale, 0.1f, 1.0f);
+    } else {
+        ImGui::SliderFloat("Render scale", &data.render_scale, 0.1f, 1.0f);
+    }
+    int tier = static_cast<int>(data.quality_tier);
+    if (ImGui::Combo("Quality", &tier, QUALITY_TIER_NAMES, static_cast<int>(QUALITY_TIER_COUNT))) {
+        data.quality_tier = static_cast<QualityTier>(tier);
+        data.quality_frames = 0;
+    }
+    ImGui::Checkbox("Auto quality", &data.auto_quality);
+    if (data.dynamic_resolution || data.auto_quality) {
+        ImGui::SliderFloat("GPU budget (ms)", &data.target_frame_ms, 1.0f, 50.0f);
+    }
+
+    ImGui::Separator();
+    int frames_in_flight = static_cast<int>(data.frames_in_flight);
+    if (ImGui::SliderInt("Frames in flight", &frames_in_flight, 1, MAX_FRAMES_IN_FLIGHT)) {
+        data.frames_in_flight = static_cast<uint32_t>(frames_in_flight);
+    }
+    // modes the surface lacks are greyed out
+    if (ImGui::BeginCombo("Present mode", present_mode_name(data.present_mode))) {
+        for (uint32_t i = 0; i < PRESENT_MODE_COUNT; i++) {
+            ImGuiSelectableFlags flags = init.present_mode_supported[i] ? 0 : ImGuiSelectableFlags_Disabled;
+            if (ImGui::Selectable(PRESENT_MODE_NAMES[i], PRESENT_MODES[i] == data.present_mode, flags)) {
+                data.present_mode = PRESENT_MODES[i];
+            }
+        }
+        ImGui::EndCombo();
+    }
+
+    if (ImGui::CollapsingHeader("Profiler", ImGuiTreeNodeFlags_DefaultOpen)) {
+        render_profiler_ui(data.profiler);
+    }
+    if (data.latency && ImGui::CollapsingHeader("Latency")) {
+        render_latency_ui(*data.latency, data.present_wait);
+    }
+    ImGui::End();
+
+    ImGui::Render();
+}
+
+void overlay_worker(Init* init, RenderData* data) {
+    OverlayRecorder& recorder = *data->overlay;
+    while (true) {
+        VkCommandBuffer cmd;
+        {
+            std::unique_lock<std::mutex> lock(recorder.mutex);
+            recorder.wake.wait(lock, [&]() { return recorder.stop || recorder.job != VK_NULL_HANDLE; });
+            if (recorder.job == VK_NULL_HANDLE) return;
+            cmd = recorder.job;
+        }
+
+        // executed inside the overlay render pass; the framebuffer is left to the
+        // primary buffer, so the swapchain image need not be known here
+        VkCommandBufferInheritanceInfo inheritance = {};
+        inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritance.renderPass = data->overlay_render_pass;
+        inheritance.subpass = 0;
+        inheritance.framebuffer = VK_NULL_HANDLE;
+
+        VkCommandBufferBeginInfo begin_info = {};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+            VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        begin_info.pInheritanceInfo = &inheritance;
+
+        bool failed = init->disp.beginCommandBuffer(cmd, &begin_info) != VK_SUCCESS;
+        if (!failed) {
+            // sets its own viewport and scissor, secondary buffers inherit no dynamic state
+            ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
+            failed = init->disp.endCommandBuffer(cmd) != VK_SUCCESS;
+        }
+        {
+            std::lock_guard<std::mutex> lock(recorder.mutex);
+            recorder.job = VK_NULL_HANDLE;
+            recorder.failed = failed;
+        }
+        recorder.finished.notify_all();
+    }
+}
+
+int start_overlay_recorder(Init& init, RenderData& data) {
+    data.overlay = std::make_unique<OverlayRecorder>();
+    OverlayRecorder& recorder = *data.overlay;
+
+    VkCommandPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.queueFamilyIndex = init.device.get_queue_index(vkb::QueueType::graphics).value();
+    pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    if (init.disp.createCommandPool(&pool_info, nullptr, &recorder.command_pool) != VK_SUCCESS) {
+        std::cout << "failed to create overlay command pool\n";
+        return -1;
+    }
+
+    VkCommandBufferAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.commandPool = recorder.command_pool;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    alloc_info.commandBufferCount = MAX_FRAMES_IN_FLIGHT;
+    if (init.disp.allocateCommandBuffers(&alloc_info, recorder.command_buffers) != VK_SUCCESS) {
+        std::cout << "failed to allocate overlay command buffers\n";
+        return -1;
+    }
+
+    recorder.worker = std::thread(overlay_worker, &init, &data);
+    return 0;
+}
+
+void stop_overlay_recorder(Init& init, RenderData& data) {
+    if (!data.overlay) return;
+    VkCommandPool command_pool = data.overlay->command_pool;
+    data.overlay.reset(); // joins the worker
+    // frees the buffers along with the pool
+    if (command_pool != VK_NULL_HANDLE) init.disp.destroyCommandPool(command_pool, nullptr);
+}
+
+// Hands the draw data of build_imgui_frame to the worker. ImGui must not be
+// touched again, nor GLFW events polled, until finish_overlay_recording.
+void begin_overlay_recording(RenderData& data) {
+    OverlayRecorder& recorder = *data.overlay;
+    {
+        std::lock_guard<std::mutex> lock(recorder.mutex);
+        recorder.job = recorder.command_buffers[data.current_frame];
+        recorder.failed = false;
+    }
+    recorder.wake.notify_one();
+}
+
+// Waits for the worker and returns the secondary buffer to execute.
+VkCommandBuffer finish_overlay_recording(RenderData& data) {
+    OverlayRecorder& recorder = *data.overlay;
+    std::unique_lock<std::mutex> lock(recorder.mutex);
+    recorder.finished.wait(lock, [&]() { return recorder.job == VK_NULL_HANDLE; });
+    if (recorder.failed) {
+        throw std::runtime_error("failed to record the overlay");
+    }
+    return recorder.command_buffers[data.current_frame];
+}
+
+VkDescriptorPool create_descriptor_pool(const Init& init)
+{
+    VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+
+    VkDescriptorPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    // the screen resources live in the bindless table; this pool only holds the
+    // scene set, the ImGui font set and a multi-view pass set
+    pool_info.maxSets = 8;
+    VkDescriptorPoolSize pool_sizes[] = {
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 8 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 8 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 8 },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 8 }
+    };
+
+    pool_info.poolSizeCount = 4;
+    pool_info.pPoolSizes = pool_sizes;
+    pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+
+    init.disp.createDescriptorPool(&pool_info, nullptr, &descriptor_pool);
+
+    return descriptor_pool;
+}
+
+// Startup cost of every pipeline creation, to compare cold and warm caches.
+void report_pipeline_startup(const Init& init, double milliseconds) {
+    std::cout << "pipelines created in " << milliseconds << " ms ("
+              << (init.pipeline_cache_warm ? "warm" : "cold") << " pipeline cache)\n";
+}
+
+// Numeric option values; a malformed or out of range one is reported instead of throwing.
+int parse_option_value(const std::string& arg, const char* value, uint32_t& out) {
+    char* end = nullptr;
+    errno = 0;
+    unsigned long parsed = std::strtoul(value, &end, 10);
+    if (end == value || *end != '\0' || !std::isdigit(static_cast<unsigned char>(value[0])) || errno == ERANGE ||
+        parsed > UINT32_MAX) {
+        std::cout << "invalid value " << value << " for " << arg << "\n";
+        return -1;
+    }
+    out = static_cast<uint32_t>(parsed);
+    return 0;
+}
+
+int parse_option_value(const std::string& arg, const char* value, double& out) {
+    char* end = nullptr;
+    errno = 0;
+    double parsed = std::strtod(value, &end);
+    if (end == value || *end != '\0' || errno == ERANGE || !std::isfinite(parsed)) {
+        std::cout << "invalid value " << value << " for " << arg << "\n";
+        return -1;
+    }
+    out = parsed;
+    return 0;
+}
+
+int parse_option_value(const std::string& arg, const char* value, float& out) {
+    double parsed = 0.0;
+    if (0 != parse_option_value(arg, value, parsed)) return -1;
+    out = static_cast<float>(parsed);
+    return 0;
+}
+
+// Unknown arguments, missing or malformed values and unknown names fail the parse.
+int parse_options(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--headless") {
+            options.headless = true;
+        } else if (arg == "--frames" && has_value) {
+            if (0 != parse_option_value(arg, argv[++i], options.frame_count)) return -1;
+        } else if (arg == "--width" && has_value) {
+            if (0 != parse_option_value(arg, argv[++i], options.width)) return -1;
+        } else if (arg == "--height" && has_value) {
+            if (0 != parse_option_value(arg, argv[++i], options.height)) return -1;
+        } else if (arg == "--output" && has_value) {
+            options.output_path = argv[++i];
+        } else if (arg == "--compute") {
+            options.compute = true;
+        } else if (arg == "--tile-size" && has_value) {
+            if (0 != parse_option_value(arg, argv[++i], options.tile_size)) return -1;
+        } else if (arg == "--no-prepass") {
+            options.depth_prepass = false;
+        } else if (arg == "--no-temporal") {
+            options.temporal = false;
+        } else if (arg == "--single-pass") {
+            options.split_passes = false;
+        } else if (arg == "--lighting-scale" && has_value) {
+            if (0 != parse_option_value(arg, argv[++i], options.lighting_scale)) return -1;
+        } else if (arg == "--checkerboard") {
+            options.checkerboard = true;
+        } else if (arg == "--orbit") {
+            options.orbit = true;
+        } else if (arg == "--render-scale" && has_value) {
+            if (0 != parse_option_value(arg, argv[++i], options.render_scale)) return -1;
+        } else if (arg == "--target-ms" && has_value) {
+            if (0 != parse_option_value(arg, argv[++i], options.target_ms)) return -1;
+        } else if (arg == "--profile-csv" && has_value) {
+            options.profile_csv = argv[++i];
+        } else if (arg == "--pipeline-cache" && has_value) {
+            options.pipeline_cache = argv[++i];
+        } else if (arg == "--no-pipeline-cache") {
+            options.pipeline_cache.clear();
+        } else if (arg == "--hot-reload") {
+            options.hot_reload = true;
+        } else if (arg == "--quality" && has_value) {
+            std::string name = argv[++i];
+            uint32_t tier = 0;
+            while (tier < QUALITY_TIER_COUNT && name != QUALITY_TIER_NAMES[tier]) tier++;
+            if (tier == QUALITY_TIER_COUNT) {
+                std::cout << "unknown quality tier " << name << "\n";
+                return -1;
+            }
+            options.quality = (QualityTier)tier;
+        } else if (arg == "--auto-quality") {
+            options.auto_quality = true;
+        } else if (arg == "--frames-in-flight" && has_value) {
+            if (0 != parse_option_value(arg, argv[++i], options.frames_in_flight)) return -1;
+        } else if (arg == "--present-mode" && has_value) {
+            std::string name = argv[++i];
+            uint32_t mode = 0;
+            while (mode < PRESENT_MODE_COUNT && name != PRESENT_MODE_NAMES[mode]) mode++;
+            if (mode == PRESENT_MODE_COUNT) {
+                std::cout << "unknown present mode " << name << "\n";
+                return -1;
+            }
+            options.present_mode = PRESENT_MODES[mode];
+        } else if (arg == "--sequence" && has_value) {
+            options.sequence_path = argv[++i];
+            options.headless = true;
+        } else if (arg == "--sequence-format" && has_value) {
+            options.sequence_format = argv[++i];
+            if (options.sequence_format != "png" && options.sequence_format != "ppm") {
+                std::cout << "unknown sequence format " << options.sequence_format << "\n";
+                return -1;
+            }
+        } else if (arg == "--readback-ring" && has_value) {
+            if (0 != parse_option_value(arg, argv[++i], options.readback_ring)) return -1;
+        } else if (arg == "--encoders" && has_value) {
+            if (0 != parse_option_value(arg, argv[++i], options.encoder_threads)) return -1;
+        } else if (arg == "--cpu") {
+            options.cpu = true;
+            options.headless = true;
+        } else if (arg == "--views" && has_value) {
+            if (0 != parse_option_value(arg, argv[++i], options.view_count)) return -1;
+        } else if (arg == "--view-fov" && has_value) {
+            if (0 != parse_option_value(arg, argv[++i], options.view_fov)) return -1;
+        } else if (arg == "--no-validation") {
+            options.validation = false;
+        } else if (arg == "--software") {
+            options.software = true;
+        } else if (arg == "--no-brick-map") {
+            options.brick_map = false;
+        } else if (arg == "--grid" && has_value) {
+            if (0 != parse_option_value(arg, argv[++i], options.grid)) return -1;
+        } else if (arg == "--scene" && has_value) {
+            options.scene_path = argv[++i];
+        } else if (arg == "--write-scene" && has_value) {
+            options.write_scene_path = argv[++i];
+        } else if (arg == "--hide-ui") {
+            options.show_ui = false;
+        } else if (arg == "--no-async-compute") {
+            options.async_compute = false;
+        } else {
+            std::cout << "unknown argument " << arg << "\n";
+            return -1;
+        }
+    }
+    if (options.width == 0 || options.height == 0) {
+        std::cout << "invalid size " << options.width << "x" << options.height << "\n";
+        return -1;
+    }
+    return 0;
+}
+
+// Everything after device_initialization that headless, multi-view and windowed
+// runs share: render settings from the options, resources and pipelines.
+int create_renderer(Init& init, RenderData& data, const Options& options, StartupTimes& startup) {
+    auto resources_start = std::chrono::steady_clock::now();
+    init.allocator = create_vma_allocator(init);
+    if (!init.headless && 0 != create_swapchain(init)) return -1;
+    if (0 != get_queues(init, data)) return -1;
+    // create descriptor pool
+    auto descriptor_pool = create_descriptor_pool(init);
+    init.descriptor_pool = descriptor_pool;
+
+    data.use_compute = options.compute;
+    // the tile is a tile_size x tile_size workgroup, so it has to fit both the
+    // per-axis and the total invocation limits
+    const VkPhysicalDeviceLimits& limits = init.device.physical_device.properties.limits;
+    uint32_t tile_size = options.tile_size > 0 ? options.tile_size : 8;
+    uint32_t max_tile = std::min(limits.maxComputeWorkGroupSize[0], limits.maxComputeWorkGroupSize[1]);
+    while (max_tile > 1 && max_tile * max_tile > limits.maxComputeWorkGroupInvocations) max_tile--;
+    if (tile_size > max_tile) {
+        std::cout << "tile size " << tile_size << " exceeds the device's compute workgroup limits ("
+                  << limits.maxComputeWorkGroupSize[0] << "x" << limits.maxComputeWorkGroupSize[1] << ", "
+                  << limits.maxComputeWorkGroupInvocations << " invocations), using " << max_tile << "\n";
+        tile_size = max_tile;
+    }
+    data.compute_tile_size = tile_size;
+    data.depth_prepass = options.depth_prepass;
+    data.temporal = options.temporal;
+    data.split_passes = options.split_passes;
+    data.lighting_scale = options.lighting_scale >= 4 ? 4 : options.lighting_scale >= 2 ? 2 : 1;
+    data.checkerboard = options.checkerboard;
+    data.orbit_camera = options.orbit;
+    data.render_scale = std::min(std::max(options.render_scale, 0.1f), 1.0f);
+    data.dynamic_resolution = options.target_ms > 0.0f;
+    if (options.target_ms > 0.0f) data.target_frame_ms = options.target_ms;
+    data.quality_tier = options.quality;
+    data.auto_quality = options.auto_quality;
+    data.use_brick_map = options.brick_map;
+    data.show_ui = options.show_ui;
+    data.async_compute = options.async_compute;
+    data.frames_in_flight = std::min(std::max(options.frames_in_flight, 1u), (uint32_t)MAX_FRAMES_IN_FLIGHT);
+    data.present_mode = init.present_mode;
+    data.present_wait = init.present_wait;
+    if (!options.sequence_path.empty()) data.readback_ring = std::max(options.readback_ring, 1u);
+
+    if (0 != create_pipeline_cache(init, options.pipeline_cache)) return -1;
+    if (0 != load_scene(options, data.scene_source)) return -1;
+    if (0 != create_scene_resources(init, data)) return -1;
+    if (0 != create_brick_map(init, data)) return -1;
+    if (0 != create_scene_descriptor_set(init, data)) return -1;
+    if (0 != create_bindless_table(init, data)) return -1;
+    if (0 != create_pipeline_layout(init, data)) return -1;
+    if (0 != create_render_pass(init, data)) return -1;
+
+    auto pipelines_start = std::chrono::steady_clock::now();
+    if (0 != create_graphics_pipeline(init, data)) return -1;
+    if (0 != create_compute_pipeline(init, data)) return -1;
+    if (0 != create_scene_compute_pipelines(init, data)) return -1;
+    if (0 != create_split_pipelines(init, data)) return -1;
+    if (0 != create_ui_blend_pipeline(init, data)) return -1;
+    std::chrono::duration<double, std::milli> pipeline_ms = std::chrono::steady_clock::now() - pipelines_start;
+    if (0 != create_output_images(init, data)) return -1;
+    if (0 != create_screen_resources(init, data)) return -1;
+    if (0 != create_command_pool(init, data)) return -1;
+    if (0 != create_command_buffers(init, data)) return -1;
+    if (0 != create_sync_objects(init, data)) return -1;
+    if (0 != create_profiler(init, data, options.profile_csv)) return -1;
+    if ((init.headless || options.view_count > 0) && 0 != finish_scene_stream(init, data)) return -1;
+    std::chrono::duration<double, std::milli> resources_ms = std::chrono::steady_clock::now() - resources_start;
+
+    startup.pipelines_ms = pipeline_ms.count();
+    startup.resources_ms = resources_ms.count() - pipeline_ms.count();
+
+    if (options.hot_reload) start_shader_reloader(init, data);
+    start_latency_tracker(init, data);
+    return 0;
+}
@@ -0,0 +1,804 @@
+// Renderer shared by the HelloWorld viewer (helloworld.cpp) and the coal_bench
+// benchmark (coal_bench.cpp): options, device and per-frame state, and the entry
+// points their mains drive. Everything is implemented in renderer.cpp, built
+// once into the coal_renderer library both executables link.
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+#include <vulkan/vulkan_core.h>
+#include <GLFW/glfw3.h>
+
+#include <VkBootstrap.h>
+#include "vk_mem_alloc.h"
+
+#include "cpu_march.h"
+#include "render_graph.h"
+
+// Per-frame resources exist for this many slots; RenderData::frames_in_flight picks
+// how many are used and can change at runtime.
+const int MAX_FRAMES_IN_FLIGHT = 4;
+
+const uint32_t PRESENT_MODE_COUNT = 3;
+const VkPresentModeKHR PRESENT_MODES[PRESENT_MODE_COUNT] = {
+    VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR
+};
+const char* const PRESENT_MODE_NAMES[PRESENT_MODE_COUNT] = { "fifo", "mailbox", "immediate" };
+
+// Ray march quality tiers, each a set of pipeline variants specialized with
+// QualitySpecialization; the driver can unroll and fold the loops per tier.
+enum QualityTier : uint32_t {
+    QUALITY_LOW,
+    QUALITY_MEDIUM,
+    QUALITY_HIGH,
+    QUALITY_ULTRA,
+    QUALITY_TIER_COUNT
+};
+const char* const QUALITY_TIER_NAMES[QUALITY_TIER_COUNT] = { "low", "medium", "high", "ultra" };
+
+const QualitySpecialization QUALITY_TIERS[QUALITY_TIER_COUNT] = {
+    { 48, 50.0f, 0.004f, 8, 4 },
+    { 72, 75.0f, 0.002f, 12, 8 },
+    { 100, 100.0f, 0.001f, 16, 16 }, // the shader defaults
+    { 160, 150.0f, 0.0005f, 32, 32 },
+};
+
+struct Options {
+    bool headless = false;
+    uint32_t width = 1280;
+    uint32_t height = 720;
+    uint32_t frame_count = 1000; // only used in headless mode
+    std::string output_path;     // headless: write the last frame as PPM
+    bool compute = false;        // ray march with the compute pipeline instead of the fullscreen quad
+    uint32_t tile_size = 8;      // compute workgroup size in pixels per side
+    uint32_t grid = 0;           // adds a grid x grid field of extra primitives to the scene
+    bool depth_prepass = true;   // seed primary rays from the coarse cone-marched depth
+    bool temporal = true;        // accumulate shadows and AO over frames (single scene pass only)
+    bool split_passes = true;    // G-buffer, shadow/AO and composite passes instead of one scene pass
+    uint32_t lighting_scale = 2; // split passes: render pixels per side of a shadow/AO sample, 1, 2 or 4
+    bool checkerboard = false;   // split passes: march half the pixels per frame, reconstruct the rest
+    bool orbit = false;          // orbit the camera around the target
+    float render_scale = 1.0f;   // fixed render scale, or the starting scale with target_ms
+    float target_ms = 0.0f;      // > 0 enables dynamic resolution with this GPU frame budget
+    std::string profile_csv;     // per-frame GPU/CPU timings as CSV
+    std::string pipeline_cache = "pipeline_cache.bin"; // empty disables the on-disk cache
+    bool hot_reload = false;     // rebuild pipelines when files in the shader source dir change
+    QualityTier quality = QUALITY_HIGH;
+    bool auto_quality = false;   // step the quality tier to hold the GPU budget (--target-ms)
+    uint32_t frames_in_flight = 2; // 1 to MAX_FRAMES_IN_FLIGHT
+    VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR; // falls back to FIFO if unsupported
+    std::string sequence_path;   // headless: write every frame as <path>_<frame>.<format>
+    std::string sequence_format = "ppm"; // ppm or png
+    uint32_t readback_ring = 8;  // readback buffers shared by the GPU and the encoders
+    uint32_t encoder_threads = 0; // 0 picks from the hardware concurrency
+    bool cpu = false;            // headless on the CPU reference marcher, no Vulkan device needed
+    uint32_t view_count = 0;     // > 0 renders a turntable of this many views in one submit and exits
+    float view_fov = 60.0f;      // vertical FOV of the turntable views, degrees
+    bool validation = true;      // request the Khronos validation layer when installed
+    bool software = false;       // prefer a CPU device such as lavapipe or SwiftShader
+    bool brick_map = true;       // march the baked brick map away from surfaces
+    std::string scene_path;      // binary scene file to map instead of the built-in scene
+    std::string write_scene_path; // write the built-in scene (with --grid) as a scene file and exit
+    bool show_ui = true;         // windowed: start with the ImGui overlay shown, F1 toggles it
+    bool async_compute = true;   // split passes: light on a separate compute queue when the device has one
+};
+
+struct Init {
+    GLFWwindow* window = nullptr;
+    vkb::Instance instance;
+    vkb::InstanceDispatchTable inst_disp;
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
+    vkb::Device device;
+    vkb::DispatchTable disp;
+    vkb::Swapchain swapchain;
+    VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+    VmaAllocator allocator = VK_NULL_HANDLE;
+
+    // shared by every pipeline, including ImGui's; persisted across launches
+    VkPipelineCache pipeline_cache = VK_NULL_HANDLE;
+    std::string pipeline_cache_path;
+    bool pipeline_cache_warm = false; // a valid cache file was loaded
+
+    VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR; // requested, then the one the swapchain uses
+    bool present_mode_supported[PRESENT_MODE_COUNT] = {};      // by the surface, for the UI
+    bool present_wait = false; // VK_KHR_present_id and VK_KHR_present_wait are enabled
+
+    // headless renders into VMA images instead of a swapchain
+    bool headless = false;
+    // size and format of the images we end up presenting or reading back
+    VkExtent2D output_extent = {};
+    VkFormat output_format = VK_FORMAT_B8G8R8A8_UNORM;
+};
+
+struct AllocatedImage {
+    VkImage image = VK_NULL_HANDLE;
+    VmaAllocation allocation = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+    VkExtent2D extent = {};
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t layers = 1; // > 1 is viewed as a 2D array
+    uint32_t depth = 1;  // > 1 is a 3D image
+};
+
+struct AllocatedBuffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VmaAllocation allocation = VK_NULL_HANDLE;
+    void* mapped = nullptr;
+    VkDeviceSize size = 0;
+};
+
+struct SceneCamera {
+    float position[4]; // xyz, w unused
+    float target[4];
+};
+
+// Used when a scene file has no lights; the original hard-coded light
+const SceneLight DEFAULT_LIGHT = { { 2.0f, 4.0f, -3.0f, 1.0f }, { 1.0f, 1.0f, 1.0f, 0.0f } };
+
+// Binary scene file (--scene, written by --write-scene): a SceneFileHeader and
+// then the primitive, light and camera arrays at the offsets it records. The
+// arrays are laid out exactly as the GPU reads them (materials are part of each
+// primitive), so a mapped file is streamed to the device without being parsed.
+const char SCENE_FILE_MAGIC[4] = { 'C', 'O', 'A', 'L' };
+const uint32_t SCENE_FILE_VERSION = 1;
+const uint64_t SCENE_FILE_ALIGNMENT = 16; // of every array offset
+
+struct SceneFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t primitive_count;
+    uint32_t light_count;
+    uint32_t camera_count;
+    uint32_t padding[3];
+    uint64_t primitive_offset; // bytes from the start of the file
+    uint64_t light_offset;
+    uint64_t camera_offset;
+    uint64_t reserved;
+};
+static_assert(sizeof(SceneFileHeader) % SCENE_FILE_ALIGNMENT == 0 && sizeof(SdfPrimitive) % SCENE_FILE_ALIGNMENT == 0 &&
+    sizeof(SceneLight) % SCENE_FILE_ALIGNMENT == 0, "arrays written back to back stay aligned");
+
+// Start of the scene buffer, followed by the primitives (SceneBuffer in shaders/scene.glsl)
+struct SceneHeader {
+    uint32_t primitive_count; // uploaded so far
+    uint32_t light_count;
+    uint32_t padding[2];
+    float brick_origin[4];    // xyz: min corner of the brick map, w: cell size
+    uint32_t brick_cells[4];  // xyz: indirection cells per axis
+};
+
+// Sparse brick map of the scene SDF (brickMapDistance in shaders/scene.glsl). A
+// grid of at most BRICK_MAP_MAX_CELLS cells per axis covers the bounded
+// primitives; cells the surface may pass through point at a BRICK_SIZE^3 brick
+// of distance samples in the atlas, the others store their center distance.
+const uint32_t BRICK_SIZE = 8;              // samples per side; neighbouring bricks share their border samples
+const uint32_t BRICK_MAP_MAX_CELLS = 32;    // per axis
+const uint32_t BRICK_ATLAS_BRICKS = 32;     // bricks per atlas row and column
+const uint32_t BRICK_EMPTY = 0x80000000u;   // entry without a brick, low bits = center distance
+const float BRICK_DISTANCE_SCALE = 1024.0f; // fixed point scale of empty entries
+const float BRICK_MAP_PADDING = 1.0f;       // baked around the bounded primitives, covers AO probes
+const VkFormat BRICK_ATLAS_FORMAT = VK_FORMAT_R16_SFLOAT; // linear filtering is mandatory for it
+
+// Work-stealing pool for CPU tiles and brick bakes. Every run seeds each
+// worker's deque with a contiguous range of tiles; owners pop from the front
+// and, once empty, steal from the back of the others, so uneven tiles (sky
+// versus geometry) still keep every core busy.
+struct CpuTilePool {
+    struct Queue {
+        std::mutex mutex;
+        std::deque<uint32_t> tiles;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::mutex mutex;
+    std::condition_variable start;
+    std::condition_variable done;
+    std::function<void(uint32_t)> job; // guarded by mutex
+    uint64_t generation = 0;           // guarded by mutex
+    uint32_t busy = 0;                 // guarded by mutex
+    bool stop = false;                 // guarded by mutex
+    std::atomic<uint64_t> steals{ 0 };
+
+    ~CpuTilePool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        start.notify_all();
+        for (auto& worker : workers) {
+            if (worker.joinable()) worker.join();
+        }
+    }
+};
+
+// Bricks, indirection and primitive edits recorded by the next frame's upload pass
+struct BrickUpload {
+    AllocatedBuffer staging; // brick samples, then the entries of the baked cells
+    std::vector<VkBufferImageCopy> bricks;
+    std::vector<VkBufferImageCopy> indirection; // one per run of baked cells along x
+    std::vector<std::pair<uint32_t, SdfPrimitive>> primitives; // written into the scene buffer
+};
+
+struct BrickMap {
+    float origin[3] = {};
+    float cell_size = 1.0f;
+    uint32_t cells[3] = { 1, 1, 1 };
+    std::vector<uint32_t> entries;      // indirection grid, x fastest
+    std::vector<float> center_distance; // exact scene SDF at every cell center
+    std::vector<uint32_t> free_bricks;  // unused atlas slots
+    uint32_t capacity = 0;              // atlas slots
+    uint32_t overflow = 0;              // cells of the last bake left to the analytic SDF for lack of a slot
+    AllocatedImage indirection;         // R32_UINT
+    AllocatedImage atlas;               // BRICK_ATLAS_FORMAT, BRICK_ATLAS_BRICKS^2 bricks per layer of bricks
+    VkSampler sampler = VK_NULL_HANDLE;
+    std::vector<BrickUpload> pending;
+    CpuTilePool baker;        // started by create_brick_map, reused by every rebake
+    double bake_ms = 0.0;     // last bake or rebake
+    uint32_t baked_cells = 0; // cells it revisited
+};
+
+// Read-only view of a whole file
+struct MappedFile {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+};
+
+// Arrays of the scene being rendered: views into a mapped scene file, or the
+// built-in scene of build_scene. Not copyable once it points into itself.
+struct SceneSource {
+    MappedFile file;
+    std::vector<SdfPrimitive> built_primitives;
+    std::vector<SceneLight> built_lights;
+    std::vector<SceneCamera> built_cameras;
+    const SdfPrimitive* primitives = nullptr;
+    const SceneLight* lights = nullptr;
+    const SceneCamera* cameras = nullptr;
+    uint32_t primitive_count = 0;
+    uint32_t light_count = 0;
+    uint32_t camera_count = 0;
+};
+
+// Persistently mapped upload buffer used as a ring. head and tail count bytes
+// ever allocated and released, so head - tail is the space still in flight;
+// each frame's allocations are released once frame_timeline passes that frame.
+const VkDeviceSize STAGING_RING_SIZE = 8u << 20;
+const VkDeviceSize STAGING_RING_ALIGNMENT = 16;
+struct StagingRing {
+    AllocatedBuffer buffer;
+    VkDeviceSize head = 0;
+    VkDeviceSize tail = 0;
+    std::deque<std::pair<uint64_t, VkDeviceSize>> frames; // frame number, head once it was recorded
+};
+
+// Persistently mapped uniform data, one FRAME_UNIFORM_SLICE_SIZE slice per frame
+// in flight. While a frame is recorded it sub-allocates linearly from its slot's
+// slice and binds what it wrote with dynamic offsets; the slice is rewritten only
+// after wait_for_frame_slot has seen the slot's previous frame complete, so
+// per-frame data needs no allocation, mapping or stall.
+const VkDeviceSize FRAME_UNIFORM_SLICE_SIZE = 64u << 10;
+struct FrameUniforms {
+    AllocatedBuffer buffer;
+    VkDeviceSize alignment = 256; // minUniformBufferOffsetAlignment
+    VkDeviceSize slice_start = 0;
+    VkDeviceSize head = 0; // bytes used in the current slice
+};
+
+// Progress of streaming the scene source into scene_buffer and light_buffer.
+// Every frame copies up to SCENE_STREAM_BYTES_PER_FRAME of it into the staging
+// ring and the upload pass copies that on to the device-local buffers.
+const VkDeviceSize SCENE_STREAM_BYTES_PER_FRAME = 2u << 20;
+struct SceneStream {
+    uint32_t resident_primitives = 0; // copied by recorded upload passes or queued in copies
+    bool lights_resident = false;
+    bool header_dirty = true; // scene_header changed since the last upload pass
+    std::vector<VkBufferCopy> primitive_copies; // ring to scene_buffer, for the next upload pass
+    std::vector<VkBufferCopy> light_copies;     // ring to light_buffer
+};
+
+// Per-frame uniforms shared by every scene pipeline (FrameConstants in shaders/scene.glsl),
+// written to the frame uniform ring once per frame
+struct FrameConstants {
+    float camera_position[4];
+    float camera_target[4];
+    float prev_camera_position[4];
+    float prev_camera_target[4];
+    uint32_t resolution[2];      // render extent
+    uint32_t prev_resolution[2]; // render extent of the frame that wrote the history
+    uint32_t frame_index;
+    uint32_t flags;
+    uint32_t frame_slot;
+    uint32_t lighting_scale; // render pixels per side of a shadow/AO sample in the split passes
+    uint32_t checker_phase;  // which half of the checkerboard is marched this frame
+    uint32_t padding[3];
+};
+static_assert(sizeof(FrameConstants) % 16 == 0, "FrameConstants is a std140 uniform block");
+
+// One camera of a batched multi-view render (View in shaders/multiview.comp)
+struct ViewCamera {
+    float position[4]; // xyz: eye, w: vertical FOV in radians
+    float target[4];   // xyz: look-at point
+};
+
+// FrameConstants::flags, must match shaders/scene.glsl
+const uint32_t FRAME_FLAG_DEPTH_PREPASS = 1u << 0;
+const uint32_t FRAME_FLAG_STEP_STATS = 1u << 1;
+const uint32_t FRAME_FLAG_STEP_HEATMAP = 1u << 2;
+const uint32_t FRAME_FLAG_TEMPORAL = 1u << 3;
+const uint32_t FRAME_FLAG_HISTORY_VALID = 1u << 4;
+const uint32_t FRAME_FLAG_BRICK_MAP = 1u << 5;
+const uint32_t FRAME_FLAG_CHECKERBOARD = 1u << 6;
+const uint32_t FRAME_FLAG_CHECKER_HISTORY = 1u << 7;
+
+// Intermediate color format of the scene pass; storage-capable on every device
+const VkFormat SCENE_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+
+// Culling pre-pass tiling, must match shaders/scene.glsl
+const uint32_t CULL_TILE_SIZE = 16;
+const uint32_t MAX_TILE_PRIMITIVES = 63;
+
+// Coarse depth pre-pass block size, must match shaders/scene.glsl
+const uint32_t PREPASS_BLOCK_SIZE = 8;
+
+// Bindless resource table, set 1 of every scene pipeline (shaders/bindless.glsl).
+// Each binding is an array of its descriptor type; a resource takes a slot when
+// it is created and keeps it until it is destroyed. The set is update-after-bind,
+// so slots are written while earlier frames still have it bound.
+enum BindlessKind : uint32_t {
+    BINDLESS_STORAGE_IMAGE,  // binding 0
+    BINDLESS_SAMPLED_IMAGE,  // binding 1
+    BINDLESS_STORAGE_BUFFER, // binding 2
+    BINDLESS_KIND_COUNT
+};
+const uint32_t BINDLESS_CAPACITY[BINDLESS_KIND_COUNT] = { 64, 16, 16 }; // must match shaders/bindless.glsl
+const VkDescriptorType BINDLESS_DESCRIPTOR_TYPES[BINDLESS_KIND_COUNT] = {
+    VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+};
+
+struct BindlessTable {
+    VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    uint32_t used[BINDLESS_KIND_COUNT] = {}; // slots handed out so far
+    std::vector<uint32_t> free_slots[BINDLESS_KIND_COUNT]; // released once no frame could still read them
+};
+
+// Table slots of the frame's resources, pushed as push constants once per command
+// buffer (BindlessIndices in shaders/bindless.glsl, same order)
+struct BindlessIndices {
+    uint32_t tile_lists = UINT32_MAX;
+    uint32_t coarse_depth = UINT32_MAX;
+    uint32_t history[2] = { UINT32_MAX, UINT32_MAX };
+    uint32_t gbuffer_normal_depth = UINT32_MAX;
+    uint32_t gbuffer_material = UINT32_MAX;
+    uint32_t shadow_ao = UINT32_MAX;
+    uint32_t scene_target = UINT32_MAX;
+    uint32_t checker_history[2] = { UINT32_MAX, UINT32_MAX };
+    uint32_t ui_layer = UINT32_MAX;
+};
+static_assert(sizeof(BindlessIndices) == 11 * sizeof(uint32_t), "BindlessIndices is a push constant block");
+
+// GPU passes timed with a timestamp pair each, in recording order
+enum GpuScope : uint32_t {
+    GPU_SCOPE_UPLOAD,
+    GPU_SCOPE_CULL,
+    GPU_SCOPE_PREPASS,
+    GPU_SCOPE_SCENE,
+    GPU_SCOPE_GBUFFER,
+    GPU_SCOPE_LIGHTING,
+    GPU_SCOPE_COMPOSITE,
+    GPU_SCOPE_RECONSTRUCT,
+    GPU_SCOPE_UPSCALE,
+    GPU_SCOPE_OVERLAY,
+    GPU_SCOPE_READBACK,
+    GPU_SCOPE_COUNT
+};
+const char* const GPU_SCOPE_NAMES[GPU_SCOPE_COUNT] = { "upload", "cull", "prepass", "scene", "gbuffer", "lighting",
+    "composite", "reconstruct", "upscale", "overlay", "readback" };
+
+// CPU side of draw_frame; waits are included so CPU- vs GPU-bound is visible
+enum CpuScope : uint32_t {
+    CPU_SCOPE_FRAME_WAIT,
+    CPU_SCOPE_ACQUIRE,
+    CPU_SCOPE_RECORD,
+    CPU_SCOPE_SUBMIT,
+    CPU_SCOPE_PRESENT,
+    CPU_SCOPE_COUNT
+};
+const char* const CPU_SCOPE_NAMES[CPU_SCOPE_COUNT] = { "frame_wait", "acquire", "record", "submit", "present" };
+
+const uint32_t PROFILER_HISTORY = 240; // frames kept for the ImGui graphs
+
+// Per-frame timings. Each frame in flight owns a query pool and a set of CPU
+// timings; both are collected once that slot's frame has completed, so reading
+// the queries never stalls.
+struct Profiler {
+    bool gpu_timestamps = false;   // graphics queue reports valid timestamp bits
+    float timestamp_period = 1.0f; // nanoseconds per tick
+    std::vector<VkQueryPool> query_pools;
+    std::vector<uint32_t> written_scopes; // GpuScope bit mask per slot
+    std::vector<uint64_t> slot_frame;     // frame number recorded into each slot, 0 if none
+    std::vector<VkExtent2D> slot_extent;  // render extent of that frame
+    std::vector<std::vector<float>> slot_cpu_ms;
+
+    // latest collected frame
+    uint64_t frame = 0;
+    float gpu_ms[GPU_SCOPE_COUNT] = {};
+    float cpu_ms[CPU_SCOPE_COUNT] = {};
+    float gpu_total_ms = 0.0f;
+    float cpu_total_ms = 0.0f; // excluding the frame wait
+
+    // ring of gpu scopes, cpu scopes, then the two totals
+    std::vector<float> history[GPU_SCOPE_COUNT + CPU_SCOPE_COUNT + 2];
+    uint32_t history_head = 0;
+
+    std::ofstream csv;
+};
+
+// Every pipeline built from files in shaders/; swapped as a unit on hot reload.
+struct ShaderPipelines {
+    VkPipeline graphics[QUALITY_TIER_COUNT] = {};
+    VkPipeline raymarch[QUALITY_TIER_COUNT] = {};
+    VkPipeline prepass[QUALITY_TIER_COUNT] = {};
+    VkPipeline gbuffer[QUALITY_TIER_COUNT] = {};
+    VkPipeline lighting[QUALITY_TIER_COUNT] = {};
+    VkPipeline composite[QUALITY_TIER_COUNT] = {};
+    VkPipeline reconstruct[QUALITY_TIER_COUNT] = {};
+    VkPipeline cull = VK_NULL_HANDLE; // only depends on EPSILON, built with the largest one
+    VkPipeline ui_blend = VK_NULL_HANDLE; // the ImGui layer onto the output image
+};
+
+// Pipelines swapped out at a frame boundary; destroyed once every frame that
+// may have recorded them has completed.
+struct RetiredPipelines {
+    ShaderPipelines pipelines;
+    uint64_t last_frame;
+};
+
+// Watches the shader sources on a worker thread, recompiles and builds a new
+// pipeline set off the render loop and hands it over through `pending`.
+struct ShaderReloader {
+    std::thread worker;
+    std::atomic<bool> stop{ false };
+    std::mutex mutex;
+    bool ready = false;     // guarded by mutex
+    ShaderPipelines pending; // guarded by mutex
+    std::vector<RetiredPipelines> retired;
+
+    ~ShaderReloader() {
+        stop = true;
+        if (worker.joinable()) worker.join();
+    }
+};
+
+enum LatencyStage : uint32_t {
+    LATENCY_SUBMIT,  // input to queue submission
+    LATENCY_GPU,     // input to the frame's GPU work completing
+    LATENCY_PRESENT, // input to present completion, needs present wait
+    LATENCY_STAGE_COUNT
+};
+
+const char* const LATENCY_STAGE_NAMES[LATENCY_STAGE_COUNT] = { "input to submit", "input to GPU done", "input to present" };
+
+const uint32_t LATENCY_HISTORY = 240;
+
+// A submitted frame the latency worker has yet to see complete.
+struct LatencySample {
+    uint64_t frame;
+    std::chrono::steady_clock::time_point input; // right after glfwPollEvents
+    std::chrono::steady_clock::time_point submit;
+    VkSwapchainKHR swapchain; // null when there is no present to wait for
+};
+
+// Measures input-to-photon latency off the render loop: a worker waits for each
+// frame's timeline value, then for its present id, and stamps both completions.
+struct LatencyTracker {
+    std::thread worker;
+    std::atomic<bool> stop{ false };
+    std::mutex mutex;
+    std::condition_variable wake;     // new samples or stop
+    std::condition_variable released; // the worker stopped waiting on a swapchain
+    std::deque<LatencySample> pending;          // guarded by mutex
+    VkSwapchainKHR waiting_on = VK_NULL_HANDLE; // guarded by mutex
+    VkSwapchainKHR retiring = VK_NULL_HANDLE;   // guarded by mutex
+    std::mutex present_mutex; // held around every call that uses the swapchain
+
+    // guarded by mutex
+    float latest_ms[LATENCY_STAGE_COUNT] = {};
+    double total_ms[LATENCY_STAGE_COUNT] = {};
+    uint64_t count[LATENCY_STAGE_COUNT] = {};
+    std::vector<float> history[LATENCY_STAGE_COUNT];
+    uint32_t history_head = 0;
+
+    ~LatencyTracker() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        if (worker.joinable()) worker.join();
+    }
+};
+
+// Records the ImGui overlay into a secondary command buffer while the main thread
+// records the frame's primary one. The widgets are still built on the main
+// thread, they edit RenderData and ImGui reads GLFW input; only the draw data,
+// which stays untouched until the next ImGui::NewFrame, crosses over.
+struct OverlayRecorder {
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;     // a job or stop
+    std::condition_variable finished; // the job's command buffer is recorded
+    VkCommandBuffer job = VK_NULL_HANDLE; // guarded by mutex, null once recorded
+    bool failed = false;                  // guarded by mutex
+    bool stop = false;                    // guarded by mutex
+
+    // the pool belongs to the worker; one secondary buffer per frame slot, reused
+    // like the primary buffer of that slot once its frame has finished
+    VkCommandPool command_pool = VK_NULL_HANDLE;
+    VkCommandBuffer command_buffers[MAX_FRAMES_IN_FLIGHT] = {};
+
+    ~OverlayRecorder() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        if (worker.joinable()) worker.join();
+    }
+};
+
+// A finished-or-soon-finished frame waiting in a readback buffer to be written out.
+struct EncodeJob {
+    uint32_t buffer;   // index into RenderData::readback_buffers
+    uint64_t frame;    // timeline value after which the copy is complete
+    uint32_t sequence; // file number
+};
+
+// Offline sequence output: readback buffers circulate between the render thread,
+// which copies frames into free ones, and a pool of threads that encode them.
+// Running out of free buffers blocks the render thread, so slow disks apply
+// back-pressure instead of growing a queue.
+struct EncoderPool {
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable work;  // jobs queued or stop
+    std::condition_variable freed; // a buffer went back to free_buffers
+    std::deque<EncodeJob> jobs;          // guarded by mutex
+    std::vector<uint32_t> free_buffers;  // guarded by mutex
+    bool stop = false;                   // guarded by mutex
+    std::atomic<bool> failed{ false };
+
+    std::string path;
+    std::string format;
+    VkExtent2D extent = {};
+    VkFormat pixel_format = VK_FORMAT_UNDEFINED;
+
+    // guarded by mutex
+    uint32_t next_sequence = 0;
+    double encode_ms = 0.0;
+    uint64_t encoded = 0;
+
+    ~EncoderPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        work.notify_all();
+        for (auto& worker : workers) {
+            if (worker.joinable()) worker.join();
+        }
+    }
+};
+
+// Destruction of an object that frames in flight may still use; runs once the
+// last frame recorded before it was queued has completed.
+struct DeferredDestroy {
+    uint64_t last_frame;
+    std::function<void()> destroy;
+};
+
+struct RenderData {
+    VkQueue graphics_queue;
+    VkQueue present_queue;
+    VkQueue compute_queue = VK_NULL_HANDLE; // separate family only
+    bool compute_timestamps = false;        // the compute family supports timestamp queries
+    bool async_compute = true;              // run the lighting pass on compute_queue when there is one
+
+    std::vector<VkImage> swapchain_images;
+    std::vector<VkImageView> swapchain_image_views;
+
+    // headless: one color target per frame in flight; one readback buffer each,
+    // or a ring of readback_ring when writing a sequence
+    std::vector<AllocatedImage> offscreen_images;
+    std::vector<AllocatedBuffer> readback_buffers;
+    uint32_t readback_ring = 0;
+    uint32_t readback_slot = 0; // buffer the frame being recorded copies into
+    std::unique_ptr<EncoderPool> encoders;
+    double readback_stall_ms = 0.0; // render thread blocked on the encoders
+
+    // passes, barriers and transient images of a frame; rebuilt every draw
+    RenderGraph graph;
+
+    VkRenderPass render_pass;         // scene pass into scene_target, owned by the graph
+    VkRenderPass overlay_render_pass; // ImGui on top of the upscaled scene in the output image
+    // every scene pipeline: set 0 = scene set, set 1 = bindless table, push constants = bindless_indices
+    VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+    BindlessTable bindless;
+    BindlessIndices bindless_indices;
+
+    // every tier of the scene pipelines; quality_tier picks the bound variant
+    ShaderPipelines pipelines;
+    QualityTier quality_tier = QUALITY_HIGH;
+    bool auto_quality = false;
+    uint32_t quality_frames = 0; // frames since the last automatic tier change
+    float quality_pressure = 0.0f; // smoothed GPU time over the budget, > 0 when too slow
+
+    // the scene is marched at render_extent into the top-left corner of
+    // scene_target (allocated at the output size) and then upscaled into the
+    // output image before the ImGui pass
+    uint32_t scene_target = 0; // graph transient
+    VkExtent2D render_extent = {};
+    VkExtent2D previous_render_extent = {};
+
+    // dynamic resolution: render_scale follows measured GPU scene time
+    bool dynamic_resolution = false;
+    float render_scale = 1.0f;
+    float min_render_scale = 0.25f;
+    float target_frame_ms = 16.6f;
+    float gpu_scene_ms = 0.0f; // cull + pre-pass + scene (or the split passes) from the profiler
+
+    // compute ray march path: tiles are marched straight into scene_target
+    bool use_compute = false;
+    uint32_t compute_tile_size = 8;
+
+    // split scene passes, compute only: a primary march into the G-buffer, shadow
+    // and AO once per lighting_scale x lighting_scale block, then a composite that
+    // upsamples them bilaterally and shades at full resolution
+    bool split_passes = true;
+    uint32_t lighting_scale = 2; // 1, 2 or 4
+    uint32_t gbuffer_normal_depth = 0; // graph transient
+    uint32_t gbuffer_material = 0;     // graph transient
+    uint32_t shadow_ao = 0;            // graph transient
+
+    // checkerboard rendering on the split passes: every frame the G-buffer pass
+    // marches the pixels of one parity and the reconstruct pass fills the others
+    // from the reprojected color history and their marched neighbours. The
+    // history (rgb: color, a: hit distance) is ping-ponged like the shadow/AO one.
+    bool checkerboard = false;
+    AllocatedImage checker_history[2];
+    uint32_t checker_frames = 0; // frames written into the current checker history
+
+    // scene primitives and the per-tile lists built by the culling pre-pass
+    VkDescriptorSetLayout scene_set_layout = VK_NULL_HANDLE;
+    VkDescriptorSet scene_set = VK_NULL_HANDLE;
+    AllocatedBuffer scene_buffer; // device local, filled by stream_scene
+    AllocatedBuffer light_buffer;
+    AllocatedBuffer tile_list_buffer;
+    SceneSource scene_source;
+    SceneHeader scene_header = {};
+    StagingRing staging_ring;
+    SceneStream scene_stream;
+    FrameUniforms frame_uniforms;
+    uint32_t frame_constants_offset = 0; // this frame's FrameConstants in frame_uniforms
+    std::vector<SdfPrimitive> scene_primitives; // what scene_buffer holds once pending uploads are recorded
+    std::vector<std::pair<uint32_t, SdfPrimitive>> scene_edits; // applied before the next frame is recorded
+
+    // baked SDF sampled instead of the primitives away from surfaces
+    bool use_brick_map = true;
+    BrickMap brick_map;
+    uint32_t frame_index = 0;
+
+    // coarse cone-marched depth that seeds the full resolution rays
+    bool depth_prepass = true;
+    uint32_t coarse_depth = 0; // graph transient
+
+    // debug: march step counters, one slot per frame in flight, read back once the slot is free
+    bool step_stats = false;
+    bool step_heatmap = false;
+    AllocatedBuffer step_counters;
+    float average_steps = 0.0f;
+
+    Camera camera = { { 0.0f, 5.0f, -5.0f }, { 0.0f, 1.0f, 0.0f } };
+    Camera previous_camera = camera;
+    bool orbit_camera = false;
+    float camera_angle = 0.0f;
+
+    // shadow/AO history, ping-ponged by frame index; only recreated when the
+    // output size changes, so it survives recreate_swapchain
+    bool temporal = true;
+    AllocatedImage history[2];
+    uint32_t history_frames = 0; // frames accumulated into the current history
+
+    VkCommandPool command_pool;
+    std::vector<VkCommandBuffer> command_buffers; // one per frame in flight, reset when re-recorded
+    // render graph batches after the first, per queue and frame in flight
+    VkCommandPool compute_command_pool = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> batch_command_buffers[RG_QUEUE_COUNT][MAX_FRAMES_IN_FLIGHT];
+
+    // the last submission of a frame signals frame_timeline with its frame
+    // number; the binary semaphores only link acquire and present. Batches
+    // within a frame wait for the other queue on its queue timeline.
+    VkSemaphore frame_timeline = VK_NULL_HANDLE;
+    VkSemaphore queue_timelines[RG_QUEUE_COUNT] = {};
+    uint64_t queue_timeline_values[RG_QUEUE_COUNT] = {};
+    std::vector<VkSemaphore> available_semaphores;
+    std::vector<VkSemaphore> finished_semaphore;
+    uint32_t frames_in_flight = 2;
+    VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR; // picked in the UI, applied next frame
+    bool present_wait = false; // present latency can be measured
+    size_t current_frame = 0;
+    uint64_t frame_number = 0;                // frames recorded so far
+    std::vector<uint64_t> slot_frame_number;  // frame last recorded in each slot
+    uint64_t completed_frames = 0;            // every frame up to this one has finished on the GPU
+    std::vector<DeferredDestroy> deferred_destroys;
+
+    std::unique_ptr<ShaderReloader> shader_reloader;
+
+    std::chrono::steady_clock::time_point input_time; // events polled for the frame being recorded
+    std::unique_ptr<LatencyTracker> latency;
+
+    bool show_ui = true; // F1; a hidden UI skips the widgets and the overlay pass
+    std::unique_ptr<OverlayRecorder> overlay;
+    // with async compute the overlay goes into this premultiplied layer while the
+    // lighting pass runs, and is blended onto the output after the upscale
+    uint32_t ui_layer = 0; // graph transient, windowed only
+
+    Profiler profiler;
+};
+
+// Wall time of the startup phases; coal_bench reports all of them
+struct StartupTimes {
+    double device_ms = 0.0;    // instance, physical device selection and logical device
+    double resources_ms = 0.0; // allocator, scene, images, command buffers, sync and profiler
+    double pipelines_ms = 0.0; // every pipeline, cold or warm depending on the pipeline cache
+};
+
+// Options
+int parse_option_value(const std::string& arg, const char* value, uint32_t& out);
+int parse_option_value(const std::string& arg, const char* value, double& out);
+int parse_option_value(const std::string& arg, const char* value, float& out);
+int parse_options(int argc, char** argv, Options& options);
+
+// Scenes
+int load_scene(const Options& options, SceneSource& scene);
+int write_scene_file(const std::string& path, const SceneSource& scene);
+void unmap_file(MappedFile& file);
+
+// Setup and teardown
+int device_initialization(Init& init, const Options& options);
+int create_renderer(Init& init, RenderData& data, const Options& options, StartupTimes& startup);
+void report_pipeline_startup(const Init& init, double milliseconds);
+void init_imgui(const Init& init, const RenderData& data);
+int start_overlay_recorder(Init& init, RenderData& data);
+void cleanup(Init& init, RenderData& data);
+
+// Running
+int draw_frame(Init& init, RenderData& data);
+int draw_frame_headless(Init& init, RenderData& data);
+int run_headless(Init& init, RenderData& data, const Options& options);
+int run_sequence(Init& init, RenderData& data, const Options& options);
+int run_multiview(Init& init, RenderData& data, const Options& options);
+int run_cpu_reference(const Options& options);
@@ -0,0 +1,36 @@
+// Set 1 of every scene pipeline: the bindless resource table (BindlessTable in
+// renderer.h). Binding 0 holds the storage images, declared once per format
+// below, binding 1 the sampled images and binding 2 the storage buffers. A
+// resource keeps its slot for as long as it exists; shaders find it through the
+// indices pushed once per command buffer. Keep the capacities and BindlessIndices
+// in sync with renderer.h.
+#ifndef BINDLESS_GLSL
+#define BINDLESS_GLSL
+
+const uint BINDLESS_STORAGE_IMAGES = 64u;
+const uint BINDLESS_SAMPLED_IMAGES = 16u;
+const uint BINDLESS_STORAGE_BUFFERS = 16u;
+
+layout(set = 1, binding = 0, rgba8) uniform image2D bindlessRgba8[BINDLESS_STORAGE_IMAGES];
+layout(set = 1, binding = 0, rgba16f) uniform image2D bindlessRgba16f[BINDLESS_STORAGE_IMAGES];
+layout(set = 1, binding = 0, rgba32f) uniform image2D bindlessRgba32f[BINDLESS_STORAGE_IMAGES];
+layout(set = 1, binding = 0, r32ui) uniform uimage2D bindlessR32ui[BINDLESS_STORAGE_IMAGES];
+
+layout(set = 1, binding = 1) uniform texture2D bindlessTextures[BINDLESS_SAMPLED_IMAGES];
+
+// Slots of the frame's resources; unused ones may hold anything
+layout(push_constant) uniform BindlessIndices {
+    uint tileLists;
+    uint coarseDepth;
+    uint historyA;
+    uint historyB;
+    uint gbufferNormalDepth;
+    uint gbufferMaterial;
+    uint shadowAo;
+    uint sceneTarget;
+    uint checkerHistoryA;
+    uint checkerHistoryB;
+    uint uiLayer;
+} indices;
+
+#endif
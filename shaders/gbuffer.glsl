@@ -0,0 +1,52 @@
+// Images of the split passes: gbuffer.comp, lighting.comp, composite.comp and
+// reconstruct.comp, all in the bindless table (bindless.glsl).
+
+// Primary hits: xyz = normal, w = distance along the ray (MAX_DIST for the sky)
+#define gbufferNormalDepth bindlessRgba32f[indices.gbufferNormalDepth]
+
+// Index of the primitive hit, or GBUFFER_HEATMAP
+#define gbufferMaterial bindlessR32ui[indices.gbufferMaterial]
+
+// x = key light shadow, y = AO; one sample per lightingScale x lightingScale block
+#define shadowAo bindlessRgba16f[indices.shadowAo]
+
+// scene_target
+#define outImage bindlessRgba8[indices.sceneTarget]
+
+// Checkerboard history ping-pong, same pattern as historyA/B: rgb = color, a = hit distance
+#define checkerHistoryA bindlessRgba16f[indices.checkerHistoryA]
+#define checkerHistoryB bindlessRgba16f[indices.checkerHistoryB]
+
+// the G-buffer pass already stored the step heatmap in outImage
+const uint GBUFFER_HEATMAP = 0xffffffffu;
+// not marched this frame, filled in by reconstruct.comp
+const uint GBUFFER_SKIPPED = 0xfffffffeu;
+
+// Pixels of the half of the checkerboard that is not marched this frame
+bool checkerSkipped(ivec2 pixel) {
+    return (frame.flags & FLAG_CHECKERBOARD) != 0u && ((uint(pixel.x + pixel.y) + frame.checkerPhase) & 1u) != 0u;
+}
+
+// Screen position of a pixel center; matches the fragment path (y flipped)
+vec2 pixelUV(ivec2 pixel) {
+    vec2 fragUV = (vec2(pixel) + 0.5) / vec2(frame.resolution);
+    fragUV.y = 1.0 - fragUV.y;
+    return fragUV;
+}
+
+// Shadow/AO blocks covering the render extent
+ivec2 lightingBlocks() {
+    int scale = int(frame.lightingScale);
+    return (ivec2(frame.resolution) + scale - 1) / scale;
+}
+
+// Full resolution pixel whose G-buffer sample a shadow/AO block is lit from: its
+// center, or the marched pixel next to it on a checkerboard frame
+ivec2 lightingSamplePixel(ivec2 block) {
+    int scale = int(frame.lightingScale);
+    ivec2 pixel = min(block * scale + scale / 2, ivec2(frame.resolution) - 1);
+    if (checkerSkipped(pixel)) {
+        pixel.x += pixel.x + 1 < int(frame.resolution.x) ? 1 : -1;
+    }
+    return pixel;
+}
@@ -0,0 +1,540 @@
+// Scene description and ray marching shared by main.frag, raymarch.comp, multiview.comp,
+// cull.comp, prepass.comp and the split G-buffer passes
+
+#include "bindless.glsl"
+
+// Quality tier, specialized per pipeline variant from QUALITY_TIERS in
+// renderer.h (ids 0 and 1 are the compute tile size). Defaults are "high".
+layout(constant_id = 10) const int MAX_STEPS = 100;
+layout(constant_id = 11) const float MAX_DIST = 100.0;
+layout(constant_id = 12) const float EPSILON = 0.001;
+layout(constant_id = 13) const int SHADOW_STEPS = 16;
+layout(constant_id = 14) const int AO_SAMPLES = 16; // multiple of AO_TEMPORAL_SAMPLES
+
+// Adjustable Field of View (in degrees)
+const float FOV_DEGREES = 60.0; // You can adjust this value (e.g., 45.0, 90.0)
+const float FOV = radians(FOV_DEGREES); // Convert to radians
+
+// Ambient occlusion probes this far along the normal
+const float AO_MAX_DISTANCE = 0.5;
+
+// Primitive types, keep in sync with SdfPrimitiveType in cpu_march.h
+const uint PRIM_PLANE = 0u;
+const uint PRIM_BOX = 1u;
+const uint PRIM_SPHERE = 2u;
+
+// Frame flags, keep in sync with FRAME_FLAG_* in renderer.h
+const uint FLAG_DEPTH_PREPASS = 1u;
+const uint FLAG_STEP_STATS = 2u;
+const uint FLAG_STEP_HEATMAP = 4u;
+const uint FLAG_TEMPORAL = 8u;
+const uint FLAG_HISTORY_VALID = 16u;
+const uint FLAG_BRICK_MAP = 32u;
+const uint FLAG_CHECKERBOARD = 64u;
+const uint FLAG_CHECKER_HISTORY = 128u;
+
+// Temporal accumulation of shadows and AO
+const int AO_TEMPORAL_SAMPLES = 4;                  // per frame, AO_SAMPLES / AO_TEMPORAL_SAMPLES frames per full set
+const int SHADOW_TEMPORAL_STEPS = SHADOW_STEPS / 2; // longer, jittered steps instead of SHADOW_STEPS short ones
+const float MAX_HISTORY = 16.0;        // frames blended before the history stops gaining weight
+const float HISTORY_DEPTH_TOLERANCE = 0.02;
+
+// Pixels per side of a coarse depth pre-pass block; divides CULL_TILE_SIZE
+const uint PREPASS_BLOCK_SIZE = 8u;
+
+// Screen tiles used by the culling pre-pass
+const uint CULL_TILE_SIZE = 16u;
+const uint MAX_TILE_PRIMITIVES = 63u;
+const uint TILE_STRIDE = MAX_TILE_PRIMITIVES + 1u; // count followed by indices
+
+struct Primitive {
+    vec4 positionType; // xyz: center, w: type
+    vec4 params;       // box: half extents, sphere: x = radius, plane: xyz = normal, w = offset
+    vec4 material;     // rgb: albedo, w: 1 for a checkerboard pattern
+};
+
+// Streamed in from the scene file (SceneHeader in renderer.h); primitiveCount
+// only covers primitives that have finished uploading
+layout(std430, set = 0, binding = 0) readonly buffer SceneBuffer {
+    uint primitiveCount;
+    uint lightCount;
+    vec4 brickOrigin; // xyz: min corner of the brick map, w: cell size
+    uvec4 brickCells; // xyz: indirection cells per axis
+    Primitive primitives[];
+};
+
+// Point lights; the first one casts the shadows and is always present
+struct Light {
+    vec4 position; // xyz: position, w: intensity
+    vec4 color;    // rgb
+};
+
+layout(std430, set = 0, binding = 8) readonly buffer LightBuffer {
+    Light lights[];
+};
+
+#ifndef TILE_LIST_ACCESS
+#define TILE_LIST_ACCESS readonly
+#endif
+layout(std430, set = 1, binding = 2) TILE_LIST_ACCESS buffer TileLists {
+    uint entries[];
+} tileListBuffers[BINDLESS_STORAGE_BUFFERS];
+#define tileLists tileListBuffers[indices.tileLists].entries
+
+// Conservative distance to the first hit per PREPASS_BLOCK_SIZE block, written by prepass.comp
+#ifndef COARSE_DEPTH_ACCESS
+#define COARSE_DEPTH_ACCESS readonly
+#endif
+layout(set = 1, binding = 0, r32f) uniform COARSE_DEPTH_ACCESS image2D bindlessR32f[BINDLESS_STORAGE_IMAGES];
+#define coarseDepth bindlessR32f[indices.coarseDepth]
+
+// Sparse brick map of the primitives, baked on the CPU (see BrickMap in renderer.h).
+// An indirection entry either points at a BRICK_SIZE^3 brick of distance samples
+// in the atlas or, with BRICK_EMPTY set, holds the distance at the cell center.
+const uint BRICK_SIZE = 8u; // samples per side; neighbouring bricks share their border samples
+const uint BRICK_ATLAS_BRICKS = 32u;
+const uint BRICK_EMPTY = 0x80000000u;
+const float BRICK_DISTANCE_SCALE = 1024.0;
+layout(set = 0, binding = 6, r32ui) uniform readonly uimage3D brickIndirection;
+layout(set = 0, binding = 7) uniform sampler3D brickAtlas;
+
+// Per frame in flight: x = march steps, y = marched pixels
+layout(std430, set = 0, binding = 3) buffer StepCounters {
+    uvec2 stepCounters[];
+};
+
+// Temporal history ping-pong: frames with even frameIndex write historyA and read historyB.
+// x = shadow, y = AO, z = distance from the camera that wrote it, w = accumulated frames
+#define historyA bindlessRgba16f[indices.historyA]
+#define historyB bindlessRgba16f[indices.historyB]
+
+// Written once per frame into the frame uniform ring (FrameUniforms in renderer.h)
+// and bound at a dynamic offset
+layout(std140, set = 0, binding = 9) uniform FrameConstants {
+    vec4 cameraPos;
+    vec4 cameraTarget;
+    vec4 prevCameraPos;
+    vec4 prevCameraTarget;
+    uvec2 resolution;     // render extent, may be below the output size
+    uvec2 prevResolution; // render extent the history was written at
+    uint frameIndex;
+    uint flags;
+    uint frameSlot; // index of the frame in flight
+    uint lightingScale; // render pixels per side of a shadow/AO sample in the split passes
+    uint checkerPhase;  // which half of the checkerboard is marched this frame
+} frame;
+
+// Signed Distance Functions
+float sdPlane(vec3 p, vec3 n, float offset) {
+    return dot(p, n) - offset;
+}
+
+float sdBox(vec3 p, vec3 b) {
+    vec3 d = abs(p) - b;
+    return min(max(d.x, max(d.y, d.z)), 0.0) + length(max(d, 0.0));
+}
+
+float sdSphere(vec3 p, float r) {
+    return length(p) - r;
+}
+
+float sdPrimitive(uint index, vec3 p) {
+    Primitive prim = primitives[index];
+    uint type = uint(prim.positionType.w);
+    if (type == PRIM_PLANE) {
+        return sdPlane(p, prim.params.xyz, prim.params.w);
+    } else if (type == PRIM_BOX) {
+        return sdBox(p - prim.positionType.xyz, prim.params.xyz);
+    }
+    return sdSphere(p - prim.positionType.xyz, prim.params.x);
+}
+
+// Radius of a sphere around positionType.xyz bounding the primitive, negative when unbounded
+float primitiveBoundingRadius(Primitive prim) {
+    uint type = uint(prim.positionType.w);
+    if (type == PRIM_PLANE) return -1.0;
+    if (type == PRIM_BOX) return length(prim.params.xyz);
+    return prim.params.x;
+}
+
+// Baked distance at p. False outside the brick map and within a couple of voxels
+// of a surface, where the analytic primitives are needed for precision. The bake
+// covers every primitive, so it never exceeds a tile's culled distance.
+bool brickMapDistance(vec3 p, out float d) {
+    d = 0.0;
+#ifdef SCENE_NO_BRICK_MAP
+    return false;
+#else
+    if ((frame.flags & FLAG_BRICK_MAP) == 0u) return false;
+    vec3 cell = (p - brickOrigin.xyz) / brickOrigin.w;
+    if (any(lessThan(cell, vec3(0.0))) || any(greaterThanEqual(cell, vec3(brickCells.xyz)))) return false;
+
+    ivec3 index = ivec3(cell);
+    uint entry = imageLoad(brickIndirection, index).r;
+    float voxel = brickOrigin.w / float(BRICK_SIZE - 1u);
+    if ((entry & BRICK_EMPTY) != 0u) {
+        // 1-Lipschitz bound from the cell center; inside solids the entry is 0
+        vec3 center = brickOrigin.xyz + (vec3(index) + 0.5) * brickOrigin.w;
+        d = float(entry & ~BRICK_EMPTY) / BRICK_DISTANCE_SCALE - length(p - center);
+    } else {
+        uvec3 brick = uvec3(entry % BRICK_ATLAS_BRICKS, (entry / BRICK_ATLAS_BRICKS) % BRICK_ATLAS_BRICKS,
+                            entry / (BRICK_ATLAS_BRICKS * BRICK_ATLAS_BRICKS));
+        vec3 texel = vec3(brick * BRICK_SIZE) + 0.5 + (cell - vec3(index)) * float(BRICK_SIZE - 1u);
+        // half a voxel covers the trilinear error so the march never overshoots
+        d = textureLod(brickAtlas, texel / vec3(textureSize(brickAtlas, 0)), 0.0).r - 0.5 * voxel;
+    }
+    return d > 2.0 * voxel;
+#endif
+}
+
+// Primitives evaluated by sceneSDF: either the current tile's culled list or the whole scene
+uint g_tileBase = 0u;
+uint g_tileCount = 0u;
+bool g_useTileList = false;
+
+void selectTile(uvec2 pixel) {
+    uint tilesX = (frame.resolution.x + CULL_TILE_SIZE - 1u) / CULL_TILE_SIZE;
+    uvec2 tile = pixel / CULL_TILE_SIZE;
+    g_tileBase = (tile.y * tilesX + tile.x) * TILE_STRIDE;
+    g_tileCount = tileLists[g_tileBase];
+    // overflowing tiles fall back to the full scene
+    g_useTileList = g_tileCount <= MAX_TILE_PRIMITIVES;
+}
+
+uint scenePrimitive(uint i) {
+    return g_useTileList ? tileLists[g_tileBase + 1u + i] : i;
+}
+
+uint scenePrimitiveCount() {
+    return g_useTileList ? g_tileCount : primitiveCount;
+}
+
+// Scene SDF, restricted to the primitives that can be seen from the current tile
+float sceneSDF(vec3 p) {
+    float d;
+    if (brickMapDistance(p, d)) return d;
+    d = MAX_DIST;
+    uint count = scenePrimitiveCount();
+    for (uint i = 0u; i < count; i++) {
+        d = min(d, sdPrimitive(scenePrimitive(i), p));
+    }
+    return d;
+}
+
+// Unculled scene SDF for rays that leave the tile frustum (shadows)
+float sceneSDFAll(vec3 p) {
+    float d;
+    if (brickMapDistance(p, d)) return d;
+    d = MAX_DIST;
+    for (uint i = 0u; i < primitiveCount; i++) {
+        d = min(d, sdPrimitive(i, p));
+    }
+    return d;
+}
+
+// Index of the closest primitive, used for materials
+uint sceneClosest(vec3 p) {
+    float best = MAX_DIST;
+    uint closest = 0u;
+    uint count = scenePrimitiveCount();
+    for (uint i = 0u; i < count; i++) {
+        uint index = scenePrimitive(i);
+        float d = sdPrimitive(index, p);
+        if (d < best) {
+            best = d;
+            closest = index;
+        }
+    }
+    return closest;
+}
+
+// Normal estimation
+vec3 estimateNormal(vec3 p) {
+    return normalize(vec3(
+                     sceneSDF(vec3(p.x + EPSILON, p.y, p.z)) - sceneSDF(vec3(p.x - EPSILON, p.y, p.z)),
+                     sceneSDF(vec3(p.x, p.y + EPSILON, p.z)) - sceneSDF(vec3(p.x, p.y - EPSILON, p.z)),
+                     sceneSDF(vec3(p.x, p.y, p.z + EPSILON)) - sceneSDF(vec3(p.x, p.y, p.z - EPSILON))
+                     ));
+}
+
+// Ray marching, starting startDepth along the ray
+int g_marchSteps = 0;
+
+float rayMarch(vec3 ro, vec3 rd, float startDepth) {
+    float depth = startDepth;
+    g_marchSteps = 0;
+    for (int i = 0; i < MAX_STEPS; i++) {
+        vec3 p = ro + depth * rd;
+        float dist = sceneSDF(p);
+        depth += dist;
+        g_marchSteps++;
+        if (dist < EPSILON || depth > MAX_DIST) break;
+    }
+    return depth;
+}
+
+// Soft shadows
+float softShadow(vec3 ro, vec3 rd, float mint, float maxt, float k) {
+    float res = 1.0;
+    float t = mint;
+    for(int i = 0; i < SHADOW_STEPS; i++) {
+        float h = sceneSDFAll(ro + rd * t);
+        if(h < 0.001) return 0.0;
+        res = min(res, k * h / t);
+        t += clamp(h, 0.01, 0.2);
+        if(t > maxt) break;
+    }
+    return res;
+}
+
+// Soft shadows spread over frames: fewer, longer steps starting at a jittered offset
+float softShadowTemporal(vec3 ro, vec3 rd, float mint, float maxt, float k, float jitter) {
+    float res = 1.0;
+    float t = mint + jitter * 0.2;
+    for(int i = 0; i < SHADOW_TEMPORAL_STEPS; i++) {
+        float h = sceneSDFAll(ro + rd * t);
+        if(h < 0.001) return 0.0;
+        res = min(res, k * h / t);
+        t += clamp(h, 0.02, 0.4);
+        if(t > maxt) break;
+    }
+    return res;
+}
+
+// Ambient Occlusion
+float ambientOcclusion(vec3 p, vec3 n) {
+
+    int numSamples = AO_SAMPLES;
+    float maxDistance = AO_MAX_DISTANCE;
+
+    float ao = 0.0;
+    float scale = 1.0 / float(numSamples);
+
+    for (int i = 1; i <= numSamples; i++) {
+        float t = float(i) / float(numSamples) * maxDistance;
+        float d = sceneSDF(p + n * t);
+        // smooth step
+        ao += smoothstep(0.0, 1.0, t - d);
+
+    }
+
+    // normalize and invert ao
+    ao = ao * scale;
+    ao = clamp(1.0 - ao, 0.0, 1.0);
+
+    return ao;
+}
+
+// One interleaved subset of the AO samples; averaging every phase gives ambientOcclusion
+float ambientOcclusionPartial(vec3 p, vec3 n, int phase) {
+    int stride = AO_SAMPLES / AO_TEMPORAL_SAMPLES;
+    float ao = 0.0;
+    for (int j = 0; j < AO_TEMPORAL_SAMPLES; j++) {
+        int i = j * stride + phase + 1;
+        float t = float(i) / float(AO_SAMPLES) * AO_MAX_DISTANCE;
+        float d = sceneSDF(p + n * t);
+        ao += smoothstep(0.0, 1.0, t - d);
+    }
+    return clamp(1.0 - ao / float(AO_TEMPORAL_SAMPLES), 0.0, 1.0);
+}
+
+// Checkerboard pattern
+float checkerboard(vec2 p) {
+    vec2 q = floor(p);
+    return mod(q.x + q.y, 2.0);
+}
+
+// Calculate forward, right, and up vectors for a look-at camera
+// Width over height of a render extent; follows the swapchain instead of assuming 16:9
+float aspectRatio(uvec2 resolution) {
+    return float(resolution.x) / float(resolution.y);
+}
+
+void cameraBasis(vec3 pos, vec3 target, out vec3 forward, out vec3 right, out vec3 up) {
+    vec3 upWorld = vec3(0.0, 1.0, 0.0); // World's up vector
+    forward = normalize(target - pos);
+    right = normalize(cross(forward, upWorld));
+    up = cross(right, forward);
+}
+
+// Primary ray of an arbitrary look-at camera; fov is vertical, in radians
+void lookAtRay(vec3 pos, vec3 target, float fov, vec2 fragUV, out vec3 ro, out vec3 rd) {
+    vec2 uv = fragUV * 2.0 - 1.0;
+    uv.x *= aspectRatio(frame.resolution); // Adjust for aspect ratio
+
+    // Camera setup
+    ro = pos;
+    vec3 forward;
+    vec3 right;
+    vec3 up;
+    cameraBasis(ro, target, forward, right, up);
+
+    // Calculate FOV scaling factor
+    float scale = tan(fov * 0.5);
+
+    // Ray direction calculation using the camera's coordinate system
+    rd = normalize(forward + (uv.x * scale) * right + (uv.y * scale) * up);
+}
+
+// Primary ray for a screen position; uv is in [0,1] with y pointing up
+void cameraRay(vec2 fragUV, out vec3 ro, out vec3 rd) {
+    lookAtRay(frame.cameraPos.xyz, frame.cameraTarget.xyz, FOV, fragUV, ro, rd);
+}
+
+// Inverse of cameraRay for the previous frame's camera; false when p was off screen
+bool projectPrevious(vec3 p, out ivec2 pixel) {
+    vec3 forward;
+    vec3 right;
+    vec3 up;
+    cameraBasis(frame.prevCameraPos.xyz, frame.prevCameraTarget.xyz, forward, right, up);
+
+    vec3 v = p - frame.prevCameraPos.xyz;
+    float z = dot(v, forward);
+    if (z <= 0.0) return false;
+
+    float scale = tan(FOV * 0.5);
+    vec2 uv = vec2(dot(v, right), dot(v, up)) / (z * scale);
+    uv.x /= aspectRatio(frame.prevResolution);
+    vec2 fragUV = uv * 0.5 + 0.5;
+    vec2 screen = vec2(fragUV.x, 1.0 - fragUV.y) * vec2(frame.prevResolution);
+    pixel = ivec2(floor(screen));
+    return all(greaterThanEqual(pixel, ivec2(0))) && all(lessThan(pixel, ivec2(frame.prevResolution)));
+}
+
+// Shaders without a history of their own define SCENE_NO_HISTORY so the history
+// images are never statically used and may stay in any layout.
+vec4 loadHistory(ivec2 pixel) {
+#ifdef SCENE_NO_HISTORY
+    return vec4(0.0);
+#else
+    return (frame.frameIndex & 1u) == 0u ? imageLoad(historyB, pixel) : imageLoad(historyA, pixel);
+#endif
+}
+
+void storeHistory(ivec2 pixel, vec4 value) {
+#ifndef SCENE_NO_HISTORY
+    if ((frame.flags & FLAG_TEMPORAL) == 0u) return;
+    if ((frame.frameIndex & 1u) == 0u) {
+        imageStore(historyA, pixel, value);
+    } else {
+        imageStore(historyB, pixel, value);
+    }
+#endif
+}
+
+// Per-pixel noise that changes every frame, used to jitter temporal samples
+float interleavedGradientNoise(uvec2 pixel, uint frameIndex) {
+    vec2 p = vec2(pixel) + 5.588238 * float(frameIndex % 64u);
+    return fract(52.9829189 * fract(dot(p, vec2(0.06711056, 0.00583715))));
+}
+
+// Background color
+const vec4 BACKGROUND_COLOR = vec4(0.7, 0.8, 0.9, 1.0);
+
+// Green to red ramp for the step count debug view
+vec4 stepHeatmap(int steps) {
+    float t = float(steps) / float(MAX_STEPS);
+    return vec4(t, 1.0 - t, 0.0, 1.0);
+}
+
+// Lights a surface point of the given primitive; only the key light is shadowed
+vec3 shadeSurface(vec3 p, vec3 normal, uint primitive, float shadow, float ao) {
+    // Material color
+    vec4 material = primitives[primitive].material;
+    vec3 color = material.rgb;
+    if (material.w > 0.5) {
+        color *= checkerboard(p.xz);
+    }
+
+    // Diffuse lighting
+    Light keyLight = lights[0];
+    vec3 lightDir = normalize(keyLight.position.xyz - p);
+    vec3 diff = max(dot(normal, lightDir), 0.0) * keyLight.position.w * keyLight.color.rgb;
+
+    // Final color calculation
+    vec3 finalColor = color * diff * shadow;
+    for (uint i = 1u; i < lightCount; i++) {
+        vec3 toLight = normalize(lights[i].position.xyz - p);
+        finalColor += color * max(dot(normal, toLight), 0.0) * lights[i].position.w * lights[i].color.rgb;
+    }
+
+    // Apply ambient occlusion
+    finalColor *= ao;
+
+    // Ambient light
+    finalColor += 0.1 * color * ao;
+
+    return finalColor;
+}
+
+// Shades one primary ray; pixel addresses the per-pixel history and noise
+vec4 shadeRay(vec3 ro, vec3 rd, float startDepth, uvec2 pixel) {
+    float d = rayMarch(ro, rd, startDepth);
+
+    if ((frame.flags & FLAG_STEP_STATS) != 0u) {
+        atomicAdd(stepCounters[frame.frameSlot].x, uint(g_marchSteps));
+        atomicAdd(stepCounters[frame.frameSlot].y, 1u);
+    }
+    if ((frame.flags & FLAG_STEP_HEATMAP) != 0u) {
+        storeHistory(ivec2(pixel), vec4(0.0));
+        return stepHeatmap(g_marchSteps);
+    }
+
+    if (d < MAX_DIST) {
+        vec3 p = ro + rd * d;
+        vec3 normal = estimateNormal(p);
+        vec3 lightDir = normalize(lights[0].position.xyz - p);
+
+        float shadow;
+        float ao;
+        if ((frame.flags & FLAG_TEMPORAL) != 0u) {
+            // a fraction of the shadow and AO work this frame, blended with the reprojected history
+            float jitter = interleavedGradientNoise(pixel, frame.frameIndex);
+            shadow = softShadowTemporal(p + normal * EPSILON * 2.0, lightDir, 0.01, 4.0, 32.0, jitter);
+            ao = ambientOcclusionPartial(p, normal, int(frame.frameIndex % uint(AO_SAMPLES / AO_TEMPORAL_SAMPLES)));
+
+            vec4 history = vec4(0.0);
+            ivec2 prevPixel;
+            if ((frame.flags & FLAG_HISTORY_VALID) != 0u && projectPrevious(p, prevPixel)) {
+                vec4 candidate = loadHistory(prevPixel);
+                float prevDistance = length(p - frame.prevCameraPos.xyz);
+                // disocclusion: the previous frame saw a different surface there
+                if (abs(candidate.z - prevDistance) < HISTORY_DEPTH_TOLERANCE * prevDistance) {
+                    history = candidate;
+                }
+            }
+            float count = min(history.w + 1.0, MAX_HISTORY);
+            shadow = mix(history.x, shadow, 1.0 / count);
+            ao = mix(history.y, ao, 1.0 / count);
+            storeHistory(ivec2(pixel), vec4(shadow, ao, d, count));
+        } else {
+            // Shadows
+            shadow = softShadow(p + normal * EPSILON * 2.0, lightDir, 0.01, 4.0, 32.0);
+
+            // Ambient Occlusion
+            ao = ambientOcclusion(p, normal);
+        }
+
+        return vec4(shadeSurface(p, normal, sceneClosest(p), shadow, ao), 1.0);
+    } else {
+        storeHistory(ivec2(pixel), vec4(1.0, 1.0, MAX_DIST, 0.0));
+        return BACKGROUND_COLOR;
+    }
+}
+
+// Where the primary ray of a pixel starts marching: the coarse pre-pass depth when available
+float primaryStartDepth(uvec2 pixel) {
+    if ((frame.flags & FLAG_DEPTH_PREPASS) == 0u) return 0.0;
+    return imageLoad(coarseDepth, ivec2(pixel / PREPASS_BLOCK_SIZE)).r;
+}
+
+// Shades one pixel of the main camera; pixel selects the culled primitive list
+vec4 shadePixel(vec2 fragUV, uvec2 pixel) {
+    selectTile(pixel);
+
+    vec3 ro;
+    vec3 rd;
+    cameraRay(fragUV, ro, rd);
+
+    return shadeRay(ro, rd, primaryStartDepth(pixel), pixel);
+}
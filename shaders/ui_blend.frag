@@ -0,0 +1,17 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_samplerless_texture_functions : require
+#extension GL_GOOGLE_include_directive : require
+
+#include "bindless.glsl"
+
+// ImGui rendered into its own cleared layer, so its color is premultiplied;
+// blended with ONE, ONE_MINUS_SRC_ALPHA onto the upscaled scene.
+#define uiLayer bindlessTextures[indices.uiLayer]
+
+layout(location = 0) in vec2 fragCoord;
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = texelFetch(uiLayer, ivec2(gl_FragCoord.xy), 0);
+}